@@ -0,0 +1,165 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "EventScheduler.h"
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+    // 预读线程没有事情可做时的等待时间（音频线程不能通知条件变量，只能轮询）
+    constexpr int idleSleepMilliseconds = 1;
+}
+
+EventScheduler::EventScheduler()
+{
+}
+
+EventScheduler::~EventScheduler()
+{
+    stopThread();
+}
+
+void EventScheduler::reset(const MidiEventMerger* events, const TempoMap* tempoMap, size_t startEvent, double sampleRate)
+{
+    jassert(!isThreadRunning());
+
+    queue.clear();
+    mergedEvents = events;
+    tempo = tempoMap;
+    eventStream = nullptr;
+    samplesPerSecond = sampleRate;
+    nextEvent = startEvent;
+    tempoSegment = 0;
+    scheduledUntil.store(events == nullptr || tempoMap == nullptr ? exhaustedSample : 0, std::memory_order_release);
+}
+
+void EventScheduler::reset(MidiEventStream* stream, double sampleRate)
+{
+    jassert(!isThreadRunning());
+
+    queue.clear();
+    mergedEvents = nullptr;
+    tempo = nullptr;
+    eventStream = stream;
+    samplesPerSecond = sampleRate;
+    nextEvent = 0;
+    tempoSegment = 0;
+    scheduledUntil.store(stream == nullptr || stream->isExhausted() ? exhaustedSample : 0, std::memory_order_release);
+}
+
+juce::int64 EventScheduler::getEventSample(uint32_t tick)
+{
+    // 事件按tick有序，速度段只需要向前推进；和 TempoMap::ticksToSeconds 的计算完全相同
+    const auto& segments = tempo->getSegments();
+
+    if (segments.empty())
+        return 0;
+
+    while (tempoSegment + 1 < segments.size() && segments[tempoSegment + 1].startTick <= tick)
+        ++tempoSegment;
+
+    const TempoMap::Segment& segment = segments[tempoSegment];
+    const double seconds = segment.startSeconds + ((double) tick - (double) segment.startTick) * segment.secondsPerTick;
+    return (juce::int64) std::llround(seconds * samplesPerSecond);
+}
+
+bool EventScheduler::scheduleUntil(juce::int64 sampleLimit)
+{
+    if (eventStream != nullptr)
+        return scheduleStreamUntil(sampleLimit);
+
+    if (mergedEvents == nullptr || tempo == nullptr || isExhausted())
+        return false;
+
+    // 只读取已经合并好的部分，合并器在其他线程发布新事件也是安全的
+    const MergedMidiEvent* events = mergedEvents->getEvents();
+    const size_t available = mergedEvents->getNumMerged();
+    const size_t startEvent = nextEvent;
+    juce::int64 covered = getScheduledUntil();
+
+    while (nextEvent < available)
+    {
+        const MergedMidiEvent& event = events[nextEvent];
+        const juce::int64 sample = getEventSample(event.tick);
+
+        // 之后的事件都不早于这个位置，所以在它之前的事件已经全部入队
+        covered = std::max(covered, sample);
+
+        if (sample >= sampleLimit)
+        {
+            covered = std::max(covered, sampleLimit);
+            break;
+        }
+
+        if (!queue.push({ sample, event.status, event.data1, event.data2 }))
+            break;
+
+        ++nextEvent;
+    }
+
+    if (nextEvent == mergedEvents->getTotalEvents() && mergedEvents->isFinished())
+        covered = exhaustedSample;
+
+    scheduledUntil.store(covered, std::memory_order_release);
+    return nextEvent != startEvent;
+}
+
+bool EventScheduler::scheduleStreamUntil(juce::int64 sampleLimit)
+{
+    if (isExhausted())
+        return false;
+
+    // 事件在这里才从文件中解码出来，解码窗口之外不保留任何事件
+    const uint64_t startEvent = eventStream->getNumEventsRead();
+    juce::int64 covered = getScheduledUntil();
+
+    while (const StreamedMidiEvent* event = eventStream->peek())
+    {
+        const juce::int64 sample = (juce::int64) std::llround(event->seconds * samplesPerSecond);
+        covered = std::max(covered, sample);
+
+        if (sample >= sampleLimit)
+        {
+            covered = std::max(covered, sampleLimit);
+            break;
+        }
+
+        if (!queue.push({ sample, event->status, event->data1, event->data2 }))
+            break;
+
+        eventStream->next();
+    }
+
+    if (eventStream->isExhausted())
+        covered = exhaustedSample;
+
+    scheduledUntil.store(covered, std::memory_order_release);
+    return eventStream->getNumEventsRead() != startEvent;
+}
+
+void EventScheduler::startThread(const std::atomic<juce::int64>* consumerPosition, juce::int64 readAheadSamples)
+{
+    stopThread();
+    threadShouldExit = false;
+    thread = std::thread([this, consumerPosition, readAheadSamples] { run(consumerPosition, readAheadSamples); });
+}
+
+void EventScheduler::stopThread()
+{
+    if (!thread.joinable())
+        return;
+
+    threadShouldExit = true;
+    thread.join();
+}
+
+void EventScheduler::run(const std::atomic<juce::int64>* consumerPosition, juce::int64 readAheadSamples)
+{
+    while (!threadShouldExit.load(std::memory_order_relaxed) && !isExhausted())
+    {
+        if (!scheduleUntil(consumerPosition->load(std::memory_order_relaxed) + readAheadSamples))
+            std::this_thread::sleep_for(std::chrono::milliseconds(idleSleepMilliseconds));
+    }
+}
@@ -0,0 +1,109 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_EVENTSCHEDULER_H
+#define CANDYJAR_EVENTSCHEDULER_H
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../MidiParser/MidiEventMerger.h"
+#include "../MidiParser/TempoMap.h"
+#include "../MidiParser/MidiEventStream.h"
+#include "../Utils/SpscQueue.h"
+#include <thread>
+
+// 已经换算成采样位置的事件（16字节）
+struct ScheduledEvent
+{
+    juce::int64 sample;
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+};
+
+// 播放时事件队列的统计：调度线程和音频线程只更新原子变量，UI 定时轮询
+struct EventQueueStats
+{
+    std::atomic<int> queueDepth {0};                 // 最近一次回调开始时队列中的事件数
+    std::atomic<int> maxQueueDepth {0};
+    std::atomic<uint64_t> underruns {0};             // 回调结束时本块的事件还没有全部入队的次数
+    std::atomic<uint64_t> lateEvents {0};            // 出队时已经晚于所在块开头的事件数
+    std::atomic<uint64_t> callbacks {0};
+    std::atomic<int64_t> lastEventNanoseconds {0};   // 最近一次回调中处理事件（出队和更新发声体）的用时
+    std::atomic<int64_t> maxEventNanoseconds {0};
+    std::atomic<int64_t> totalEventNanoseconds {0};
+
+    void reset()
+    {
+        queueDepth = 0;
+        maxQueueDepth = 0;
+        underruns = 0;
+        lateEvents = 0;
+        callbacks = 0;
+        lastEventNanoseconds = 0;
+        maxEventNanoseconds = 0;
+        totalEventNanoseconds = 0;
+    }
+};
+
+// 事件调度器：在合并事件流上预读，把事件换算成采样位置后放进单生产者单消费者队列
+//  - 实时播放时由自己的线程预读到消费者位置之后 readAheadSamples 处，音频线程只出队，
+//    不做 tick → 采样的换算，也不访问合并事件流
+//  - 离线渲染时由渲染线程在消费前直接调用 scheduleUntil()，生产者和消费者是同一个线程
+//  - 速度表按事件顺序增量推进，每个事件不再二分查找
+//  - 事件源也可以是流式的 MidiEventStream，此时由预读线程边解码边调度，事件已经带有秒数
+class EventScheduler
+{
+public:
+    static constexpr size_t queueCapacity = 1 << 18;
+
+    EventScheduler();
+    ~EventScheduler();
+
+    // 清空队列并从 startEvent 开始调度（两者在 stopThread() 之前必须保持有效），预读线程不能在运行
+    void reset(const MidiEventMerger* events, const TempoMap* tempoMap, size_t startEvent, double sampleRate);
+
+    // 清空队列并从事件流的当前位置开始调度（事件流在 stopThread() 之前必须保持有效，并且只由调度器读取）
+    void reset(MidiEventStream* stream, double sampleRate);
+
+    // 生产者：把采样位置早于 sampleLimit 的事件放入队列（队列满时提前停止），返回是否放入了新事件
+    bool scheduleUntil(juce::int64 sampleLimit);
+
+    // 启动预读线程，consumerPosition 是消费者当前的采样位置
+    void startThread(const std::atomic<juce::int64>* consumerPosition, juce::int64 readAheadSamples);
+    void stopThread();
+    bool isThreadRunning() const { return thread.joinable(); }
+
+    // 消费者使用的队列
+    SpscQueue<ScheduledEvent>& getQueue() { return queue; }
+
+    // 采样位置早于这个值的事件都已经入队
+    juce::int64 getScheduledUntil() const { return scheduledUntil.load(std::memory_order_acquire); }
+
+    // 事件流中的事件已经全部入队
+    bool isExhausted() const { return getScheduledUntil() == exhaustedSample; }
+
+    static constexpr juce::int64 exhaustedSample = std::numeric_limits<juce::int64>::max();
+
+private:
+    SpscQueue<ScheduledEvent> queue { queueCapacity };
+
+    const MidiEventMerger* mergedEvents = nullptr;
+    const TempoMap* tempo = nullptr;
+    MidiEventStream* eventStream = nullptr;
+    double samplesPerSecond = 44100.0;
+    size_t nextEvent = 0;
+    size_t tempoSegment = 0;
+    std::atomic<juce::int64> scheduledUntil {exhaustedSample};
+
+    std::thread thread;
+    std::atomic<bool> threadShouldExit {false};
+
+    juce::int64 getEventSample(uint32_t tick);
+    bool scheduleStreamUntil(juce::int64 sampleLimit);
+    void run(const std::atomic<juce::int64>* consumerPosition, juce::int64 readAheadSamples);
+
+    JUCE_DECLARE_NON_COPYABLE (EventScheduler)
+};
+
+#endif //CANDYJAR_EVENTSCHEDULER_H
@@ -0,0 +1,93 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "OfflineRenderer.h"
+#include "SynthEngine.h"
+#include "../MidiParser/MidiParser.h"
+
+bool OfflineRenderer::render(const juce::File& midiFile, const juce::File& outputFile,
+                             const OfflineRenderOptions& options, OfflineRenderResult& result, juce::String& error)
+{
+    result = OfflineRenderResult();
+
+    if (options.sampleRate <= 0.0 || options.blockSize <= 0)
+    {
+        error = "Invalid render options";
+        return false;
+    }
+
+    // 加载MIDI文件
+    const double loadStart = juce::Time::getMillisecondCounterHiRes();
+
+    // 解码和渲染共用一个线程池（要比解析器活得久，所以先创建）
+    WorkStealingPool pool(options.numThreads);
+    MidiParser parser;
+    parser.setSharedThreadPool(&pool);
+
+    if (!parser.loadMidiFile(midiFile))
+    {
+        error = parser.getLastErrorMessage();
+        return false;
+    }
+
+    result.loadSeconds = (juce::Time::getMillisecondCounterHiRes() - loadStart) / 1000.0;
+
+    // 打开输出文件
+    outputFile.deleteFile();
+    std::unique_ptr<juce::FileOutputStream> stream = outputFile.createOutputStream();
+
+    if (stream == nullptr || stream->failedToOpen())
+    {
+        error = "Cannot open output file: " + outputFile.getFullPathName();
+        return false;
+    }
+
+    juce::WavAudioFormat wavFormat;
+    std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(stream.get(), options.sampleRate, 2,
+                                                                              options.bitsPerSample, {}, 0));
+
+    if (writer == nullptr)
+    {
+        error = "Unsupported output format: " + juce::String(options.bitsPerSample) + " bit";
+        return false;
+    }
+
+    // 写入器已接管输出流
+    stream.release();
+
+    // 渲染
+    SynthEngine engine;
+    engine.prepare(options.sampleRate);
+    engine.setSong(&parser.getMergedEvents(), &parser.getTempoMap());
+    engine.setRenderPool(&pool);
+
+    std::vector<float> left((size_t) options.blockSize), right((size_t) options.blockSize);
+    float* outputs[2] = { left.data(), right.data() };
+
+    const juce::int64 maxSamples = (juce::int64) ((parser.getStatistics().totalDuration + options.maxTailSeconds)
+                                                  * options.sampleRate);
+    const double renderStart = juce::Time::getMillisecondCounterHiRes();
+
+    while (!engine.isFinished() && result.numSamples < maxSamples)
+    {
+        const int numSamples = (int) juce::jmin((juce::int64) options.blockSize, maxSamples - result.numSamples);
+        engine.render(outputs, 2, numSamples);
+
+        if (!writer->writeFromFloatArrays(outputs, 2, numSamples))
+        {
+            error = "Failed to write output file: " + outputFile.getFullPathName();
+            return false;
+        }
+
+        result.numSamples += numSamples;
+    }
+
+    // 析构写入器时补写WAV头
+    writer.reset();
+
+    result.renderSeconds = (juce::Time::getMillisecondCounterHiRes() - renderStart) / 1000.0;
+    result.audioSeconds = (double) result.numSamples / options.sampleRate;
+    result.stolenVoices = engine.getNumStolenVoices();
+    return true;
+}
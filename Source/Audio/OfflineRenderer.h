@@ -0,0 +1,44 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_OFFLINERENDERER_H
+#define CANDYJAR_OFFLINERENDERER_H
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// 离线渲染参数
+struct OfflineRenderOptions
+{
+    double sampleRate = 44100.0;
+    int blockSize = 4096;          // 每次渲染并写入磁盘的采样数，决定输出部分的内存占用
+    int numThreads = 0;            // 解码和渲染用的线程数，<= 0 表示使用全部硬件线程
+    int bitsPerSample = 16;
+    double maxTailSeconds = 2.0;   // 乐曲结束后最多再渲染多久（等待释放包络结束）
+};
+
+// 离线渲染结果
+struct OfflineRenderResult
+{
+    double loadSeconds = 0.0;      // 解析MIDI文件用时
+    double renderSeconds = 0.0;    // 渲染并写入WAV用时
+    double audioSeconds = 0.0;     // 输出音频的长度
+    juce::int64 numSamples = 0;
+    uint64_t stolenVoices = 0;
+
+    // 渲染速度，实时的多少倍
+    double getSpeed() const { return renderSeconds > 0.0 ? audioSeconds / renderSeconds : 0.0; }
+};
+
+// 不经过音频设备，把MIDI文件直接渲染成WAV文件（命令行 --render 使用）
+//  - 复用 MidiParser 的加载流程和 SynthEngine 的合成
+//  - 发声体按固定分组在线程池上并行渲染，结果与线程数无关、逐位一致
+//  - 按块渲染并立即写盘，输出部分的内存占用与乐曲长度无关
+class OfflineRenderer
+{
+public:
+    static bool render(const juce::File& midiFile, const juce::File& outputFile,
+                       const OfflineRenderOptions& options, OfflineRenderResult& result, juce::String& error);
+};
+
+#endif //CANDYJAR_OFFLINERENDERER_H
@@ -0,0 +1,135 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "RealtimeRenderThreads.h"
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <chrono>
+
+namespace
+{
+    // 做完一批之后自旋等待下一批的次数，之后才睡眠
+    constexpr int spinIterations = 4096;
+    // 睡眠时定时醒来检查，补上错过的唤醒
+    constexpr int wakeIntervalMilliseconds = 1;
+
+    inline uint32_t getCount(uint64_t word) { return (uint32_t) (word >> 16) & 0xFFFF; }
+    inline uint32_t getNext(uint64_t word) { return (uint32_t) word & 0xFFFF; }
+}
+
+RealtimeRenderThreads::~RealtimeRenderThreads()
+{
+    stop();
+}
+
+void RealtimeRenderThreads::start(int numThreads)
+{
+    stop();
+    threadsShouldExit = false;
+
+    for (int i = 0; i < numThreads; ++i)
+        threads.emplace_back([this] { threadLoop(); });
+}
+
+void RealtimeRenderThreads::stop()
+{
+    if (threads.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        threadsShouldExit = true;
+    }
+
+    wakeCondition.notify_all();
+
+    for (auto& thread : threads)
+        thread.join();
+
+    threads.clear();
+}
+
+void RealtimeRenderThreads::run(int count, Task task, void* context)
+{
+    if (threads.empty() || count <= 1)
+    {
+        for (int i = 0; i < count; ++i)
+            task(context, i);
+
+        return;
+    }
+
+    jassert(count <= maxTasks);
+
+    // 上一批的任务都已经做完，辅助线程不会再读取这两个字段，直到领到这一批的任务
+    currentTask = task;
+    currentContext = context;
+    numDone.store(0, std::memory_order_relaxed);
+    ++batch;
+    claim.store(((uint64_t) batch << 32) | ((uint64_t) count << 16), std::memory_order_release);
+
+    if (numSleeping.load() > 0)
+        wakeCondition.notify_all();
+
+    while (runOneTask())
+    {
+    }
+
+    // 剩下的只有已经被辅助线程领走、正在执行的任务
+    while (numDone.load(std::memory_order_acquire) < count)
+    {
+    }
+}
+
+bool RealtimeRenderThreads::runOneTask()
+{
+    uint64_t word = claim.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+        if (getNext(word) >= getCount(word))
+            return false;
+
+        // 比较的是整个字，批次号变了就不会领到旧批次的下标
+        if (claim.compare_exchange_weak(word, word + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            break;
+    }
+
+    // 领到的任务没做完之前这一批不会结束，任务和上下文还是这一批的
+    currentTask(currentContext, (int) getNext(word));
+    numDone.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+bool RealtimeRenderThreads::hasUnclaimedTask() const
+{
+    const uint64_t word = claim.load(std::memory_order_acquire);
+    return getNext(word) < getCount(word);
+}
+
+void RealtimeRenderThreads::threadLoop()
+{
+    int idleIterations = 0;
+
+    while (!threadsShouldExit.load(std::memory_order_relaxed))
+    {
+        if (runOneTask())
+        {
+            idleIterations = 0;
+            continue;
+        }
+
+        if (++idleIterations < spinIterations)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(sleepLock);
+        ++numSleeping;
+        wakeCondition.wait_for(guard, std::chrono::milliseconds(wakeIntervalMilliseconds),
+                               [this] { return threadsShouldExit.load() || hasUnclaimedTask(); });
+        --numSleeping;
+        idleIterations = 0;
+    }
+}
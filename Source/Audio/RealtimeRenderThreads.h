@@ -0,0 +1,66 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_REALTIMERENDERTHREADS_H
+#define CANDYJAR_REALTIMERENDERTHREADS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 实时音频线程用的辅助渲染线程
+// 和 WorkStealingPool 不同，音频线程在 run() 中不加锁、不分配内存，也不会等待还没醒来的辅助线程：
+//  - 任务下标由一个原子计数器分发（其中带有批次号和任务数），音频线程自己也领取任务，
+//    辅助线程来不及醒来时所有任务都由音频线程完成，最多等待已经被领走的任务做完
+//  - 辅助线程做完一批后先自旋一会儿（同一次回调中的下一批通常马上就到），之后才睡眠；
+//    唤醒只是不持锁的 notify，错过的唤醒由定时醒来补上，只影响这一批的并行度
+class RealtimeRenderThreads
+{
+public:
+    using Task = void (*)(void* context, int index);
+
+    // 单批最多的任务数
+    static constexpr int maxTasks = 0xFFFF;
+
+    RealtimeRenderThreads() = default;
+    ~RealtimeRenderThreads();
+
+    // 启动 numThreads 个辅助线程（不包括调用 run() 的线程），之前的线程先停止；不能和 run() 同时调用
+    void start(int numThreads);
+    void stop();
+
+    int getNumThreads() const { return (int) threads.size(); }
+
+    // 执行 task(context, index)，index ∈ [0, count)，全部完成后返回
+    // 只能由一个线程调用；没有辅助线程或 count <= 1 时直接在当前线程执行
+    void run(int count, Task task, void* context);
+
+private:
+    std::vector<std::thread> threads;
+    std::atomic<bool> threadsShouldExit {false};
+
+    // 高32位是批次号，中间16位是任务数，低16位是下一个待领取的下标
+    std::atomic<uint64_t> claim {0};
+    std::atomic<int> numDone {0};
+    Task currentTask = nullptr;
+    void* currentContext = nullptr;
+    uint32_t batch = 0;
+
+    std::mutex sleepLock;
+    std::condition_variable wakeCondition;
+    std::atomic<int> numSleeping {0};
+
+    // 领取并执行一个任务，没有可领取的任务时返回 false
+    bool runOneTask();
+    bool hasUnclaimedTask() const;
+    void threadLoop();
+
+    RealtimeRenderThreads(const RealtimeRenderThreads&) = delete;
+    RealtimeRenderThreads& operator= (const RealtimeRenderThreads&) = delete;
+};
+
+#endif //CANDYJAR_REALTIMERENDERTHREADS_H
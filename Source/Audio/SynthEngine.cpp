@@ -0,0 +1,458 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "SynthEngine.h"
+#include <algorithm>
+#include <cmath>
+
+SynthEngine::SynthEngine(int maxVoices)
+    : voicePool(maxVoices),
+      mixBuffer((size_t) mixBufferSize),
+      groupBuffers((size_t) std::max(0, (maxVoices - 1) / voicesPerGroup) * mixBufferSize)
+{
+    // 单周期波表：前8个谐波按 1/n 叠加，带保护点方便线性插值
+    float peak = 0.0f;
+
+    for (int i = 0; i < wavetableSize; ++i)
+    {
+        const double phase = juce::MathConstants<double>::twoPi * i / wavetableSize;
+        double value = 0.0;
+
+        for (int harmonic = 1; harmonic <= 8; ++harmonic)
+            value += std::sin(phase * harmonic) / harmonic;
+
+        wavetable[i] = (float) value;
+        peak = std::max(peak, std::abs(wavetable[i]));
+    }
+
+    for (int i = 0; i < wavetableSize; ++i)
+        wavetable[i] /= peak;
+
+    wavetable[wavetableSize] = wavetable[0];
+
+    voiceLimit = voicePool.getCapacity();
+    prepare(sampleRate);
+}
+
+SynthEngine::~SynthEngine()
+{
+    scheduler.stopThread();
+    renderThreads.stop();
+}
+
+void SynthEngine::prepare(double newSampleRate)
+{
+    const double position = getPositionInSeconds();
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+
+    for (int key = 0; key < 128; ++key)
+    {
+        const double frequency = 440.0 * std::pow(2.0, (key - 69) / 12.0);
+        phaseIncrements[key] = (float) (frequency * wavetableSize / sampleRate);
+    }
+
+    // 2ms 起音，30ms 释放
+    attackStep = (float) (1.0 / (0.002 * sampleRate));
+    releaseStep = (float) (1.0 / (0.030 * sampleRate));
+
+    setPosition(position);
+}
+
+void SynthEngine::setSong(const MidiEventMerger* events, const TempoMap* tempoMap)
+{
+    mergedEvents = events;
+    tempo = tempoMap;
+    eventStream = nullptr;
+    setPosition(0.0);
+}
+
+void SynthEngine::setStream(MidiEventStream* stream)
+{
+    mergedEvents = nullptr;
+    tempo = nullptr;
+    eventStream = stream;
+    setPosition(0.0);
+}
+
+void SynthEngine::setPosition(double seconds)
+{
+    // 预读线程会读取事件流和采样位置，先停下来
+    scheduler.stopThread();
+
+    voicePool.reset();
+    activeVoiceCount = 0;
+    stolenVoiceCount = 0;
+    samplePosition = (juce::int64) std::llround(seconds * sampleRate);
+    size_t startEvent = 0;
+
+    if (mergedEvents != nullptr && tempo != nullptr)
+    {
+        // 事件按tick有序，二分查找第一个不早于目标位置的事件
+        const double targetTick = tempo->secondsToTicks(seconds);
+        const MergedMidiEvent* begin = mergedEvents->getEvents();
+        const MergedMidiEvent* end = begin + mergedEvents->getNumMerged();
+
+        startEvent = (size_t) (std::lower_bound(begin, end, targetTick,
+                                                [](const MergedMidiEvent& event, double tick) { return (double) event.tick < tick; })
+                               - begin);
+    }
+
+    if (eventStream != nullptr)
+    {
+        // 流式事件源没有索引，从事件流记下的检查点（或者当前位置）读到目标位置，已经播放过的范围内耗时有上限
+        eventStream->seek(seconds);
+        scheduler.reset(eventStream, sampleRate);
+    }
+    else
+    {
+        scheduler.reset(mergedEvents, tempo, startEvent, sampleRate);
+    }
+
+    queueStats.reset();
+    finished = (mergedEvents == nullptr && eventStream == nullptr);
+
+    // 实时播放时先在当前线程填好第一段预读，第一次回调就不会欠载
+    if (realtime)
+    {
+        const juce::int64 readAheadSamples = (juce::int64) (readAheadSeconds * sampleRate);
+        scheduler.scheduleUntil(samplePosition.load() + readAheadSamples);
+        scheduler.startThread(&samplePosition, readAheadSamples);
+    }
+}
+
+void SynthEngine::render(float* const* outputs, int numChannels, int numSamples)
+{
+    SpscQueue<ScheduledEvent>& queue = scheduler.getQueue();
+    const int queueDepth = (int) queue.size();
+    juce::int64 eventTicks = 0;
+
+    queueStats.queueDepth.store(queueDepth, std::memory_order_relaxed);
+
+    if (queueDepth > queueStats.maxQueueDepth.load(std::memory_order_relaxed))
+        queueStats.maxQueueDepth.store(queueDepth, std::memory_order_relaxed);
+
+    for (int offset = 0; offset < numSamples;)
+    {
+        const int blockSize = std::min(numSamples - offset, mixBufferSize);
+        float* mix = mixBuffer.data();
+        std::fill(mix, mix + blockSize, 0.0f);
+
+        const juce::int64 blockStart = samplePosition.load();
+        const juce::int64 blockEnd = blockStart + blockSize;
+        int position = 0;
+
+        // 离线渲染时自己充当生产者；实时播放时事件已经由调度线程提前放进队列
+        if (!realtime)
+            scheduler.scheduleUntil(blockEnd);
+
+        const juce::int64 eventsStart = juce::Time::getHighResolutionTicks();
+        juce::int64 renderTicks = 0;
+        bool drained = false;
+
+        for (;;)
+        {
+            const ScheduledEvent* event = queue.front();
+
+            if (event == nullptr)
+            {
+                // 离线渲染时一块的事件可能比队列容量还多，消费完再继续调度
+                if (!realtime && scheduler.scheduleUntil(blockEnd))
+                    continue;
+
+                drained = true;
+                break;
+            }
+
+            const juce::int64 eventOffset = event->sample - blockStart;
+
+            if (eventOffset >= blockSize)
+                break;
+
+            if (eventOffset < 0)
+                queueStats.lateEvents.fetch_add(1, std::memory_order_relaxed);
+
+            // 先渲染到事件位置，再处理事件（设置了时间精度时，离上一个切分点太近的事件就在那里处理）
+            const int eventPosition = (int) juce::jlimit((juce::int64) position, (juce::int64) blockSize, eventOffset);
+
+            if (eventPosition > position && eventPosition - position >= eventQuantumSamples)
+            {
+                const juce::int64 renderStart = juce::Time::getHighResolutionTicks();
+                renderVoices(mix + position, eventPosition - position);
+                renderTicks += juce::Time::getHighResolutionTicks() - renderStart;
+                position = eventPosition;
+            }
+
+            handleEvent(*event);
+            queue.pop();
+        }
+
+        eventTicks += juce::Time::getHighResolutionTicks() - eventsStart - renderTicks;
+
+        // 队列已经取空，但调度器还没有覆盖到本块的结尾：本块可能漏掉了还没入队的事件
+        if (drained && scheduler.getScheduledUntil() < blockEnd)
+            queueStats.underruns.fetch_add(1, std::memory_order_relaxed);
+
+        renderVoices(mix + position, blockSize - position);
+
+        // 主音量并限幅，单声道结果复制到所有输出通道
+        const float gain = masterGain.load();
+
+        for (int i = 0; i < blockSize; ++i)
+            mix[i] = juce::jlimit(-1.0f, 1.0f, mix[i] * gain);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            if (outputs[channel] != nullptr)
+                std::copy(mix, mix + blockSize, outputs[channel] + offset);
+
+        samplePosition = blockEnd;
+        offset += blockSize;
+    }
+
+    const juce::int64 eventNanoseconds = (juce::int64) (juce::Time::highResolutionTicksToSeconds(eventTicks) * 1.0e9);
+    queueStats.lastEventNanoseconds.store(eventNanoseconds, std::memory_order_relaxed);
+    queueStats.totalEventNanoseconds.fetch_add(eventNanoseconds, std::memory_order_relaxed);
+    queueStats.callbacks.fetch_add(1, std::memory_order_relaxed);
+
+    if (eventNanoseconds > queueStats.maxEventNanoseconds.load(std::memory_order_relaxed))
+        queueStats.maxEventNanoseconds.store(eventNanoseconds, std::memory_order_relaxed);
+
+    activeVoiceCount = voicePool.getNumActive();
+    stolenVoiceCount = voicePool.getNumStolen();
+    finished = (mergedEvents == nullptr && eventStream == nullptr)
+            || (scheduler.isExhausted() && queue.size() == 0 && voicePool.getNumActive() == 0);
+}
+
+void SynthEngine::handleEvent(const ScheduledEvent& event)
+{
+    const int type = event.status & 0xF0;
+    const int channel = event.status & 0x0F;
+
+    if (isNoteOnEvent(event.status, event.data2))
+    {
+        // 超出 CPU 预算降低了上限时，新的音符抢占最老的发声体
+        if (voicePool.getNumActive() >= voiceLimit.load(std::memory_order_relaxed))
+            voicePool.stealOldestVoice();
+
+        const int voiceIndex = voicePool.startVoice(channel, event.data1);
+        if (voiceIndex < 0)
+            return;
+
+        SynthVoice& voice = voicePool[voiceIndex];
+        const float velocity = event.data2 / 127.0f;
+        voice.phaseIncrement = phaseIncrements[event.data1];
+        voice.gain = velocity * velocity;
+        voice.envelope = 0.0f;
+        voice.envelopeStep = attackStep;
+    }
+    else if (isNoteOffEvent(event.status, event.data2))
+    {
+        const int voiceIndex = voicePool.releaseKey(channel, event.data1);
+        if (voiceIndex >= 0)
+            voicePool[voiceIndex].envelopeStep = -releaseStep;
+    }
+    else if (type == 0xB0 && (event.data1 == 120 || event.data1 == 123))
+    {
+        // All Sound Off / All Notes Off：释放该通道上所有发声体
+        const int32_t* active = voicePool.getActiveVoices();
+
+        for (int i = 0; i < voicePool.getNumActive(); ++i)
+        {
+            SynthVoice& voice = voicePool[active[i]];
+
+            if (voice.channel == channel)
+            {
+                voicePool.releaseVoice(active[i]);
+                voice.envelopeStep = -releaseStep;
+            }
+        }
+    }
+}
+
+void SynthEngine::setRenderPool(WorkStealingPool* pool)
+{
+    renderPool = pool;
+}
+
+void SynthEngine::startRenderThreads(int numThreads)
+{
+    if (numThreads < 0)
+        numThreads = juce::jmin(maxRenderThreads, (int) std::thread::hardware_concurrency() - 1);
+
+    if (numThreads > 0)
+        renderThreads.start(numThreads);
+    else
+        renderThreads.stop();
+}
+
+void SynthEngine::stopRenderThreads()
+{
+    renderThreads.stop();
+}
+
+void SynthEngine::renderVoices(float* output, int numSamples)
+{
+    const int numActive = voicePool.getNumActive();
+
+    if (numSamples <= 0 || numActive == 0)
+        return;
+
+    const int32_t* active = voicePool.getActiveVoices();
+    const int numGroups = (numActive + voicesPerGroup - 1) / voicesPerGroup;
+
+    // 第0组直接渲染到输出，其余各组先渲染到各自的缓冲区，再按组号顺序累加。
+    // 分组只取决于活动发声体的数量，和线程数无关，所以结果与线程数无关、逐位一致
+    VoiceGroupJob job { this, output, numSamples, numActive, active };
+
+    if (renderThreads.getNumThreads() > 0 && numGroups > 1 && (juce::int64) numActive * numSamples >= minParallelVoiceSamples)
+        renderThreads.run(numGroups, &SynthEngine::renderGroupTask, &job);
+    else if (renderPool != nullptr && !realtime && numGroups > 1)
+        renderPool->parallelFor(numGroups, [&job](int group, int) { job.engine->renderGroup(job, group); });
+    else
+        for (int group = 0; group < numGroups; ++group)
+            renderGroup(job, group);
+
+    for (int group = 1; group < numGroups; ++group)
+    {
+        const float* source = groupBuffers.data() + (size_t) (group - 1) * mixBufferSize;
+
+        for (int i = 0; i < numSamples; ++i)
+            output[i] += source[i];
+    }
+
+    // 回收释放结束的发声体。倒序遍历：回收时会把最后一个元素换到当前位置，而它已经检查过了
+    for (int slot = numActive; --slot >= 0;)
+    {
+        const SynthVoice& voice = voicePool[active[slot]];
+
+        if (voice.envelopeStep < 0.0f && voice.envelope <= 0.0f)
+            voicePool.freeVoice(active[slot]);
+    }
+}
+
+void SynthEngine::renderGroup(const VoiceGroupJob& job, int group)
+{
+    float* target = job.output;
+
+    if (group > 0)
+    {
+        target = groupBuffers.data() + (size_t) (group - 1) * mixBufferSize;
+        std::fill(target, target + job.numSamples, 0.0f);
+    }
+
+    const int end = std::min(job.numActive, (group + 1) * voicesPerGroup);
+
+    for (int slot = group * voicesPerGroup; slot < end; ++slot)
+        renderVoice(voicePool[job.active[slot]], target, job.numSamples);
+}
+
+void SynthEngine::renderGroupTask(void* context, int group)
+{
+    const VoiceGroupJob& job = *static_cast<const VoiceGroupJob*>(context);
+    job.engine->renderGroup(job, group);
+}
+
+void SynthEngine::renderVoice(SynthVoice& voice, float* output, int numSamples) const
+{
+    float phase = voice.phase;
+    float envelope = voice.envelope;
+    const float step = voice.envelopeStep;
+    const float increment = voice.phaseIncrement;
+    const float gain = voice.gain;
+
+    if (step == 0.0f)
+    {
+        // 持续阶段（绝大多数发声体）：包络不变，省掉逐采样的包络计算
+        const float level = gain * envelope;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const int index = (int) phase;
+            const float fraction = phase - (float) index;
+            output[i] += (wavetable[index] + fraction * (wavetable[index + 1] - wavetable[index])) * level;
+
+            phase += increment;
+            if (phase >= (float) wavetableSize)
+                phase -= (float) wavetableSize;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const int index = (int) phase;
+            const float fraction = phase - (float) index;
+            const float sample = wavetable[index] + fraction * (wavetable[index + 1] - wavetable[index]);
+
+            output[i] += sample * gain * envelope;
+            envelope = std::min(1.0f, std::max(0.0f, envelope + step));
+
+            phase += increment;
+            if (phase >= (float) wavetableSize)
+                phase -= (float) wavetableSize;
+        }
+    }
+
+    voice.phase = phase;
+    voice.envelope = envelope;
+
+    if (step > 0.0f && envelope >= 1.0f)
+        voice.envelopeStep = 0.0f;
+}
+
+//==============================================================================
+void SynthEngine::audioDeviceIOCallbackWithContext(const float* const*, int,
+                                                   float* const* outputChannelData, int numOutputChannels,
+                                                   int numSamples, const juce::AudioIODeviceCallbackContext&)
+{
+    const juce::int64 start = juce::Time::getHighResolutionTicks();
+    render(outputChannelData, numOutputChannels, numSamples);
+
+    updateVoiceLimit(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start),
+                     numSamples / sampleRate);
+}
+
+void SynthEngine::updateVoiceLimit(double callbackSeconds, double blockSeconds)
+{
+    if (cpuBudget <= 0.0f)
+        return;
+
+    const double budgetSeconds = cpuBudget * blockSeconds;
+    const int numActive = voicePool.getNumActive();
+    int limit = voiceLimit.load(std::memory_order_relaxed);
+
+    if (callbackSeconds > budgetSeconds && numActive > minVoiceLimit)
+    {
+        // 渲染用时大致与发声体数成正比，按超出的比例降低上限，多出来的发声体立即抢占，下一次回调就回到预算以内
+        limit = juce::jmax(minVoiceLimit, (int) (numActive * (budgetSeconds / callbackSeconds)));
+
+        while (voicePool.getNumActive() > limit)
+            voicePool.stealOldestVoice();
+
+        stolenVoiceCount = voicePool.getNumStolen();
+        activeVoiceCount = voicePool.getNumActive();
+    }
+    else if (limit < voicePool.getCapacity() && callbackSeconds < 0.5 * budgetSeconds)
+    {
+        // 有富余时逐步放宽，每次回调最多放宽 1/16
+        limit = juce::jmin(voicePool.getCapacity(), limit + limit / 16 + 1);
+    }
+
+    voiceLimit.store(limit, std::memory_order_relaxed);
+}
+
+void SynthEngine::audioDeviceAboutToStart(juce::AudioIODevice* device)
+{
+    // prepare() 会重新定位，并在实时模式下启动预读线程
+    realtime = true;
+    voiceLimit = voicePool.getCapacity();
+    startRenderThreads();
+    prepare(device->getCurrentSampleRate());
+}
+
+void SynthEngine::audioDeviceStopped()
+{
+    scheduler.stopThread();
+    stopRenderThreads();
+    realtime = false;
+}
@@ -0,0 +1,151 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_SYNTHENGINE_H
+#define CANDYJAR_SYNTHENGINE_H
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../MidiParser/MidiEventMerger.h"
+#include "../MidiParser/TempoMap.h"
+#include "../Utils/WorkStealingPool.h"
+#include "VoicePool.h"
+#include "EventScheduler.h"
+#include "RealtimeRenderThreads.h"
+
+// 复音波表合成引擎
+// 播放 MidiEventMerger 的全局有序事件流（或者边播放边解码的 MidiEventStream），音频线程上不分配内存、不加锁
+//  - 作为 juce::AudioIODeviceCallback 挂到 AudioDeviceManager 上实时播放：
+//    EventScheduler 的线程提前把事件换算成采样位置放进无锁队列，音频回调只取出落在本块内的事件；
+//    发声体按组分给 RealtimeRenderThreads 的辅助线程渲染，渲染用时超过 CPU 预算时降低同时发声数的上限
+//  - 或者在任意线程直接调用 render() 离线渲染（不需要音频设备），此时由渲染线程自己调度事件
+class SynthEngine : public juce::AudioIODeviceCallback
+{
+public:
+    explicit SynthEngine(int maxVoices = defaultMaxVoices);
+    ~SynthEngine() override;
+
+    static constexpr int defaultMaxVoices = 65536;
+
+    // 设置采样率并重置所有发声体，不能和 render() 同时调用
+    void prepare(double sampleRate);
+
+    // 设置要播放的事件流和速度表（两者在播放期间必须保持有效），不能和 render() 同时调用
+    void setSong(const MidiEventMerger* events, const TempoMap* tempoMap);
+
+    // 改为播放流式事件源（替代 setSong，事件流在播放期间必须保持有效并且只由引擎读取），不能和 render() 同时调用
+    void setStream(MidiEventStream* stream);
+
+    // 跳到指定位置（秒），停止所有发声体，不能和 render() 同时调用
+    void setPosition(double seconds);
+
+    // 渲染下一段音频，覆盖写入 outputs
+    void render(float* const* outputs, int numChannels, int numSamples);
+
+    // 事件已全部处理且所有发声体都已结束
+    bool isFinished() const { return finished.load(); }
+
+    double getPositionInSeconds() const { return (double) samplePosition.load() / sampleRate; }
+    int getNumActiveVoices() const { return activeVoiceCount.load(); }
+    uint64_t getNumStolenVoices() const { return stolenVoiceCount.load(); }
+
+    void setMasterGain(float newGain) { masterGain.store(newGain); }
+
+    // 实时播放时事件队列的统计（队列深度、欠载次数、回调中处理事件的用时）
+    const EventQueueStats& getQueueStats() const { return queueStats; }
+
+    // 实时播放时预读的时长
+    static constexpr double readAheadSeconds = 0.2;
+
+    // 事件的时间精度（采样数），不能和 render() 同时调用
+    //  - 0（默认）：每个事件都在它的采样位置处理，渲染在每个事件处切分
+    //  - N > 0：离上一个切分点不到 N 个采样的事件在上一个切分点处理（最多提前 N - 1 个采样），
+    //    事件密集时减少切分次数
+    void setEventQuantum(int samples) { eventQuantumSamples = juce::jmax(0, samples); }
+
+    // 设置渲染发声体用的线程池（nullptr 表示在当前线程渲染）
+    // 只用于离线渲染：线程池的同步会阻塞，不能在实时音频线程上使用
+    void setRenderPool(WorkStealingPool* pool);
+
+    // 启动渲染发声体的辅助线程（不包括调用 render() 的线程），运行时优先于 setRenderPool() 的线程池
+    // numThreads < 0 表示硬件线程数减一（最多 maxRenderThreads 个）；挂到音频设备上时自动启动，设备停止时停止
+    // 不能和 render() 同时调用
+    void startRenderThreads(int numThreads = -1);
+    void stopRenderThreads();
+    int getNumRenderThreads() const { return renderThreads.getNumThreads(); }
+
+    static constexpr int maxRenderThreads = 8;
+
+    // 实时播放时每次回调的 CPU 预算（占回调时长的比例，0 表示不限制），不能和 render() 同时调用
+    // 回调用时超过预算时按比例降低同时发声数的上限并立即抢占最老的发声体，之后新的音符也抢占最老的；
+    // 用时回到预算以内后上限逐步恢复到发声体池的容量
+    void setCpuBudget(float fractionOfCallback) { cpuBudget = juce::jmax(0.0f, fractionOfCallback); }
+
+    // 当前同时发声数的上限（没有超出过预算时是发声体池的容量）
+    int getVoiceLimit() const { return voiceLimit.load(); }
+
+    //==============================================================================
+    void audioDeviceIOCallbackWithContext(const float* const* inputChannelData, int numInputChannels,
+                                          float* const* outputChannelData, int numOutputChannels,
+                                          int numSamples, const juce::AudioIODeviceCallbackContext& context) override;
+    void audioDeviceAboutToStart(juce::AudioIODevice* device) override;
+    void audioDeviceStopped() override;
+
+private:
+    static constexpr int wavetableSize = 2048;
+    static constexpr int mixBufferSize = 4096;
+    // 每组发声体渲染到同一个缓冲区，组是并行渲染的最小单位
+    static constexpr int voicesPerGroup = 256;
+    // 活动发声体数 × 采样数少于这个值时不分给辅助线程（事件密集时渲染段很短，分派的开销比渲染还大）
+    static constexpr juce::int64 minParallelVoiceSamples = 16384;
+    // CPU 预算降低上限时最少保留的发声体数
+    static constexpr int minVoiceLimit = voicesPerGroup;
+
+    // 一次 renderVoices() 中各组共用的参数
+    struct VoiceGroupJob
+    {
+        SynthEngine* engine;
+        float* output;
+        int numSamples;
+        int numActive;
+        const int32_t* active;
+    };
+
+    VoicePool voicePool;
+    float wavetable[wavetableSize + 1];
+    float phaseIncrements[128];
+    std::vector<float> mixBuffer;
+    std::vector<float> groupBuffers;
+    WorkStealingPool* renderPool = nullptr;
+    RealtimeRenderThreads renderThreads;
+    int eventQuantumSamples = 0;
+    float cpuBudget = 0.8f;
+
+    const MidiEventMerger* mergedEvents = nullptr;
+    const TempoMap* tempo = nullptr;
+    MidiEventStream* eventStream = nullptr;
+    EventScheduler scheduler;
+    EventQueueStats queueStats;
+    bool realtime = false;        // 挂在音频设备上时为 true，事件由调度线程入队
+    double sampleRate = 44100.0;
+    float attackStep = 0.0f;
+    float releaseStep = 0.0f;
+
+    std::atomic<juce::int64> samplePosition {0};
+    std::atomic<bool> finished {false};
+    std::atomic<int> activeVoiceCount {0};
+    std::atomic<uint64_t> stolenVoiceCount {0};
+    std::atomic<int> voiceLimit {0};
+    std::atomic<float> masterGain {0.1f};
+
+    void handleEvent(const ScheduledEvent& event);
+    void renderVoices(float* output, int numSamples);
+    void renderGroup(const VoiceGroupJob& job, int group);
+    static void renderGroupTask(void* context, int group);
+    void updateVoiceLimit(double callbackSeconds, double blockSeconds);
+    void renderVoice(SynthVoice& voice, float* output, int numSamples) const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SynthEngine)
+};
+
+#endif //CANDYJAR_SYNTHENGINE_H
@@ -0,0 +1,153 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "VoicePool.h"
+#include <algorithm>
+
+VoicePool::VoicePool(int capacity)
+    : voices((size_t) capacity),
+      freeVoices((size_t) capacity),
+      activeVoices((size_t) capacity),
+      keyHeads(16 * 128, -1)
+{
+    reset();
+}
+
+void VoicePool::reset()
+{
+    const int capacity = getCapacity();
+
+    for (int i = 0; i < capacity; ++i)
+    {
+        voices[(size_t) i] = SynthVoice();
+        // 倒序入栈，让低下标先被使用
+        freeVoices[(size_t) i] = capacity - 1 - i;
+    }
+
+    std::fill(keyHeads.begin(), keyHeads.end(), -1);
+    numFree = capacity;
+    numActive = 0;
+    oldestVoice = -1;
+    newestVoice = -1;
+    numStolen = 0;
+}
+
+int VoicePool::startVoice(int channel, int key)
+{
+    if (voices.empty())
+        return -1;
+
+    int voiceIndex;
+
+    if (numFree > 0)
+    {
+        voiceIndex = freeVoices[(size_t) --numFree];
+    }
+    else
+    {
+        // 池满：抢占最老的发声体，直接复用它的槽位
+        voiceIndex = oldestVoice;
+        freeVoice(voiceIndex);
+        --numFree;
+        ++numStolen;
+    }
+
+    SynthVoice& voice = voices[(size_t) voiceIndex];
+    voice = SynthVoice();
+    voice.channel = (uint8_t) channel;
+    voice.key = (uint8_t) key;
+    voice.held = true;
+
+    // 加入活动数组
+    voice.activeSlot = numActive;
+    activeVoices[(size_t) numActive++] = voiceIndex;
+
+    // 追加到年龄链表末尾
+    voice.olderVoice = newestVoice;
+    if (newestVoice >= 0)
+        voices[(size_t) newestVoice].newerVoice = voiceIndex;
+    else
+        oldestVoice = voiceIndex;
+    newestVoice = voiceIndex;
+
+    // 插入按键链表表头
+    int32_t& head = keyHeads[(size_t) (channel * 128 + key)];
+    voice.nextOnKey = head;
+    if (head >= 0)
+        voices[(size_t) head].prevOnKey = voiceIndex;
+    head = voiceIndex;
+
+    return voiceIndex;
+}
+
+int VoicePool::releaseKey(int channel, int key)
+{
+    const int32_t voiceIndex = keyHeads[(size_t) (channel * 128 + key)];
+
+    if (voiceIndex >= 0)
+        releaseVoice(voiceIndex);
+
+    return voiceIndex;
+}
+
+void VoicePool::releaseVoice(int voiceIndex)
+{
+    SynthVoice& voice = voices[(size_t) voiceIndex];
+
+    if (!voice.held)
+        return;
+
+    if (voice.prevOnKey >= 0)
+        voices[(size_t) voice.prevOnKey].nextOnKey = voice.nextOnKey;
+    else
+        keyHeads[(size_t) (voice.channel * 128 + voice.key)] = voice.nextOnKey;
+
+    if (voice.nextOnKey >= 0)
+        voices[(size_t) voice.nextOnKey].prevOnKey = voice.prevOnKey;
+
+    voice.prevOnKey = -1;
+    voice.nextOnKey = -1;
+    voice.held = false;
+}
+
+void VoicePool::freeVoice(int voiceIndex)
+{
+    SynthVoice& voice = voices[(size_t) voiceIndex];
+
+    if (voice.activeSlot < 0)
+        return;
+
+    releaseVoice(voiceIndex);
+
+    // 从活动数组中移除：用最后一个元素填补空位
+    const int32_t last = activeVoices[(size_t) --numActive];
+    activeVoices[(size_t) voice.activeSlot] = last;
+    voices[(size_t) last].activeSlot = voice.activeSlot;
+    voice.activeSlot = -1;
+
+    // 从年龄链表中移除
+    if (voice.olderVoice >= 0)
+        voices[(size_t) voice.olderVoice].newerVoice = voice.newerVoice;
+    else
+        oldestVoice = voice.newerVoice;
+
+    if (voice.newerVoice >= 0)
+        voices[(size_t) voice.newerVoice].olderVoice = voice.olderVoice;
+    else
+        newestVoice = voice.olderVoice;
+
+    voice.olderVoice = -1;
+    voice.newerVoice = -1;
+
+    freeVoices[(size_t) numFree++] = voiceIndex;
+}
+
+void VoicePool::stealOldestVoice()
+{
+    if (oldestVoice < 0)
+        return;
+
+    freeVoice(oldestVoice);
+    ++numStolen;
+}
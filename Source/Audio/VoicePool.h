@@ -0,0 +1,80 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_VOICEPOOL_H
+#define CANDYJAR_VOICEPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 单个发声体的状态
+struct SynthVoice
+{
+    float phase = 0.0f;
+    float phaseIncrement = 0.0f;
+    float gain = 0.0f;
+    float envelope = 0.0f;
+    float envelopeStep = 0.0f;   // > 0 为起音，< 0 为释放
+    uint8_t channel = 0;
+    uint8_t key = 0;
+    bool held = false;           // 还在等待 Note Off
+
+    // 按开始时间排序的双向链表，用于 O(1) 抢占最老的发声体
+    int32_t olderVoice = -1;
+    int32_t newerVoice = -1;
+
+    // 同一 (通道, 音高) 上仍按住的发声体链表，最新的在表头
+    int32_t prevOnKey = -1;
+    int32_t nextOnKey = -1;
+
+    // 在活动数组中的位置
+    int32_t activeSlot = -1;
+};
+
+// 固定容量的发声体池
+// 所有内存在构造时一次性分配，分配、释放、抢占都是 O(1)，不加锁，只能在单个线程（音频线程）中使用
+class VoicePool
+{
+public:
+    explicit VoicePool(int capacity);
+
+    // 为 (channel, key) 开始一个新的发声体，池满时抢占最老的一个，返回下标
+    int startVoice(int channel, int key);
+
+    // 找到 (channel, key) 上最新按住的发声体并把它移出按键链表，没有时返回 -1
+    int releaseKey(int channel, int key);
+
+    // 把发声体移出按键链表（进入释放阶段，之后的 Note Off 不再匹配到它）
+    void releaseVoice(int voiceIndex);
+
+    // 立即回收一个发声体（释放包络结束或被抢占时调用）
+    void freeVoice(int voiceIndex);
+
+    // 抢占最老的发声体（计入 getNumStolen()），没有活动发声体时不做任何事
+    void stealOldestVoice();
+
+    void reset();
+
+    int getCapacity() const { return (int) voices.size(); }
+    int getNumActive() const { return numActive; }
+    const int32_t* getActiveVoices() const { return activeVoices.data(); }
+    uint64_t getNumStolen() const { return numStolen; }
+
+    SynthVoice& operator[] (int voiceIndex) { return voices[(size_t) voiceIndex]; }
+    const SynthVoice& operator[] (int voiceIndex) const { return voices[(size_t) voiceIndex]; }
+
+private:
+    std::vector<SynthVoice> voices;
+    std::vector<int32_t> freeVoices;     // 空闲下标栈
+    std::vector<int32_t> activeVoices;   // 紧凑的活动下标数组，渲染时顺序遍历
+    std::vector<int32_t> keyHeads;       // 16 * 128 个按键链表头
+    int numFree = 0;
+    int numActive = 0;
+    int32_t oldestVoice = -1;
+    int32_t newestVoice = -1;
+    uint64_t numStolen = 0;
+};
+
+#endif //CANDYJAR_VOICEPOOL_H
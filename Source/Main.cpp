@@ -8,6 +8,8 @@
 
 #include <JuceHeader.h>
 #include "MainComponent.h"
+#include "Audio/OfflineRenderer.h"
+#include <iostream>
 
 //==============================================================================
 class CandyJarApplication  : public juce::JUCEApplication
@@ -25,6 +27,16 @@ public:
     {
         // This method is where you should put your application's initialisation code..
 
+        // 命令行渲染模式：CandyJar --render in.mid out.wav [--threads N]，不创建窗口
+        const juce::StringArray arguments = getCommandLineParameterArray();
+
+        if (arguments.contains ("--render"))
+        {
+            setApplicationReturnValue (runOfflineRender (arguments) ? 0 : 1);
+            quit();
+            return;
+        }
+
         mainWindow.reset (new MainWindow (getApplicationName()));
     }
 
@@ -98,6 +110,47 @@ public:
 
 private:
     std::unique_ptr<MainWindow> mainWindow;
+
+    static bool runOfflineRender (const juce::StringArray& arguments)
+    {
+        const int renderIndex = arguments.indexOf ("--render");
+
+        if (renderIndex + 2 >= arguments.size())
+        {
+            std::cerr << "Usage: CandyJar --render <input.mid> <output.wav> [--threads N]" << std::endl;
+            return false;
+        }
+
+        const auto workingDirectory = juce::File::getCurrentWorkingDirectory();
+        const auto inputFile  = workingDirectory.getChildFile (arguments[renderIndex + 1]);
+        const auto outputFile = workingDirectory.getChildFile (arguments[renderIndex + 2]);
+
+        OfflineRenderOptions options;
+        const int threadsIndex = arguments.indexOf ("--threads");
+
+        if (threadsIndex >= 0 && threadsIndex + 1 < arguments.size())
+            options.numThreads = arguments[threadsIndex + 1].getIntValue();
+
+        OfflineRenderResult result;
+        juce::String error;
+
+        if (! OfflineRenderer::render (inputFile, outputFile, options, result, error))
+        {
+            std::cerr << "Render failed: " << error << std::endl;
+            return false;
+        }
+
+        std::cout << "Rendered " << juce::String (result.audioSeconds, 2) << " s of audio to "
+                  << outputFile.getFullPathName() << std::endl
+                  << "Load: " << juce::String (result.loadSeconds, 3) << " s, render: "
+                  << juce::String (result.renderSeconds, 3) << " s, speed: "
+                  << juce::String (result.getSpeed(), 1) << "x realtime" << std::endl;
+
+        if (result.stolenVoices > 0)
+            std::cout << "Stolen voices: " << (juce::int64) result.stolenVoices << std::endl;
+
+        return true;
+    }
 };
 
 //==============================================================================
@@ -10,12 +10,23 @@ MainComponent::MainComponent() :
     openMidiButton->addListener(this);
     addAndMakeVisible(openMidiButton.get());
     
+    // 创建流式打开按钮：不做完整加载，打开后立即边解码边播放
+    streamMidiButton = std::make_unique<juce::TextButton>("Stream MIDI File");
+    streamMidiButton->addListener(this);
+    addAndMakeVisible(streamMidiButton.get());
+    
     // 创建取消加载按钮
     cancelLoadButton = std::make_unique<juce::TextButton>("Cancel Load");
     cancelLoadButton->addListener(this);
     cancelLoadButton->setVisible(false);
     addAndMakeVisible(cancelLoadButton.get());
     
+    // 创建播放按钮，加载成功后才可用
+    playButton = std::make_unique<juce::TextButton>("Play");
+    playButton->addListener(this);
+    playButton->setEnabled(false);
+    addAndMakeVisible(playButton.get());
+    
     // 创建进度条
     progressBar = std::make_unique<juce::ProgressBar>(progressValue);
     progressBar->setVisible(false);
@@ -28,8 +39,19 @@ MainComponent::MainComponent() :
     outputText->setFont(juce::FontOptions(14.0f));
     addAndMakeVisible(outputText.get());
     
-    // 创建MIDI解析器
-    midiParser = std::make_unique<MidiParser>();
+    // 加载任务使用的解析器，并行步骤在共用的线程池中执行
+    auto parser = std::make_unique<MidiParser>();
+    parser->setSharedThreadPool(&threadPool);
+    parserSlot.put(std::move(parser));
+    
+    // 创建钢琴卷帘，播放时跟随播放位置
+    pianoRoll = std::make_unique<PianoRollComponent>(threadPool);
+    pianoRoll->getPlayPosition = [this] { return isPlaying ? synthEngine->getPositionInSeconds() : -1.0; };
+    addAndMakeVisible(pianoRoll.get());
+    
+    // 创建合成引擎并打开默认输出设备（立体声，无输入）
+    synthEngine = std::make_unique<SynthEngine>();
+    deviceManager.initialiseWithDefaultDevices(0, 2);
     
     // 显示初始状态消息
     outputText->clear();
@@ -39,7 +61,7 @@ MainComponent::MainComponent() :
     outputText->moveCaretToEnd();
     outputText->insertTextAtCaret("Features: Progress tracking, statistics, multi-threading.\n");
     
-    setSize (600, 400);
+    setSize (1000, 600);
     
     // 启动定时器检查加载状态
     startTimer(100); // 每100毫秒检查一次
@@ -48,6 +70,12 @@ MainComponent::MainComponent() :
 MainComponent::~MainComponent()
 {
     stopTimer();
+    stopPlayback();
+    pianoRoll->setSong(nullptr, nullptr);
+    
+    // 退出时等待所有任务收尾，取消在50毫秒内生效
+    retireCurrentJob();
+    retiringJobs.clear();
 }
 
 //==============================================================================
@@ -70,142 +98,188 @@ void MainComponent::resized()
     // 设置按钮和文本区域的位置
     auto area = getLocalBounds();
     auto buttonArea = area.removeFromTop(40);
-    auto openButtonArea = buttonArea.removeFromLeft(buttonArea.getWidth() / 2).withSizeKeepingCentre(150, 30);
+    const int buttonWidth = buttonArea.getWidth() / 4;
+    auto openButtonArea = buttonArea.removeFromLeft(buttonWidth).withSizeKeepingCentre(150, 30);
+    auto streamButtonArea = buttonArea.removeFromLeft(buttonWidth).withSizeKeepingCentre(150, 30);
+    auto playButtonArea = buttonArea.removeFromLeft(buttonWidth).withSizeKeepingCentre(150, 30);
     auto cancelButtonArea = buttonArea.withSizeKeepingCentre(150, 30);
     
     openMidiButton->setBounds(openButtonArea);
+    streamMidiButton->setBounds(streamButtonArea);
+    playButton->setBounds(playButtonArea);
     cancelLoadButton->setBounds(cancelButtonArea);
     
     // 设置进度条位置
     auto progressArea = area.removeFromTop(30).reduced(10, 5);
     progressBar->setBounds(progressArea);
     
-    // 设置文本区域占据剩余空间
-    outputText->setBounds(area.reduced(10));
+    // 左侧是文本区域，剩余空间给钢琴卷帘
+    outputText->setBounds(area.removeFromLeft(juce::jmin(320, area.getWidth() / 2)).reduced(10));
+    pianoRoll->setBounds(area.reduced(10));
 }
 
 void MainComponent::buttonClicked (juce::Button* button)
 {
     if (button == openMidiButton.get())
     {
-        if (isLoading)
-        {
-            outputText->moveCaretToEnd();
-            outputText->insertTextAtCaret("Already loading a file. Please wait or cancel.\n");
-            return;
-        }
-        
-        // 创建文件选择器
-        fileChooser = std::make_unique<juce::FileChooser>("Select a MIDI file to load...",
-                                                         juce::File::getSpecialLocation(juce::File::userHomeDirectory),
-                                                         "*.mid;*.midi");
-        
-        auto folderChooserFlags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
-        
-        fileChooser->launchAsync(folderChooserFlags, [this](const juce::FileChooser& chooser)
-        {
-            juce::File midiFile (chooser.getResult());
-            if (midiFile.existsAsFile())
-            {
-                loadMidiFile(midiFile);
-            }
-            else if (!midiFile.existsAsFile() && midiFile.getFullPathName() != "")
-            {
-                outputText->moveCaretToEnd();
-                outputText->insertTextAtCaret("Selected file does not exist: " + midiFile.getFullPathName() + "\n");
-            }
-            else
-            {
-                outputText->moveCaretToEnd();
-                outputText->insertTextAtCaret("No file selected.\n");
-            }
-        });
+        chooseMidiFile(false);
+    }
+    else if (button == streamMidiButton.get())
+    {
+        chooseMidiFile(true);
+    }
+    else if (button == playButton.get())
+    {
+        if (isPlaying)
+            stopPlayback();
+        else
+            startPlayback();
     }
     else if (button == cancelLoadButton.get())
     {
-        if (isLoading)
+        if (isLoading && !currentJob->isFinished())
         {
-            midiParser->cancelLoading();
+            currentJob->cancel();
             outputText->moveCaretToEnd();
             outputText->insertTextAtCaret("Cancelling load operation...\n");
         }
     }
 }
 
-void MainComponent::loadMidiFile(const juce::File& file)
+void MainComponent::chooseMidiFile(bool streaming)
 {
+    // 加载过程中也可以选择新文件，旧的加载会在后台取消
+    // 创建文件选择器
+    fileChooser = std::make_unique<juce::FileChooser>(streaming ? "Select a MIDI file to stream..." : "Select a MIDI file to load...",
+                                                     juce::File::getSpecialLocation(juce::File::userHomeDirectory),
+                                                     "*.mid;*.midi");
+    
+    auto folderChooserFlags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
+    
+    fileChooser->launchAsync(folderChooserFlags, [this, streaming](const juce::FileChooser& chooser)
+    {
+        juce::File midiFile (chooser.getResult());
+        if (midiFile.existsAsFile())
+        {
+            loadMidiFile(midiFile, streaming ? LoadJob::Mode::stream : LoadJob::Mode::load);
+        }
+        else if (!midiFile.existsAsFile() && midiFile.getFullPathName() != "")
+        {
+            outputText->moveCaretToEnd();
+            outputText->insertTextAtCaret("Selected file does not exist: " + midiFile.getFullPathName() + "\n");
+        }
+        else
+        {
+            outputText->moveCaretToEnd();
+            outputText->insertTextAtCaret("No file selected.\n");
+        }
+    });
+}
+
+void MainComponent::loadMidiFile(const juce::File& file, LoadJob::Mode mode)
+{
+    // 旧任务的数据即将被释放，先停止播放
+    stopPlayback();
+    playButton->setEnabled(false);
+    
+    // 引擎引用着旧任务的事件，先解除再释放
+    synthEngine->setSong(nullptr, nullptr);
+    
+    // 旧任务（不管是否还在加载）交给后台取消和释放，这里不等待
+    pianoRoll->setSong(nullptr, nullptr);
+    retireCurrentJob();
+    
     isLoading = true;
-    loadingCompleted = false;
     progressValue = 0.0;
     progressBar->setVisible(true);
     cancelLoadButton->setVisible(true);
-    fileToLoad = file;
     
     outputText->clear();
-    outputText->setText("Loading MIDI file: " + file.getFileName() + "\n");
+    outputText->setText((mode == LoadJob::Mode::stream ? "Streaming MIDI file: " : "Loading MIDI file: ") + file.getFileName() + "\n");
     outputText->moveCaretToEnd();
     outputText->repaint();
     
-    // 记录开始时间
-    storedStartTime = juce::Time::getMillisecondCounterHiRes();
-    
-    // 启动异步加载
-    loadFuture = midiParser->loadMidiFileAsync(file, [this](int progress, const juce::String& message) {
-        juce::MessageManager::callAsync([this, progress, message]() {
-            updateProgress(progress, message);
-        });
-    });
+    // 启动后台加载，进度和完成状态由定时器轮询
+    // 流式打开也放在后台：恢复模式下块长度不对时扫描块头可能要搜索整个文件
+    currentJob = std::make_unique<LoadJob>(file, MidiLoadOptions(), &parserSlot, mode);
+}
+
+void MainComponent::retireCurrentJob()
+{
+    if (currentJob == nullptr)
+        return;
     
-    // 启动线程等待异步操作完成
-    std::thread([this]() {
-        // 等待异步操作完成
-        bool result = loadFuture.get();
-        
-        // 记录结束时间
-        auto endTime = juce::Time::getMillisecondCounterHiRes();
-        auto timeElapsed = endTime - storedStartTime;
-        
-        // 在主线程中完成加载
-        juce::MessageManager::callAsync([this, result, timeElapsed]() {
-            loadingCompleted = true;
-            loadingResult = result;
-            elapsedTime = timeElapsed;
-        });
-    }).detach();
+    currentJob->retire();
+    retiringJobs.push_back(std::move(currentJob));
+}
+
+void MainComponent::destroyRetiredJobs()
+{
+    // 只销毁已经收尾的任务，此时析构中的 join 不会阻塞
+    retiringJobs.erase(std::remove_if(retiringJobs.begin(), retiringJobs.end(),
+                                      [](const std::unique_ptr<LoadJob>& job) { return job->isRetired(); }),
+                       retiringJobs.end());
 }
 
-void MainComponent::updateProgress(int percentage, const juce::String& message)
+void MainComponent::updateLoadProgress()
 {
-    // 更新进度条
-    progressValue = percentage / 100.0;
+    const LoadProgress& progress = currentJob->getProgress();
+    const LoadPhase phase = progress.getPhase();
+    progressValue = progress.getFraction();
     
-    // 更新文本显示
-    outputText->moveCaretToEnd();
-    outputText->insertTextAtCaret("[" + juce::String(percentage) + "%] " + message + "\n");
+    // 进度条上只显示当前阶段和计数，不再向文本框追加日志
+    juce::String text = LoadProgress::getPhaseName(phase);
     
-    // 强制刷新显示
-    outputText->repaint();
-    progressBar->repaint();
+    if (phase == LoadPhase::decoding)
+    {
+        // 解码时的部分统计，同一个快照中的计数彼此一致
+        const LoadSnapshot live = progress.live.read();
+        text << ": " << live.tracksDone << "/" << progress.totalTracks.load() << " tracks, "
+             << (juce::int64) live.events << " events, " << (juce::int64) live.notes << " notes, "
+             << juce::String(live.seconds, 1) << " s";
+    }
+    else if (phase == LoadPhase::merging)
+    {
+        text << ": " << (juce::int64) progress.eventsMerged.load() << "/" << (juce::int64) progress.totalMergeEvents.load() << " events";
+    }
+    
+    text << " (" << juce::roundToInt(progressValue * 100.0) << "%)";
+    progressBar->setTextToDisplay(text);
 }
 
 void MainComponent::checkLoadingStatus()
 {
-    if (loadingCompleted.load() && isLoading)
+    if (isLoading && currentJob->isFinished())
     {
         isLoading = false;
         cancelLoadButton->setVisible(false);
         
-        if (loadingResult.load())
+        const MidiParser& parser = currentJob->getParser();
+        
+        if (currentJob->wasSuccessful() && currentJob->isStreaming())
+        {
+            loadingFinished(true, parser.getLastErrorMessage(), currentJob->getElapsedMilliseconds());
+            
+            const MidiEventStream& stream = currentJob->getStream();
+            outputText->moveCaretToEnd();
+            outputText->insertTextAtCaret("Decode window: " + juce::String((int) stream.getWindowEvents()) + " events per track, "
+                                          + juce::String((double) stream.getMemoryUsage() / 1024.0, 1) + " KB\n");
+            
+            playButton->setEnabled(true);
+            startPlayback();
+        }
+        else if (currentJob->wasSuccessful())
         {
-            loadingFinished(true, "MIDI file loaded successfully", elapsedTime.load());
+            loadingFinished(true, parser.isLoadedFromCache() ? "MIDI file loaded from cache" : "MIDI file loaded successfully",
+                            currentJob->getElapsedMilliseconds());
             displayStatistics();
+            pianoRoll->setSong(&currentJob->getNotePyramid(), &parser.getTempoMap());
+            playButton->setEnabled(true);
         }
         else
         {
-            loadingFinished(false, midiParser->getLastErrorMessage(), elapsedTime.load());
+            loadingFinished(false, currentJob->getErrorMessage(), currentJob->getElapsedMilliseconds());
         }
-        
-        loadingCompleted = false;
     }
 }
 
@@ -214,7 +288,7 @@ void MainComponent::loadingFinished(bool success, const juce::String& message, d
     if (success)
     {
         outputText->moveCaretToEnd();
-        outputText->insertTextAtCaret("\nSuccessfully loaded MIDI file!\n");
+        outputText->insertTextAtCaret("\n" + message + "\n");
         outputText->moveCaretToEnd();
         outputText->insertTextAtCaret("Load time: " + juce::String(timeElapsed, 2) + " ms\n");
     }
@@ -230,6 +304,7 @@ void MainComponent::loadingFinished(bool success, const juce::String& message, d
     
     // 保持进度条可见，显示最终结果
     progressValue = success ? 1.0 : 0.0; // 成功显示100%，失败显示0%
+    progressBar->setTextToDisplay({});
     
     // 强制刷新显示
     outputText->repaint();
@@ -238,7 +313,7 @@ void MainComponent::loadingFinished(bool success, const juce::String& message, d
 
 void MainComponent::displayStatistics()
 {
-    const MidiStatistics& stats = midiParser->getStatistics();
+    const MidiStatistics& stats = currentJob->getParser().getStatistics();
     
     outputText->moveCaretToEnd();
     outputText->insertTextAtCaret("\n--- MIDI File Statistics ---\n");
@@ -249,14 +324,124 @@ void MainComponent::displayStatistics()
     outputText->moveCaretToEnd();
     outputText->insertTextAtCaret("Total Notes: " + juce::String(stats.totalNotes) + "\n");
     outputText->moveCaretToEnd();
-    outputText->insertTextAtCaret("Duration: " + juce::String(stats.totalDuration, 2) + " ticks\n");
+    outputText->insertTextAtCaret("Duration: " + juce::String(stats.totalDuration, 2) + " s (" + juce::String(stats.totalTicks) + " ticks)\n");
+    outputText->moveCaretToEnd();
+    outputText->insertTextAtCaret("Tempo Changes: " + juce::String(stats.tempoChanges) + "\n");
     outputText->moveCaretToEnd();
     outputText->insertTextAtCaret("File Type: " + juce::String(stats.fileType) + "\n");
     outputText->moveCaretToEnd();
     outputText->insertTextAtCaret("Time Format: " + juce::String(stats.timeFormat) + "\n");
+    outputText->moveCaretToEnd();
+    outputText->insertTextAtCaret("Max Polyphony: " + juce::String(stats.maxPolyphony) + "\n");
+    
+    if (stats.repairedAnomalies > 0)
+    {
+        outputText->moveCaretToEnd();
+        outputText->insertTextAtCaret("Repaired Anomalies: " + juce::String(stats.repairedAnomalies) + "\n");
+    }
+    
+    // 事件类型分布
+    static const char* const eventTypeNames[] = { "Note Off", "Note On", "Poly Aftertouch", "Controller",
+                                                  "Program Change", "Channel Pressure", "Pitch Bend", "Meta/SysEx" };
+    
+    outputText->moveCaretToEnd();
+    outputText->insertTextAtCaret("\n--- Event Types ---\n");
+    for (int i = 0; i < 8; ++i)
+    {
+        outputText->moveCaretToEnd();
+        outputText->insertTextAtCaret(juce::String(eventTypeNames[i]) + ": " + juce::String(stats.eventTypeCounts[i]) + "\n");
+    }
+    
+    // 每个通道的音符数（跳过没有音符的通道）
+    outputText->moveCaretToEnd();
+    outputText->insertTextAtCaret("\n--- Notes per Channel ---\n");
+    for (int channel = 0; channel < 16; ++channel)
+    {
+        if (stats.channelNoteCounts[channel] == 0)
+            continue;
+        
+        outputText->moveCaretToEnd();
+        outputText->insertTextAtCaret("Channel " + juce::String(channel + 1) + ": " + juce::String(stats.channelNoteCounts[channel]) + "\n");
+    }
+    
+    // 各阶段耗时
+    outputText->moveCaretToEnd();
+    outputText->insertTextAtCaret("\n--- Load Report ---\n" + currentJob->getParser().getLoadReport().toString());
+}
+
+void MainComponent::startPlayback()
+{
+    if (isPlaying || isLoading)
+        return;
+    
+    if (currentJob == nullptr || !currentJob->wasSuccessful())
+        return;
+    
+    // 先设置好曲目再挂上音频回调，回调线程看到的总是完整的状态
+    if (currentJob->isStreaming())
+    {
+        synthEngine->setStream(&currentJob->getStream());
+    }
+    else
+    {
+        const MidiParser& parser = currentJob->getParser();
+        synthEngine->setSong(&parser.getMergedEvents(), &parser.getTempoMap());
+    }
+    
+    deviceManager.addAudioCallback(synthEngine.get());
+    
+    isPlaying = true;
+    playButton->setButtonText("Stop");
+}
+
+void MainComponent::stopPlayback()
+{
+    if (!isPlaying)
+        return;
+    
+    // removeAudioCallback 会等待正在执行的回调结束
+    deviceManager.removeAudioCallback(synthEngine.get());
+    
+    isPlaying = false;
+    playButton->setButtonText("Play");
+    
+    // 事件队列的统计
+    const EventQueueStats& stats = synthEngine->getQueueStats();
+    const juce::int64 callbacks = (juce::int64) stats.callbacks.load();
+    
+    if (callbacks > 0)
+    {
+        outputText->moveCaretToEnd();
+        outputText->insertTextAtCaret("\nPlayback: " + juce::String(callbacks) + " callbacks, "
+                                      + juce::String((juce::int64) stats.underruns.load()) + " underruns, "
+                                      + juce::String((juce::int64) stats.lateEvents.load()) + " late events, max queue depth "
+                                      + juce::String(stats.maxQueueDepth.load()) + "\n");
+        outputText->moveCaretToEnd();
+        outputText->insertTextAtCaret("Event time per callback: "
+                                      + juce::String((double) stats.totalEventNanoseconds.load() / 1000.0 / (double) callbacks, 1) + " us average, "
+                                      + juce::String((double) stats.maxEventNanoseconds.load() / 1000.0, 1) + " us max\n");
+        outputText->moveCaretToEnd();
+        outputText->insertTextAtCaret("Voices stolen: " + juce::String((juce::int64) synthEngine->getNumStolenVoices())
+                                      + ", voice limit " + juce::String(synthEngine->getVoiceLimit()) + "\n");
+    }
+    
+    // 流式播放时轨道内容在播放中才解码，解码错误到这里才知道
+    if (currentJob != nullptr && currentJob->isStreaming() && currentJob->getStream().getErrorMessage().isNotEmpty())
+    {
+        outputText->moveCaretToEnd();
+        outputText->insertTextAtCaret("Stream error: " + currentJob->getStream().getErrorMessage() + "\n");
+    }
 }
 
 void MainComponent::timerCallback()
 {
+    if (isLoading)
+        updateLoadProgress();
+    
     checkLoadingStatus();
+    destroyRetiredJobs();
+    
+    // 播放完毕后自动停止
+    if (isPlaying && synthEngine->isFinished())
+        stopPlayback();
 }
\ No newline at end of file
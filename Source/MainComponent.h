@@ -1,7 +1,9 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include "MidiParser/MidiParser.h"
+#include "MidiParser/LoadJob.h"
+#include "Audio/SynthEngine.h"
+#include "PianoRoll/PianoRollComponent.h"
 
 //==============================================================================
 /*
@@ -25,28 +27,43 @@ public:
 private:
     //==============================================================================
     // Your private member variables go here...
+    // 加载和钢琴卷帘共用的线程池（要比解析器和钢琴卷帘活得久，所以放在最前面）
+    WorkStealingPool threadPool;
+    // 先后的加载任务轮流使用同一个解析器，内存池在加载之间复用
+    ParserSlot parserSlot;
+    
     std::unique_ptr<juce::TextButton> openMidiButton;
+    std::unique_ptr<juce::TextButton> streamMidiButton;
     std::unique_ptr<juce::TextButton> cancelLoadButton;
+    std::unique_ptr<juce::TextButton> playButton;
     std::unique_ptr<juce::TextEditor> outputText;
-    std::unique_ptr<MidiParser> midiParser;
+    std::unique_ptr<PianoRollComponent> pianoRoll;
     std::unique_ptr<juce::FileChooser> fileChooser;
     std::unique_ptr<juce::ProgressBar> progressBar;
     double progressValue;
     bool isLoading;
-    juce::File fileToLoad;
-    std::future<bool> loadFuture;
-    std::atomic<bool> loadingCompleted {false};
-    std::atomic<bool> loadingResult {false};
-    std::atomic<double> elapsedTime {0.0};
-    juce::String resultMessage;
-    double storedStartTime;
+    
+    // 当前的加载任务（加载完成后保留，统计和播放都使用它的解析器；流式打开时播放它的事件流）
+    std::unique_ptr<LoadJob> currentJob;
+    // 已经放弃、正在后台取消和释放的任务，收尾后由定时器销毁
+    std::vector<std::unique_ptr<LoadJob>> retiringJobs;
+    
+    // 音频播放
+    juce::AudioDeviceManager deviceManager;
+    std::unique_ptr<SynthEngine> synthEngine;
+    bool isPlaying = false;
     
     // 方法
-    void loadMidiFile(const juce::File& file);
-    void updateProgress(int percentage, const juce::String& message);
+    void chooseMidiFile(bool streaming);
+    void loadMidiFile(const juce::File& file, LoadJob::Mode mode);
+    void updateLoadProgress();
     void checkLoadingStatus();
     void loadingFinished(bool success, const juce::String& message, double timeElapsed);
     void displayStatistics();
+    void startPlayback();
+    void stopPlayback();
+    void retireCurrentJob();
+    void destroyRetiredJobs();
     
     // Timer callback
     void timerCallback() override;
@@ -0,0 +1,345 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "CompressedTrackEvents.h"
+#include <array>
+#include <utility>
+
+#if defined (__x86_64__) || defined (_M_X64)
+ #define CANDYJAR_COMPRESSED_SSE2 1
+ #include <emmintrin.h>
+#else
+ #define CANDYJAR_COMPRESSED_SSE2 0
+#endif
+
+namespace
+{
+    // 列按小端序从低位开始连续打包；读写都一次访问8个字节，数据末尾留出这么多填充
+    constexpr size_t paddingBytes = 8;
+    constexpr size_t groupSize = CompressedTrackEvents::eventsPerGroup;
+
+    inline uint8_t bitsFor(uint32_t maxValue)
+    {
+        uint8_t bits = 0;
+        while (((uint64_t) maxValue >> bits) != 0)
+            ++bits;
+        return bits;
+    }
+
+    inline uint64_t loadWord(const uint8_t* source)
+    {
+        uint64_t word;
+        std::memcpy(&word, source, sizeof(word));
+        return word;
+    }
+
+    inline void storeWord(uint8_t* destination, uint64_t word)
+    {
+        std::memcpy(destination, &word, sizeof(word));
+    }
+
+    // 第 i 个值写在第 i * bits 位，目标内存已清零
+    inline void packValue(uint8_t* column, size_t index, int bits, uint64_t value)
+    {
+        const size_t bit = index * (size_t) bits;
+        uint8_t* destination = column + bit / 8;
+        storeWord(destination, loadWord(destination) | value << (bit % 8));
+    }
+
+    // 把一组 8 个 bits 位的值（在 word 的低 8 * bits 位）摊开到 8 个字节，第 k 个值在第 k 个字节
+    // 第 k 个值要左移 k * (8 - bits) 位，按 k 的二进制位分三步，每步把一半的值整体左移
+    template <int bits>
+    inline uint64_t spreadToBytes(uint64_t word)
+    {
+        static_assert(bits >= 1 && bits <= 8, "byte fields only");
+
+        if constexpr (bits == 8)
+        {
+            return word;
+        }
+        else
+        {
+            constexpr int gap = 8 - bits;
+            constexpr uint64_t field = ((uint64_t) 1 << bits) - 1;
+            constexpr uint64_t lowFour = ((uint64_t) 1 << (4 * bits)) - 1;
+            constexpr uint64_t lowTwo = (((uint64_t) 1 << (2 * bits)) - 1) * (((uint64_t) 1 << 32) + 1);
+            constexpr uint64_t lowOne = field * 0x0001000100010001ull;
+
+            word &= ((uint64_t) 1 << (8 * bits)) - 1;
+            word = (word & lowFour) | ((word & ~lowFour) << (4 * gap));
+            word = (word & lowTwo) | ((word & ~lowTwo) << (2 * gap));
+            return (word & lowOne) | ((word & ~lowOne) << gap);
+        }
+    }
+
+    // 一组 8 个值正好占 bits 个字节，组内每个值的位置都是常量；用折叠表达式展开，不依赖编译器的循环展开
+    template <int bits, size_t... k>
+    inline void unpackDeltaGroup(const uint8_t* column, uint32_t* output, std::index_sequence<k...>)
+    {
+        constexpr uint64_t mask = ((uint64_t) 1 << bits) - 1;
+        ((output[k] = (uint32_t) ((loadWord(column + k * bits / 8) >> (k * bits % 8)) & mask)), ...);
+    }
+
+    template <int bits>
+    void unpackDeltas(const uint8_t* column, size_t numGroups, uint32_t* output)
+    {
+        if constexpr (bits == 0)
+        {
+            std::fill(output, output + numGroups * groupSize, 0u);
+        }
+       #if CANDYJAR_COMPRESSED_SSE2
+        else if constexpr (bits <= 8)
+        {
+            // 常见的小 delta：摊开到字节后用 SSE2 扩展成 32 位
+            const __m128i zero = _mm_setzero_si128();
+
+            for (size_t group = 0; group < numGroups; ++group, column += bits, output += groupSize)
+            {
+                const __m128i bytes = _mm_cvtsi64_si128((long long) spreadToBytes<bits>(loadWord(column)));
+                const __m128i words = _mm_unpacklo_epi8(bytes, zero);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_unpacklo_epi16(words, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 4), _mm_unpackhi_epi16(words, zero));
+            }
+        }
+       #endif
+        else
+        {
+            for (size_t group = 0; group < numGroups; ++group, column += bits, output += groupSize)
+                unpackDeltaGroup<bits>(column, output, std::make_index_sequence<groupSize>());
+        }
+    }
+
+    // 字节列（status、data1、data2）最多 8 位，一组只需要读一次，再经过字典转换：
+    // dictionary 为 nullptr 时摊开后直接存值（data1），两项的字典摊开后是一次乘加，更多项逐个查表
+    template <int bits, size_t... k>
+    inline void lookupGroup(uint64_t word, uint8_t* output, const uint8_t* dictionary, std::index_sequence<k...>)
+    {
+        constexpr uint64_t mask = ((uint64_t) 1 << bits) - 1;
+        ((output[k] = dictionary[(word >> (k * bits)) & mask]), ...);
+    }
+
+    template <int bits>
+    void unpackBytes(const uint8_t* column, size_t numGroups, uint8_t* output, const uint8_t* dictionary)
+    {
+        if constexpr (bits == 0)
+        {
+            std::memset(output, dictionary != nullptr ? dictionary[0] : 0, numGroups * groupSize);
+        }
+        else
+        {
+            constexpr uint64_t everyByte = 0x0101010101010101ull;
+
+            if (dictionary == nullptr)
+            {
+                for (size_t group = 0; group < numGroups; ++group, column += bits, output += groupSize)
+                    storeWord(output, spreadToBytes<bits>(loadWord(column)));
+            }
+            else if (bits == 1)
+            {
+                // 字典按取值升序，下标为0/1时 第一项 + 下标 * 差值 不会跨字节进位
+                const uint64_t base = dictionary[0] * everyByte;
+                const uint64_t step = (uint64_t) (dictionary[1] - dictionary[0]);
+
+                for (size_t group = 0; group < numGroups; ++group, column += bits, output += groupSize)
+                    storeWord(output, base + spreadToBytes<bits>(loadWord(column)) * step);
+            }
+            else
+            {
+                for (size_t group = 0; group < numGroups; ++group, column += bits, output += groupSize)
+                    lookupGroup<bits>(loadWord(column), output, dictionary, std::make_index_sequence<groupSize>());
+            }
+        }
+    }
+
+    using DeltaUnpacker = void (*)(const uint8_t*, size_t, uint32_t*);
+    using ByteUnpacker = void (*)(const uint8_t*, size_t, uint8_t*, const uint8_t*);
+
+    template <size_t... widths>
+    constexpr std::array<DeltaUnpacker, sizeof...(widths)> makeDeltaUnpackers(std::index_sequence<widths...>)
+    {
+        return { &unpackDeltas<(int) widths>... };
+    }
+
+    template <size_t... widths>
+    constexpr std::array<ByteUnpacker, sizeof...(widths)> makeByteUnpackers(std::index_sequence<widths...>)
+    {
+        return { &unpackBytes<(int) widths>... };
+    }
+
+    // 按位宽分派到展开的解包函数
+    constexpr auto deltaUnpackers = makeDeltaUnpackers(std::make_index_sequence<33>());
+    constexpr auto byteUnpackers = makeByteUnpackers(std::make_index_sequence<9>());
+
+    // 标记 values 中出现过的取值，返回不同取值的个数
+    inline uint16_t markValues(const uint8_t* values, size_t count, bool* seen)
+    {
+        uint16_t numValues = 0;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!seen[values[i]])
+            {
+                seen[values[i]] = true;
+                ++numValues;
+            }
+        }
+
+        return numValues;
+    }
+
+    // 按取值从小到大写出字典，并建立取值到下标的映射
+    inline void writeDictionary(const bool* seen, uint8_t* dictionary, uint8_t* indices)
+    {
+        uint8_t next = 0;
+
+        for (int value = 0; value < 256; ++value)
+        {
+            if (seen[value])
+            {
+                dictionary[next] = (uint8_t) value;
+                indices[value] = next++;
+            }
+        }
+    }
+
+    inline size_t getNumGroups(size_t numEvents)
+    {
+        return (numEvents + groupSize - 1) / groupSize;
+    }
+
+    // 块数据中各部分相对块开头的偏移：状态字典、data2字典，然后是四列
+    struct BlockLayout
+    {
+        size_t data2Dictionary;
+        size_t deltaColumn;
+        size_t statusColumn;
+        size_t data1Column;
+        size_t data2Column;
+        size_t size;
+
+        explicit BlockLayout(const CompressedEventBlock& block)
+        {
+            const size_t numGroups = getNumGroups(block.numEvents);
+            data2Dictionary = block.numStatuses;
+            deltaColumn = data2Dictionary + block.numData2Values;
+            statusColumn = deltaColumn + numGroups * block.deltaBits;
+            data1Column = statusColumn + numGroups * block.statusBits;
+            data2Column = data1Column + numGroups * block.data1Bits;
+            size = data2Column + numGroups * block.data2Bits;
+        }
+    };
+}
+
+void CompressedTrackEvents::clear()
+{
+    blocks = nullptr;
+    payload = nullptr;
+    numBlocks = 0;
+    payloadBytes = 0;
+    numEvents = 0;
+}
+
+void CompressedTrackEvents::compress(const uint32_t* deltaTicks, const uint8_t* status, const uint8_t* data1, const uint8_t* data2,
+                                     size_t totalEvents, Arena& arena)
+{
+    clear();
+
+    if (totalEvents == 0)
+        return;
+
+    numEvents = totalEvents;
+    numBlocks = (totalEvents + eventsPerBlock - 1) / eventsPerBlock;
+    CompressedEventBlock* blockHeaders = arena.allocateArray<CompressedEventBlock>(numBlocks);
+
+    // 第一遍：每块的位宽和字典大小，得到总大小后一次分配
+    uint64_t tick = 0;
+    size_t bytes = 0;
+
+    for (size_t blockIndex = 0; blockIndex < numBlocks; ++blockIndex)
+    {
+        const size_t first = blockIndex * eventsPerBlock;
+        const size_t count = std::min(eventsPerBlock, totalEvents - first);
+
+        CompressedEventBlock& block = blockHeaders[blockIndex];
+        block = CompressedEventBlock();
+        block.startTick = tick;
+        block.dataOffset = bytes;
+        block.numEvents = (uint16_t) count;
+
+        // 按位或得到的最高位与最大值相同
+        uint32_t deltaBitsUsed = 0;
+        uint8_t data1BitsUsed = 0;
+
+        for (size_t i = first; i < first + count; ++i)
+        {
+            deltaBitsUsed |= deltaTicks[i];
+            data1BitsUsed |= data1[i];
+            tick += deltaTicks[i];
+        }
+
+        bool statusSeen[256] = {};
+        bool data2Seen[256] = {};
+
+        block.numStatuses = markValues(status + first, count, statusSeen);
+        block.numData2Values = markValues(data2 + first, count, data2Seen);
+        block.deltaBits = bitsFor(deltaBitsUsed);
+        block.statusBits = bitsFor(block.numStatuses - 1u);
+        block.data1Bits = bitsFor(data1BitsUsed);
+        block.data2Bits = bitsFor(block.numData2Values - 1u);
+
+        bytes += BlockLayout(block).size;
+    }
+
+    payloadBytes = bytes + paddingBytes;
+    uint8_t* data = arena.allocateArray<uint8_t>(payloadBytes);
+    std::memset(data, 0, payloadBytes);
+
+    // 第二遍：写字典和各列，列中的值之间没有对齐，写入时与已有的位按位或
+    for (size_t blockIndex = 0; blockIndex < numBlocks; ++blockIndex)
+    {
+        const CompressedEventBlock& block = blockHeaders[blockIndex];
+        const BlockLayout layout(block);
+        uint8_t* base = data + block.dataOffset;
+        const size_t first = blockIndex * eventsPerBlock;
+
+        bool statusSeen[256] = {};
+        bool data2Seen[256] = {};
+        uint8_t statusIndices[256];
+        uint8_t data2Indices[256];
+
+        markValues(status + first, block.numEvents, statusSeen);
+        markValues(data2 + first, block.numEvents, data2Seen);
+        writeDictionary(statusSeen, base, statusIndices);
+        writeDictionary(data2Seen, base + layout.data2Dictionary, data2Indices);
+
+        for (size_t i = 0; i < block.numEvents; ++i)
+        {
+            const size_t event = first + i;
+            packValue(base + layout.deltaColumn, i, block.deltaBits, deltaTicks[event]);
+            packValue(base + layout.statusColumn, i, block.statusBits, statusIndices[status[event]]);
+            packValue(base + layout.data1Column, i, block.data1Bits, data1[event]);
+            packValue(base + layout.data2Column, i, block.data2Bits, data2Indices[data2[event]]);
+        }
+    }
+
+    blocks = blockHeaders;
+    payload = data;
+}
+
+void CompressedTrackEvents::decode(size_t firstEvent, size_t count, uint32_t* deltaTicks, uint8_t* status, uint8_t* data1, uint8_t* data2) const
+{
+    const CompressedEventBlock& block = blocks[firstEvent / eventsPerBlock];
+    const BlockLayout layout(block);
+    const uint8_t* base = payload + block.dataOffset;
+
+    // 从第 firstGroup 组开始，每列跳过的字节数就是组数乘以位宽
+    const size_t firstGroup = (firstEvent % eventsPerBlock) / groupSize;
+    const size_t numGroups = getNumGroups(count);
+
+    deltaUnpackers[block.deltaBits](base + layout.deltaColumn + firstGroup * block.deltaBits, numGroups, deltaTicks);
+    byteUnpackers[block.statusBits](base + layout.statusColumn + firstGroup * block.statusBits, numGroups, status, base);
+    byteUnpackers[block.data1Bits](base + layout.data1Column + firstGroup * block.data1Bits, numGroups, data1, nullptr);
+    byteUnpackers[block.data2Bits](base + layout.data2Column + firstGroup * block.data2Bits, numGroups, data2,
+                                   base + layout.data2Dictionary);
+}
@@ -0,0 +1,70 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_COMPRESSEDTRACKEVENTS_H
+#define CANDYJAR_COMPRESSEDTRACKEVENTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include "../Utils/Arena.h"
+
+// 一块压缩事件的块头（32字节）
+struct CompressedEventBlock
+{
+    uint64_t startTick = 0;        // 块中第一个事件之前的绝对tick，从块中间开始读时不用从轨道开头累加
+    uint64_t dataOffset = 0;       // 块数据在 payload 中的偏移：状态字典、data2字典、四列位打包的字段
+    uint16_t numEvents = 0;
+    uint16_t numStatuses = 0;      // 字典大小
+    uint16_t numData2Values = 0;
+    uint8_t deltaBits = 0;         // 每列的位宽，0 表示这个字段在块内是常量（字典只有一项，或 delta / data1 全为0）
+    uint8_t statusBits = 0;
+    uint8_t data1Bits = 0;
+    uint8_t data2Bits = 0;
+};
+
+// 按固定大小的块压缩存放的轨道事件（MidiTrackEvents 的可选存储方式）
+//  - 每块 eventsPerBlock 个事件，块内四个字段各自一列，每列按块内的取值范围选位宽：
+//    delta 和 data1 直接存，status 和 data2（力度）只有很少几种取值，存块内字典的下标
+//  - 列中的值连续位打包，每 8 个值一组正好占"位宽"个字节；解压按位宽分派到展开的解包函数，
+//    组内的移位都是常量，没有分支
+//  - 黑乐谱中常见的轨道每个事件约 2 字节（未压缩为 7 字节）
+//  - 块头和数据都在 arena 中一次分配，压缩后只读
+class CompressedTrackEvents
+{
+public:
+    static constexpr size_t eventsPerBlock = 2048;
+    static constexpr size_t eventsPerGroup = 8;
+
+    // 压缩 numEvents 个事件（之前的内容被丢弃）
+    void compress(const uint32_t* deltaTicks, const uint8_t* status, const uint8_t* data1, const uint8_t* data2,
+                  size_t numEvents, Arena& arena);
+
+    // 解压 [firstEvent, firstEvent + numEvents) 到输出数组：这一段必须在同一块内，firstEvent 是 eventsPerGroup 的倍数，
+    // 按整组解压，输出数组要能放下 numEvents 向上取整到 eventsPerGroup 的倍数个事件
+    void decode(size_t firstEvent, size_t numEvents, uint32_t* deltaTicks, uint8_t* status, uint8_t* data1, uint8_t* data2) const;
+
+    // 只忘记内容，内存随 arena 一起回收
+    void clear();
+
+    size_t size() const { return numEvents; }
+    bool empty() const { return numEvents == 0; }
+
+    size_t getNumBlocks() const { return numBlocks; }
+    const CompressedEventBlock& getBlock(size_t blockIndex) const { return blocks[blockIndex]; }
+
+    // 第 eventIndex 个事件所在块的最后一个事件之后的下标
+    size_t getBlockEnd(size_t eventIndex) const { return std::min(numEvents, (eventIndex / eventsPerBlock + 1) * eventsPerBlock); }
+
+    // 块头和数据合计占用的字节数
+    size_t getBytesUsed() const { return numBlocks * sizeof(CompressedEventBlock) + payloadBytes; }
+
+private:
+    const CompressedEventBlock* blocks = nullptr;
+    const uint8_t* payload = nullptr;
+    size_t numBlocks = 0;
+    size_t payloadBytes = 0;
+    size_t numEvents = 0;
+};
+
+#endif //CANDYJAR_COMPRESSEDTRACKEVENTS_H
@@ -0,0 +1,399 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "IndexCache.h"
+#include "MidiParser.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr char cacheMagic[8] = { 'C', 'J', 'I', 'D', 'X', 0, 0, 0 };
+    constexpr uint32_t byteOrderMark = 0x01020304;
+    constexpr uint64_t sectionAlignment = 64;
+
+    enum Section
+    {
+        statisticsSection,
+        segmentSection,
+        startTickSection,
+        endTickSection,
+        keySection,
+        velocitySection,
+        channelSection,
+        trackIndexSection,
+        trackOffsetSection,
+        eventSection,
+        seekIndexSection,   // 之后依次是定位索引的各数组（见 SeekIndex::visitArrays）
+        numSections = seekIndexSection + SeekIndex::numArrays
+    };
+
+    // 缓存文件头，后面按 sectionOffsets 依次存放各段
+    struct CacheHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t headerSize;
+        uint32_t statisticsSize;
+        uint32_t segmentSize;
+        uint32_t eventSize;
+        uint64_t cacheSize;
+        IndexCacheKey key;
+        int32_t format;
+        int32_t numTracks;
+        int32_t timeFormat;
+        uint32_t headerLength;
+        uint32_t smpte;
+        int32_t maxPolyphony;
+        uint64_t numSegments;
+        uint64_t numNotes;
+        uint64_t numNoteTracks;
+        uint64_t numUnmatchedNotes;
+        uint64_t numEvents;
+        uint64_t seekIndexCounts[SeekIndex::numArrays];
+        uint64_t sectionOffsets[numSections];
+    };
+
+    void getSectionSizes(const CacheHeader& header, uint64_t* sizes)
+    {
+        sizes[statisticsSection] = sizeof(MidiStatistics);
+        sizes[segmentSection] = header.numSegments * sizeof(TempoMap::Segment);
+        sizes[startTickSection] = header.numNotes * sizeof(uint32_t);
+        sizes[endTickSection] = header.numNotes * sizeof(uint32_t);
+        sizes[keySection] = header.numNotes;
+        sizes[velocitySection] = header.numNotes;
+        sizes[channelSection] = header.numNotes;
+        sizes[trackIndexSection] = header.numNotes * sizeof(uint32_t);
+        sizes[trackOffsetSection] = (header.numNoteTracks + 1) * sizeof(uint64_t);
+        sizes[eventSection] = header.numEvents * sizeof(MergedMidiEvent);
+
+        const SeekIndex layout;
+        int array = 0;
+
+        SeekIndex::visitArrays(layout, [&](const auto& items)
+        {
+            sizes[seekIndexSection + array] = header.seekIndexCounts[array] * sizeof(*items.data());
+            ++array;
+        });
+    }
+
+    uint64_t alignUp(uint64_t value)
+    {
+        return (value + sectionAlignment - 1) & ~(sectionAlignment - 1);
+    }
+
+    inline uint64_t mixHash(uint64_t hash, uint64_t value)
+    {
+        hash = (hash ^ value) * 0x9E3779B97F4A7C15ull;
+        return hash ^ (hash >> 29);
+    }
+
+    uint64_t hashBytes(const uint8_t* data, size_t size, uint64_t hash)
+    {
+        size_t i = 0;
+
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t value;
+            std::memcpy(&value, data + i, 8);
+            hash = mixHash(hash, value);
+        }
+
+        for (; i < size; ++i)
+            hash = mixHash(hash, data[i]);
+
+        return hash;
+    }
+
+    // 分块写入：单次 write 太大时部分平台只会写入一部分；块与块之间检查取消
+    bool writeBytes(juce::OutputStream& stream, const void* data, uint64_t size, const std::atomic<bool>* cancelFlag)
+    {
+        const char* source = static_cast<const char*>(data);
+        const uint64_t maxChunk = 16 << 20;
+
+        while (size > 0)
+        {
+            if (cancelFlag != nullptr && cancelFlag->load(std::memory_order_relaxed))
+                return false;
+
+            const size_t chunk = (size_t) std::min(size, maxChunk);
+
+            if (!stream.write(source, chunk))
+                return false;
+
+            source += chunk;
+            size -= chunk;
+        }
+
+        return true;
+    }
+}
+
+//==============================================================================
+IndexCacheKey IndexCacheKey::create(const juce::File& file, const uint8_t* data, size_t size, uint64_t parseOptions)
+{
+    IndexCacheKey key;
+    key.fileSize = size;
+    key.parseOptions = parseOptions;
+    key.modificationTime = file.getLastModificationTime().toMilliseconds();
+
+    // 小文件整体哈希；大文件均匀抽取64块（包含开头和结尾），每块16KB，和文件大小无关地只读1MB
+    const size_t blockSize = 16384;
+    const size_t numBlocks = 64;
+    uint64_t hash = mixHash(0x243F6A8885A308D3ull, size);
+
+    if (size <= blockSize * numBlocks)
+    {
+        hash = hashBytes(data, size, hash);
+    }
+    else
+    {
+        for (size_t block = 0; block < numBlocks; ++block)
+        {
+            const size_t offset = (size - blockSize) / (numBlocks - 1) * block;
+            hash = hashBytes(data + offset, blockSize, hash);
+        }
+    }
+
+    key.contentHash = hash;
+    return key;
+}
+
+//==============================================================================
+IndexCache::~IndexCache()
+{
+    close();
+}
+
+juce::File IndexCache::getCacheFile(const juce::File& sourceFile, const juce::File& cacheDirectory)
+{
+    if (cacheDirectory.getFullPathName().isEmpty())
+        return sourceFile.getSiblingFile(sourceFile.getFileName() + ".cjidx");
+
+    // 不同目录下的同名文件各自有一个缓存
+    const juce::String path = sourceFile.getFullPathName();
+    const uint64_t pathHash = hashBytes(reinterpret_cast<const uint8_t*>(path.toRawUTF8()), strlen(path.toRawUTF8()), 0);
+
+    return cacheDirectory.getChildFile(sourceFile.getFileNameWithoutExtension() + "-"
+                                       + juce::String::toHexString((juce::int64) pathHash) + ".cjidx");
+}
+
+bool IndexCache::write(const juce::File& cacheFile, const IndexCacheKey& key, const SmfHeader& header,
+                       const MidiStatistics& statistics, const TempoMap& tempoMap,
+                       const NoteTable& noteTable, const MidiEventMerger& mergedEvents, const SeekIndex& seekIndex,
+                       const std::atomic<bool>* cancelFlag)
+{
+    jassert(mergedEvents.isFinished());
+
+    const auto& segments = tempoMap.getSegments();
+    const size_t numNoteTracks = noteTable.getNumTracks();
+
+    CacheHeader cacheHeader {};
+    std::memcpy(cacheHeader.magic, cacheMagic, sizeof(cacheMagic));
+    cacheHeader.version = formatVersion;
+    cacheHeader.byteOrder = byteOrderMark;
+    cacheHeader.headerSize = (uint32_t) sizeof(CacheHeader);
+    cacheHeader.statisticsSize = (uint32_t) sizeof(MidiStatistics);
+    cacheHeader.segmentSize = (uint32_t) sizeof(TempoMap::Segment);
+    cacheHeader.eventSize = (uint32_t) sizeof(MergedMidiEvent);
+    cacheHeader.key = key;
+    cacheHeader.format = header.format;
+    cacheHeader.numTracks = header.numTracks;
+    cacheHeader.timeFormat = header.timeFormat;
+    cacheHeader.headerLength = header.headerLength;
+    cacheHeader.smpte = tempoMap.isSmpte() ? 1 : 0;
+    cacheHeader.maxPolyphony = mergedEvents.getMaxPolyphony();
+    cacheHeader.numSegments = segments.size();
+    cacheHeader.numNotes = noteTable.size();
+    cacheHeader.numNoteTracks = numNoteTracks;
+    cacheHeader.numUnmatchedNotes = noteTable.getNumUnmatchedNotes();
+    cacheHeader.numEvents = mergedEvents.getTotalEvents();
+
+    // 音符表的轨道偏移在内存中是 size_t，缓存中统一用64位
+    std::vector<uint64_t> trackOffsets(numNoteTracks + 1, 0);
+    for (size_t i = 0; i < numNoteTracks; ++i)
+        trackOffsets[i + 1] = noteTable.getTrackNoteEnd(i);
+
+    const void* sectionData[numSections] = { &statistics, segments.data(),
+                                             noteTable.getStartTicks(), noteTable.getEndTicks(),
+                                             noteTable.getKeys(), noteTable.getVelocities(), noteTable.getChannels(),
+                                             noteTable.getTracks(), trackOffsets.data(), mergedEvents.getEvents() };
+
+    int array = 0;
+
+    SeekIndex::visitArrays(seekIndex, [&](const auto& items)
+    {
+        cacheHeader.seekIndexCounts[array] = items.size();
+        sectionData[seekIndexSection + array] = items.data();
+        ++array;
+    });
+
+    uint64_t sizes[numSections];
+    getSectionSizes(cacheHeader, sizes);
+
+    uint64_t offset = alignUp(sizeof(CacheHeader));
+    for (int section = 0; section < numSections; ++section)
+    {
+        cacheHeader.sectionOffsets[section] = offset;
+        offset = alignUp(offset + sizes[section]);
+    }
+    cacheHeader.cacheSize = offset;
+
+    if (!cacheFile.getParentDirectory().createDirectory())
+        return false;
+
+    juce::TemporaryFile temporaryFile(cacheFile);
+
+    {
+        juce::FileOutputStream stream(temporaryFile.getFile(), 1 << 20);
+
+        if (stream.failedToOpen())
+            return false;
+
+        if (!writeBytes(stream, &cacheHeader, sizeof(CacheHeader), cancelFlag))
+            return false;
+
+        uint64_t position = sizeof(CacheHeader);
+
+        for (int section = 0; section < numSections; ++section)
+        {
+            // 对齐填充
+            if (!stream.writeRepeatedByte(0, (size_t) (cacheHeader.sectionOffsets[section] - position)))
+                return false;
+
+            if (sizes[section] > 0 && !writeBytes(stream, sectionData[section], sizes[section], cancelFlag))
+                return false;
+
+            position = cacheHeader.sectionOffsets[section] + sizes[section];
+        }
+
+        if (!stream.writeRepeatedByte(0, (size_t) (cacheHeader.cacheSize - position)))
+            return false;
+
+        stream.flush();
+
+        if (stream.getStatus().failed())
+            return false;
+    }
+
+    return temporaryFile.overwriteTargetFileWithTemporary();
+}
+
+bool IndexCache::open(const juce::File& cacheFile, const IndexCacheKey& key, SmfHeader& header,
+                      MidiStatistics& statistics, TempoMap& tempoMap,
+                      NoteTable& noteTable, MidiEventMerger& mergedEvents, SeekIndex& seekIndex)
+{
+    close();
+
+    if (!cacheFile.existsAsFile())
+        return false;
+
+    auto file = std::make_unique<juce::MemoryMappedFile>(cacheFile, juce::MemoryMappedFile::readOnly);
+    const uint8_t* base = static_cast<const uint8_t*>(file->getData());
+    const uint64_t size = file->getSize();
+
+    if (base == nullptr || size < sizeof(CacheHeader))
+        return false;
+
+    CacheHeader cacheHeader;
+    std::memcpy(&cacheHeader, base, sizeof(CacheHeader));
+
+    // 格式和布局
+    if (std::memcmp(cacheHeader.magic, cacheMagic, sizeof(cacheMagic)) != 0
+        || cacheHeader.version != formatVersion
+        || cacheHeader.byteOrder != byteOrderMark
+        || cacheHeader.headerSize != sizeof(CacheHeader)
+        || cacheHeader.statisticsSize != sizeof(MidiStatistics)
+        || cacheHeader.segmentSize != sizeof(TempoMap::Segment)
+        || cacheHeader.eventSize != sizeof(MergedMidiEvent)
+        || cacheHeader.cacheSize != size)
+        return false;
+
+    // 源文件是否变化
+    if (!(cacheHeader.key == key))
+        return false;
+
+    // 计数不能超过文件长度（避免下面的乘法溢出），各段必须完整地落在文件内
+    if (cacheHeader.numSegments == 0 || cacheHeader.numSegments > size || cacheHeader.numNotes > size
+        || cacheHeader.numNoteTracks >= size || cacheHeader.numEvents > size)
+        return false;
+
+    for (auto count : cacheHeader.seekIndexCounts)
+        if (count > size)
+            return false;
+
+    uint64_t sizes[numSections];
+    getSectionSizes(cacheHeader, sizes);
+
+    for (int section = 0; section < numSections; ++section)
+    {
+        const uint64_t offset = cacheHeader.sectionOffsets[section];
+
+        if (offset % sectionAlignment != 0 || offset > size || sizes[section] > size - offset)
+            return false;
+    }
+
+    auto sectionPointer = [&](int section) { return base + cacheHeader.sectionOffsets[section]; };
+
+    // 轨道偏移必须单调且以音符总数结束
+    const uint64_t* trackOffsets = reinterpret_cast<const uint64_t*>(sectionPointer(trackOffsetSection));
+
+    if (trackOffsets[0] != 0 || trackOffsets[cacheHeader.numNoteTracks] != cacheHeader.numNotes)
+        return false;
+
+    for (uint64_t i = 0; i < cacheHeader.numNoteTracks; ++i)
+        if (trackOffsets[i + 1] < trackOffsets[i])
+            return false;
+
+    // 恢复
+    header.format = cacheHeader.format;
+    header.numTracks = cacheHeader.numTracks;
+    header.timeFormat = (short) cacheHeader.timeFormat;
+    header.headerLength = cacheHeader.headerLength;
+
+    std::memcpy(&statistics, sectionPointer(statisticsSection), sizeof(MidiStatistics));
+
+    tempoMap.setSegments(reinterpret_cast<const TempoMap::Segment*>(sectionPointer(segmentSection)),
+                         (size_t) cacheHeader.numSegments, cacheHeader.smpte != 0);
+
+    noteTable.attach((size_t) cacheHeader.numNotes,
+                     reinterpret_cast<const uint32_t*>(sectionPointer(startTickSection)),
+                     reinterpret_cast<const uint32_t*>(sectionPointer(endTickSection)),
+                     sectionPointer(keySection), sectionPointer(velocitySection), sectionPointer(channelSection),
+                     reinterpret_cast<const uint32_t*>(sectionPointer(trackIndexSection)),
+                     trackOffsets, (size_t) cacheHeader.numNoteTracks, (size_t) cacheHeader.numUnmatchedNotes);
+
+    mergedEvents.attach(reinterpret_cast<const MergedMidiEvent*>(sectionPointer(eventSection)),
+                        (size_t) cacheHeader.numEvents, cacheHeader.maxPolyphony);
+
+    int array = 0;
+
+    SeekIndex::visitArrays(seekIndex, [&](auto& items)
+    {
+        using Item = typename std::remove_const<typename std::remove_pointer<decltype(items.data())>::type>::type;
+        items.setView(reinterpret_cast<const Item*>(sectionPointer(seekIndexSection + array)), (size_t) cacheHeader.seekIndexCounts[array]);
+        ++array;
+    });
+
+    // 定位索引各数组之间的偏移关系损坏时，查询会越界读取，这种缓存不能使用
+    if (!seekIndex.isConsistent(noteTable, mergedEvents))
+    {
+        seekIndex.clear();
+        mergedEvents.clear();
+        noteTable.clear();
+        tempoMap.clear();
+        statistics = MidiStatistics();
+        header = SmfHeader();
+        return false;
+    }
+
+    mappedFile = std::move(file);
+    return true;
+}
+
+void IndexCache::close()
+{
+    mappedFile.reset();
+}
@@ -0,0 +1,72 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_INDEXCACHE_H
+#define CANDYJAR_INDEXCACHE_H
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SmfDecoder.h"
+#include "NoteTable.h"
+#include "TempoMap.h"
+#include "MidiEventMerger.h"
+#include "SeekIndex.h"
+
+struct MidiStatistics;
+
+// 缓存键：源文件的大小、修改时间和抽样哈希，三者都相同才认为缓存有效
+struct IndexCacheKey
+{
+    uint64_t fileSize = 0;
+    int64_t modificationTime = 0;   // 毫秒
+    uint64_t contentHash = 0;
+    uint64_t parseOptions = 0;      // 影响解析结果的选项（恢复模式、MidiLoadOptions 的过滤），不同选项的结果分别缓存
+
+    // data/size 为源文件的完整内容（通常是内存映射）
+    static IndexCacheKey create(const juce::File& file, const uint8_t* data, size_t size, uint64_t parseOptions);
+
+    bool operator== (const IndexCacheKey& other) const
+    {
+        return fileSize == other.fileSize && modificationTime == other.modificationTime && contentHash == other.contentHash
+            && parseOptions == other.parseOptions;
+    }
+};
+
+// 解析结果的二进制缓存（.cjidx）
+// 保存MThd头信息、MidiStatistics、速度表、音符表的各列、合并后的事件流和定位索引的各数组，每段按64字节对齐。
+// 打开时只映射文件并校验头部，音符表、事件流和定位索引直接引用映射，不复制也不解析，
+// 所以重新打开大文件只需要几毫秒（页面在第一次访问时才从磁盘读入）。
+// 缓存按本机字节序和结构体布局写入，版本号、字节序标记或结构体大小不同时视为无效
+class IndexCache
+{
+public:
+    IndexCache() = default;
+    ~IndexCache();
+
+    static constexpr uint32_t formatVersion = 4;
+
+    // 缓存文件的位置：cacheDirectory 有效时放在该目录下（文件名带源文件路径的哈希），否则放在源文件旁边
+    static juce::File getCacheFile(const juce::File& sourceFile, const juce::File& cacheDirectory);
+
+    // 写入缓存：先写临时文件，完成后再替换目标文件，失败或取消（cancelFlag 置位）时不影响已有的缓存
+    static bool write(const juce::File& cacheFile, const IndexCacheKey& key, const SmfHeader& header,
+                      const MidiStatistics& statistics, const TempoMap& tempoMap,
+                      const NoteTable& noteTable, const MidiEventMerger& mergedEvents, const SeekIndex& seekIndex,
+                      const std::atomic<bool>* cancelFlag = nullptr);
+
+    // 映射并校验缓存，键匹配时把数据恢复到各个结构中（音符表、事件流和定位索引引用映射，close() 之前必须先清空它们）
+    bool open(const juce::File& cacheFile, const IndexCacheKey& key, SmfHeader& header,
+              MidiStatistics& statistics, TempoMap& tempoMap,
+              NoteTable& noteTable, MidiEventMerger& mergedEvents, SeekIndex& seekIndex);
+
+    void close();
+
+    bool isOpen() const { return mappedFile != nullptr; }
+
+private:
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+
+    JUCE_DECLARE_NON_COPYABLE (IndexCache)
+};
+
+#endif //CANDYJAR_INDEXCACHE_H
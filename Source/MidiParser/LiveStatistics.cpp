@@ -0,0 +1,102 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "LiveStatistics.h"
+#include <algorithm>
+
+void LiveStatistics::reset(short newTimeFormat)
+{
+    std::lock_guard<std::mutex> guard(writeLock);
+
+    totals = LoadSnapshot();
+    timeFormat = newTimeFormat;
+    tempoChanges.clear();
+    numChangesInMap = 0;
+    tempoMap.build(tempoChanges, timeFormat);
+    publish();
+}
+
+void LiveStatistics::addEvents(int64_t numEvents, int64_t numNotes, uint64_t trackTick,
+                               const uint8_t* metaBase, const MetaEventRef* metaEvents, size_t numMetaEvents)
+{
+    std::lock_guard<std::mutex> guard(writeLock);
+
+    totals.events += numEvents;
+    totals.notes += numNotes;
+    totals.ticks = std::max(totals.ticks, trackTick);
+
+    if (timeFormat >= 0)
+        TempoMap::collectTempoChanges(metaBase, metaEvents, numMetaEvents, tempoChanges);
+
+    // 速度变化数量翻倍时才重建速度表，大量轨道各带速度事件时总的重建开销仍然是线性的
+    if (tempoChanges.size() > 2 * numChangesInMap)
+    {
+        tempoMap.build(tempoChanges, timeFormat);
+        numChangesInMap = tempoChanges.size();
+    }
+
+    totals.seconds = tempoMap.ticksToSeconds((double) totals.ticks);
+    publish();
+}
+
+void LiveStatistics::addTrack(int64_t extraEvents)
+{
+    std::lock_guard<std::mutex> guard(writeLock);
+
+    ++totals.tracksDone;
+    totals.events += extraEvents;
+    publish();
+}
+
+void LiveStatistics::publishFinal(const LoadSnapshot& snapshot)
+{
+    std::lock_guard<std::mutex> guard(writeLock);
+
+    totals = snapshot;
+    totals.complete = true;
+    publish();
+}
+
+void LiveStatistics::publish()
+{
+    // 序号先变成奇数，之后的字段写入不会排到它前面
+    const uint32_t start = sequence.load(std::memory_order_relaxed);
+    sequence.store(start + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    tracksDone.store(totals.tracksDone, std::memory_order_relaxed);
+    events.store(totals.events, std::memory_order_relaxed);
+    notes.store(totals.notes, std::memory_order_relaxed);
+    ticks.store(totals.ticks, std::memory_order_relaxed);
+    seconds.store(totals.seconds, std::memory_order_relaxed);
+    complete.store(totals.complete, std::memory_order_relaxed);
+
+    sequence.store(start + 2, std::memory_order_release);
+}
+
+LoadSnapshot LiveStatistics::read() const
+{
+    LoadSnapshot snapshot;
+
+    for (;;)
+    {
+        const uint32_t start = sequence.load(std::memory_order_acquire);
+
+        if ((start & 1) != 0)
+            continue;
+
+        snapshot.tracksDone = tracksDone.load(std::memory_order_relaxed);
+        snapshot.events = events.load(std::memory_order_relaxed);
+        snapshot.notes = notes.load(std::memory_order_relaxed);
+        snapshot.ticks = ticks.load(std::memory_order_relaxed);
+        snapshot.seconds = seconds.load(std::memory_order_relaxed);
+        snapshot.complete = complete.load(std::memory_order_relaxed);
+
+        // 字段的读取不会排到序号的第二次读取之后
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (sequence.load(std::memory_order_relaxed) == start)
+            return snapshot;
+    }
+}
@@ -0,0 +1,68 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_LIVESTATISTICS_H
+#define CANDYJAR_LIVESTATISTICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "TempoMap.h"
+
+// 加载过程中某一时刻的统计快照，各字段属于同一时刻
+struct LoadSnapshot
+{
+    int tracksDone = 0;
+    int64_t events = 0;
+    int64_t notes = 0;
+    uint64_t ticks = 0;        // 已解码部分中最长的轨道
+    double seconds = 0.0;      // ticks 按目前读到的 Set Tempo 换算，最终结果以完整的速度表为准
+    bool complete = false;     // 加载完成后的最终统计，之前都是部分结果
+};
+
+// 加载时的实时统计：解码线程按段累加，UI 线程随时读取一致的快照
+//  - 写入方（解码线程）之间用互斥锁串行，每个轨道每 LoadProgress::publishInterval 个事件才写一次
+//  - 快照按 seqlock 发布：写入时序号为奇数，读取方发现序号变化就重读，不加锁也不会等待加载线程
+class LiveStatistics
+{
+public:
+    // 开始新的加载，timeFormat 为 MThd 中的原始值
+    void reset(short timeFormat = 0);
+
+    // 解码线程：一个轨道新解码的一段事件（numMetaEvents 个新的 Meta 引用，trackTick 为轨道解码到的位置）
+    void addEvents(int64_t numEvents, int64_t numNotes, uint64_t trackTick,
+                   const uint8_t* metaBase, const MetaEventRef* metaEvents, size_t numMetaEvents);
+
+    // 解码线程：一个轨道完成，extraEvents 为解码之后补上的事件（恢复模式下补的 Note Off）
+    void addTrack(int64_t extraEvents);
+
+    // 加载完成后用最终统计覆盖快照
+    void publishFinal(const LoadSnapshot& snapshot);
+
+    // 任意线程：读取最近发布的快照
+    LoadSnapshot read() const;
+
+private:
+    void publish();
+
+    // 快照：只由 publish() 在 seqlock 内写入
+    std::atomic<uint32_t> sequence {0};
+    std::atomic<int> tracksDone {0};
+    std::atomic<int64_t> events {0};
+    std::atomic<int64_t> notes {0};
+    std::atomic<uint64_t> ticks {0};
+    std::atomic<double> seconds {0.0};
+    std::atomic<bool> complete {false};
+
+    // 写入方的累计状态，由 writeLock 保护
+    std::mutex writeLock;
+    LoadSnapshot totals;
+    short timeFormat = 0;
+    std::vector<TempoMap::TempoChange> tempoChanges;
+    size_t numChangesInMap = 0;
+    TempoMap tempoMap;       // 由目前读到的速度变化建立，只用于估算 seconds
+};
+
+#endif //CANDYJAR_LIVESTATISTICS_H
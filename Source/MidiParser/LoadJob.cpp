@@ -0,0 +1,132 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "LoadJob.h"
+
+void ParserSlot::put(std::unique_ptr<MidiParser> newParser)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        parser = std::move(newParser);
+    }
+
+    available.notify_one();
+}
+
+std::unique_ptr<MidiParser> ParserSlot::take()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    available.wait(guard, [this] { return parser != nullptr; });
+    return std::move(parser);
+}
+
+LoadJob::LoadJob(const juce::File& fileToLoad, const MidiLoadOptions& options, ParserSlot* parserSlot, Mode mode)
+    : file(fileToLoad),
+      loadOptions(options),
+      loadMode(mode),
+      slot(parserSlot),
+      startTime(juce::Time::getMillisecondCounterHiRes())
+{
+    // 线程最后启动，run() 看到的是构造完的对象
+    thread = std::thread([this] { run(); });
+}
+
+LoadJob::~LoadJob()
+{
+    retire();
+
+    if (thread.joinable())
+        thread.join();
+}
+
+const LoadProgress& LoadJob::getProgress() const
+{
+    const MidiParser* current = activeParser.load();
+    return current != nullptr ? current->getProgress() : waitingProgress;
+}
+
+void LoadJob::cancel()
+{
+    // 已经完成的加载不再取消：否则会中止后台的缓存写入，并在留下来的解析器上留下取消标志
+    // finished 在锁内设置，这里看到未完成时任务线程还没有交出结果
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (finished.load(std::memory_order_acquire))
+        return;
+
+    // 和 run() 中的顺序相反：要么这里看到解析器，要么任务线程拿到解析器后看到取消请求
+    cancelRequested = true;
+
+    if (MidiParser* current = activeParser.load())
+        current->cancelLoading();
+}
+
+void LoadJob::retire()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (retireRequested)
+        return;
+
+    // 任务线程在看到 retireRequested 之前不会放回或释放解析器，这里访问它是安全的
+    cancelRequested = true;
+
+    if (MidiParser* current = activeParser.load())
+        current->cancelLoading();
+
+    retireRequested = true;
+    retireCondition.notify_one();
+}
+
+void LoadJob::run()
+{
+    parser = slot != nullptr ? slot->take() : std::make_unique<MidiParser>();
+    activeParser.store(parser.get());
+
+    if (cancelRequested.load())
+    {
+        errorMessage = "Loading cancelled";
+    }
+    else if (loadMode == Mode::stream)
+    {
+        succeeded = parser->openStream(file);
+        errorMessage = parser->getLastErrorMessage();
+    }
+    else
+    {
+        succeeded = parser->loadMidiFile(file, loadOptions);
+        errorMessage = parser->getLastErrorMessage();
+
+        if (succeeded && !notePyramid.build(parser->getNoteTable(), parser->getThreadPool(), &cancelRequested))
+        {
+            succeeded = false;
+            errorMessage = "Loading cancelled";
+        }
+    }
+
+    elapsedMilliseconds = juce::Time::getMillisecondCounterHiRes() - startTime;
+
+    // 结果一直保留到调用者放弃这次加载，然后在这个线程上释放金字塔和解析器的数据（取消映射等）
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        finished.store(true, std::memory_order_release);
+        retireCondition.wait(guard, [this] { return retireRequested; });
+    }
+
+    notePyramid = NotePyramid();
+    activeParser.store(nullptr);
+
+    if (slot != nullptr)
+    {
+        // 内存池留给下一个任务；放回之前清掉取消请求，不影响下一次加载
+        parser->unload();
+        slot->put(std::move(parser));
+    }
+    else
+    {
+        parser.reset();
+    }
+
+    retired.store(true, std::memory_order_release);
+}
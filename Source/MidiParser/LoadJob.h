@@ -0,0 +1,105 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_LOADJOB_H
+#define CANDYJAR_LOADJOB_H
+
+#include "MidiParser.h"
+#include "../PianoRoll/NotePyramid.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// 先后的加载任务轮流使用的解析器：同一时间只有一个任务持有它，内存池和线程池因此在加载之间复用
+// 放弃的任务收尾后放回，下一个任务的线程在 take() 中等待（前一个任务的取消在50毫秒内生效），界面线程不等待
+class ParserSlot
+{
+public:
+    // 放入解析器（开始时放入一个，之后由收尾的任务放回）
+    void put(std::unique_ptr<MidiParser> parser);
+
+    // 取出解析器，其他任务正在使用时等到它放回为止
+    std::unique_ptr<MidiParser> take();
+
+private:
+    std::mutex lock;
+    std::condition_variable available;
+    std::unique_ptr<MidiParser> parser;
+};
+
+// 一次后台加载：占用一个 MidiParser 和一个线程，加载成功后顺带建好钢琴卷帘用的 NotePyramid
+//  - 流式模式只在任务线程上打开事件流（扫描块头），不解码轨道，也不建 NotePyramid
+//  - 界面线程只轮询 isFinished() 和进度，从不等待
+//  - retire() 取消加载并让任务线程自己释放解析器的数据，调用立即返回，
+//    新的加载可以马上开始，旧任务在后台收尾，isRetired() 之后销毁对象不会阻塞
+//  - parserSlot 不为空时从中借用解析器，收尾时清空数据后放回；为空时使用自己的解析器，收尾时销毁
+class LoadJob
+{
+public:
+    enum class Mode
+    {
+        load,       // 完整加载
+        stream      // 以流式模式打开，之后边播放边解码
+    };
+
+    explicit LoadJob(const juce::File& fileToLoad, const MidiLoadOptions& options = {}, ParserSlot* parserSlot = nullptr,
+                     Mode mode = Mode::load);
+
+    // 会等待任务线程结束，未 retire() 时先 retire()
+    ~LoadJob();
+
+    // 请求取消，50毫秒内生效，结果仍然通过 isFinished() 报告；已经完成时不做任何事；只能在 retire() 之前调用
+    void cancel();
+
+    // 放弃这次加载（无论是否已经完成），之后不能再访问解析器
+    void retire();
+
+    bool isFinished() const { return finished.load(std::memory_order_acquire); }
+    bool isRetired() const { return retired.load(std::memory_order_acquire); }
+
+    // 以下只能在 isFinished() 之后、retire() 之前调用
+    bool wasSuccessful() const { return succeeded; }
+    const juce::String& getErrorMessage() const { return errorMessage; }
+    double getElapsedMilliseconds() const { return elapsedMilliseconds; }
+    const MidiParser& getParser() const { return *parser; }
+    const NotePyramid& getNotePyramid() const { return notePyramid; }
+
+    // 流式模式的事件源，只能由一个线程（播放引擎）读取
+    MidiEventStream& getStream() { return parser->getStream(); }
+
+    // 加载过程中可以随时读取（还在等待解析器时是空闲状态），retire() 之后不能再调用
+    const LoadProgress& getProgress() const;
+
+    const juce::File& getFile() const { return file; }
+    bool isStreaming() const { return loadMode == Mode::stream; }
+
+private:
+    const juce::File file;
+    const MidiLoadOptions loadOptions;
+    const Mode loadMode;
+    ParserSlot* const slot;
+    std::unique_ptr<MidiParser> parser;          // 只由任务线程写入，isFinished() 之后界面线程才读取
+    std::atomic<MidiParser*> activeParser {nullptr};
+    LoadProgress waitingProgress;
+    NotePyramid notePyramid;
+    const double startTime;
+    double elapsedMilliseconds = 0.0;
+    bool succeeded = false;
+    juce::String errorMessage;
+    std::atomic<bool> cancelRequested {false};
+    std::atomic<bool> finished {false};
+    std::atomic<bool> retired {false};
+
+    std::mutex lock;
+    std::condition_variable retireCondition;
+    bool retireRequested = false;
+
+    std::thread thread;
+
+    void run();
+
+    JUCE_DECLARE_NON_COPYABLE (LoadJob)
+};
+
+#endif //CANDYJAR_LOADJOB_H
@@ -0,0 +1,84 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_LOADOPTIONS_H
+#define CANDYJAR_LOADOPTIONS_H
+
+#include "SmfDecoder.h"
+
+// 加载时只保留一部分数据：被过滤的事件在解码时直接跳过，不写入轨道，
+// 之后的音符表、合并事件流、统计信息和定位索引都只包含保留下来的事件
+//  - Set Tempo 总是保留（否则时间换算会出错），范围之外的轨道只读出其中的 Set Tempo
+//  - 被丢弃事件的 delta 累加到下一个保留的事件上，保留事件的 tick 不变
+//  - 力度过滤按 NoteTable 的配对规则（每个通道和音高后进先出）连同对应的 Note Off 一起丢弃
+struct MidiLoadOptions
+{
+    // 事件类型，位序与 MidiStatistics::eventTypeCounts 的下标相同（按状态字节高4位，力度为0的 Note On 属于 noteOn）
+    enum EventTypes : uint32_t
+    {
+        noteOff         = 1 << 0,
+        noteOn          = 1 << 1,
+        polyAftertouch  = 1 << 2,
+        controlChange   = 1 << 3,
+        programChange   = 1 << 4,
+        channelPressure = 1 << 5,
+        pitchBend       = 1 << 6,
+        metaSysex       = 1 << 7,
+
+        notes           = noteOff | noteOn,
+        allEventTypes   = 0xFF
+    };
+
+    uint32_t eventTypes = allEventTypes;
+    uint16_t channelMask = 0xFFFF;    // 第 n 位对应通道 n（0-15），只作用于通道消息
+    int firstTrack = 0;               // 保留的轨道范围 [firstTrack, lastTrack]，从0开始
+    int lastTrack = -1;               // < 0 表示到最后一个轨道
+    int minVelocity = 0;              // 力度低于这个值的音符被丢弃（1-127，0 表示不过滤）
+
+    // 是否过滤保留轨道中的事件（否则只按轨道范围过滤）
+    bool filtersEvents() const
+    {
+        return eventTypes != allEventTypes || channelMask != 0xFFFF || minVelocity > 0;
+    }
+
+    bool keepsEverything() const
+    {
+        return !filtersEvents() && firstTrack <= 0 && lastTrack < 0;
+    }
+
+    bool includesTrack(int trackIndex) const
+    {
+        return trackIndex >= firstTrack && (lastTrack < 0 || trackIndex <= lastTrack);
+    }
+
+    // 保留的轨道使用的解码过滤
+    SmfEventFilter getEventFilter() const
+    {
+        SmfEventFilter filter;
+
+        for (int status = 0x80; status < 0xF0; ++status)
+            filter.keepStatus[(size_t) status] = (eventTypes & (1u << ((status >> 4) - 8))) != 0
+                                              && (channelMask & (1u << (status & 0x0F))) != 0;
+
+        const bool keepMetaSysex = (eventTypes & metaSysex) != 0;
+        filter.keepStatus[0xF0] = keepMetaSysex;
+        filter.keepStatus[0xF7] = keepMetaSysex;
+        filter.keepStatus[0xFF] = keepMetaSysex;
+        filter.minVelocity = (uint8_t) juce::jlimit(0, 127, minVelocity);
+        return filter;
+    }
+
+    // 解析结果缓存的键（IndexCacheKey::parseOptions）中与过滤有关的部分，全部保留时为0：
+    // 位 1-8 事件类型取反，9-24 通道取反，25-31 力度，32-47 起始轨道，48-63 结束轨道 + 1（SMF 最多 65535 个轨道）
+    uint64_t getCacheBits() const
+    {
+        return (uint64_t) (~eventTypes & allEventTypes) << 1
+             | (uint64_t) (uint16_t) ~channelMask << 9
+             | (uint64_t) juce::jlimit(0, 127, minVelocity) << 25
+             | (uint64_t) juce::jlimit(0, 0xFFFF, firstTrack) << 32
+             | (uint64_t) (lastTrack < 0 ? 0 : juce::jlimit(1, 0xFFFF, lastTrack + 1)) << 48;
+    }
+};
+
+#endif //CANDYJAR_LOADOPTIONS_H
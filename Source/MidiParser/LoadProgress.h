@@ -0,0 +1,110 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_LOADPROGRESS_H
+#define CANDYJAR_LOADPROGRESS_H
+
+#include <atomic>
+#include <cstdint>
+#include "LiveStatistics.h"
+
+// 加载阶段
+enum class LoadPhase : int
+{
+    idle,
+    opening,
+    scanning,
+    decoding,
+    pairingNotes,
+    buildingTempoMap,
+    statistics,
+    merging,
+    buildingSeekIndex,
+    finished,
+    failed,
+    cancelled
+};
+
+// 加载进度：加载线程只更新原子计数器和 live 快照，不等待消息线程
+// UI 定时轮询读取。各字段分别读取，彼此之间不保证是同一时刻的快照；需要一致的计数时读取 live
+struct LoadProgress
+{
+    std::atomic<int> phase { (int) LoadPhase::idle };
+    std::atomic<int64_t> totalBytes {0};        // 所有MTrk块的总长度（扫描块头后才知道）
+    std::atomic<int64_t> bytesConsumed {0};     // 已解码的MTrk字节数
+    std::atomic<int> totalTracks {0};
+    std::atomic<int> tracksDone {0};
+    std::atomic<int64_t> eventsDecoded {0};
+    std::atomic<int64_t> totalMergeEvents {0};
+    std::atomic<int64_t> eventsMerged {0};
+
+    // 解码时累加的事件数、音符数和时长，作为一个整体发布
+    LiveStatistics live;
+
+    // 解码时每处理这么多事件发布一次计数，避免每个事件都写共享缓存行
+    static constexpr uint32_t publishInterval = 1 << 16;   // 必须是2的幂
+
+    void reset()
+    {
+        phase = (int) LoadPhase::idle;
+        totalBytes = 0;
+        bytesConsumed = 0;
+        totalTracks = 0;
+        tracksDone = 0;
+        eventsDecoded = 0;
+        totalMergeEvents = 0;
+        eventsMerged = 0;
+        live.reset();
+    }
+
+    LoadPhase getPhase() const { return (LoadPhase) phase.load(std::memory_order_relaxed); }
+    void setPhase(LoadPhase newPhase) { phase.store((int) newPhase, std::memory_order_relaxed); }
+
+    // 估算整体进度（0 ~ 1）：解码占大头，按字节数推进；合并按事件数推进
+    double getFraction() const
+    {
+        auto ratio = [](int64_t done, int64_t total) { return total > 0 ? (double) done / (double) total : 0.0; };
+
+        switch (getPhase())
+        {
+            case LoadPhase::idle:
+            case LoadPhase::opening:
+            case LoadPhase::scanning:         return 0.0;
+            case LoadPhase::decoding:         return 0.05 + 0.65 * ratio(bytesConsumed.load(), totalBytes.load());
+            case LoadPhase::pairingNotes:     return 0.70;
+            case LoadPhase::buildingTempoMap: return 0.75;
+            case LoadPhase::statistics:       return 0.80;
+            case LoadPhase::merging:          return 0.85 + 0.10 * ratio(eventsMerged.load(), totalMergeEvents.load());
+            case LoadPhase::buildingSeekIndex: return 0.95;
+            case LoadPhase::finished:         return 1.0;
+            case LoadPhase::failed:
+            case LoadPhase::cancelled:        return 0.0;
+        }
+
+        return 0.0;
+    }
+
+    static const char* getPhaseName(LoadPhase phase)
+    {
+        switch (phase)
+        {
+            case LoadPhase::idle:             return "Idle";
+            case LoadPhase::opening:          return "Opening file";
+            case LoadPhase::scanning:         return "Scanning chunks";
+            case LoadPhase::decoding:         return "Decoding tracks";
+            case LoadPhase::pairingNotes:     return "Pairing notes";
+            case LoadPhase::buildingTempoMap: return "Building tempo map";
+            case LoadPhase::statistics:       return "Calculating statistics";
+            case LoadPhase::merging:          return "Merging tracks";
+            case LoadPhase::buildingSeekIndex: return "Building seek index";
+            case LoadPhase::finished:         return "Finished";
+            case LoadPhase::failed:           return "Failed";
+            case LoadPhase::cancelled:        return "Cancelled";
+        }
+
+        return "";
+    }
+};
+
+#endif //CANDYJAR_LOADPROGRESS_H
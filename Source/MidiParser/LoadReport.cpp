@@ -0,0 +1,152 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "LoadReport.h"
+
+namespace
+{
+    juce::String formatMilliseconds(int64_t nanoseconds)
+    {
+        return juce::String((double) nanoseconds * 1.0e-6, 2) + " ms";
+    }
+
+    juce::String formatMegabytes(int64_t bytes)
+    {
+        return juce::String((double) bytes / (1024.0 * 1024.0), 1) + " MB";
+    }
+
+    // Chrome 跟踪的时间单位是微秒
+    juce::String toMicroseconds(int64_t nanoseconds)
+    {
+        return juce::String((double) nanoseconds * 1.0e-3, 3);
+    }
+}
+
+void LoadReport::reset()
+{
+    *this = LoadReport();
+}
+
+void LoadReport::enterPhase(LoadPhase phase)
+{
+    const int64_t now = WorkStealingPool::getTimestampNanoseconds();
+
+    if (currentPhase == LoadPhase::idle)
+        startNanoseconds = now;
+    else
+        closePhase(now);
+
+    currentPhase = phase;
+    phaseStart = now;
+}
+
+void LoadReport::closePhase(int64_t now)
+{
+    phaseNanoseconds[(int) currentPhase] += now - phaseStart;
+    spans.push_back({ LoadProgress::getPhaseName(currentPhase), "phase", 0, -1, phaseStart, now - phaseStart });
+}
+
+void LoadReport::finish(LoadPhase finalPhase)
+{
+    const int64_t now = WorkStealingPool::getTimestampNanoseconds();
+
+    if (currentPhase != LoadPhase::idle)
+        closePhase(now);
+    else
+        startNanoseconds = now;
+
+    currentPhase = LoadPhase::idle;
+    totalNanoseconds = now - startNanoseconds;
+    result = finalPhase;
+}
+
+void LoadReport::addTaskSpans(const std::vector<WorkStealingPool::TaskSpan>& taskSpans)
+{
+    for (const auto& task : taskSpans)
+        spans.push_back({ task.name, "task", task.workerIndex, task.index, task.startNanoseconds, task.durationNanoseconds });
+}
+
+juce::String LoadReport::toString() const
+{
+    juce::String text;
+    text << "Total: " << formatMilliseconds(totalNanoseconds) << " (" << LoadProgress::getPhaseName(result)
+         << (fromCache ? ", from cache" : "") << ")\n";
+
+    for (int phase = 0; phase < numPhases; ++phase)
+        if (phaseNanoseconds[phase] > 0)
+            text << "  " << LoadProgress::getPhaseName((LoadPhase) phase) << ": " << formatMilliseconds(phaseNanoseconds[phase]) << "\n";
+
+    for (const auto& span : spans)
+        if (juce::String(span.category) == "step")
+            text << "  - " << span.name << ": " << formatMilliseconds(span.durationNanoseconds) << "\n";
+
+    text << "File: " << formatMegabytes(fileBytes) << ", tracks " << formatMegabytes(trackBytes)
+         << ", events decoded " << (juce::int64) eventsDecoded << ", merged " << (juce::int64) eventsMerged << "\n";
+    text << "Track events: " << formatMegabytes(trackEventBytes) << (compressedTracks ? " (compressed)" : "") << "\n";
+    text << "Arena: " << (juce::int64) arenaAllocations << " allocations, " << formatMegabytes(arenaBytesAllocated)
+         << "; " << (juce::int64) arenaMappings << " new mappings, " << formatMegabytes(arenaBytesMapped) << " mapped\n";
+
+    for (size_t worker = 0; worker < workers.size(); ++worker)
+    {
+        const auto& activity = workers[worker];
+        const double busy = totalNanoseconds > 0 ? 100.0 * (double) activity.busyNanoseconds / (double) totalNanoseconds : 0.0;
+        text << "Worker " << (int) worker << ": " << formatMilliseconds(activity.busyNanoseconds) << " busy ("
+             << juce::String(busy, 1) << "%), " << (juce::int64) activity.tasks << " tasks\n";
+    }
+
+    if (!anomalies.empty())
+    {
+        text << "Repaired " << (int) anomalies.size() << " anomalies:\n";
+
+        for (const auto& anomaly : anomalies)
+            text << "  " << anomaly.toString() << "\n";
+    }
+
+    return text;
+}
+
+void LoadReport::writeChromeTrace(juce::OutputStream& stream) const
+{
+    // 时间相对加载开始；每个线程一行，0号是加载线程
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    const int numThreads = juce::jmax(1, (int) workers.size());
+
+    for (int thread = 0; thread < numThreads; ++thread)
+    {
+        stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+               << ",\"args\":{\"name\":\"" << (thread == 0 ? juce::String("Loader") : "Worker " + juce::String(thread)) << "\"}},\n";
+    }
+
+    for (const auto& span : spans)
+    {
+        stream << "{\"name\":\"" << span.name << "\",\"cat\":\"" << span.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.thread
+               << ",\"ts\":" << toMicroseconds(span.startNanoseconds - startNanoseconds)
+               << ",\"dur\":" << toMicroseconds(span.durationNanoseconds);
+
+        if (span.index >= 0)
+            stream << ",\"args\":{\"index\":" << span.index << "}";
+
+        stream << "},\n";
+    }
+
+    // 最后一项放计数，省去处理末尾逗号
+    stream << "{\"name\":\"arena\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":" << toMicroseconds(totalNanoseconds)
+           << ",\"args\":{\"allocations\":" << (juce::int64) arenaAllocations << ",\"bytes\":" << (juce::int64) arenaBytesAllocated << "}}\n";
+    stream << "]}\n";
+}
+
+bool LoadReport::writeChromeTrace(const juce::File& file) const
+{
+    juce::FileOutputStream stream(file);
+
+    if (!stream.openedOk())
+        return false;
+
+    stream.setPosition(0);
+    stream.truncate();
+    writeChromeTrace(stream);
+    stream.flush();
+    return stream.getStatus().wasOk();
+}
@@ -0,0 +1,107 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_LOADREPORT_H
+#define CANDYJAR_LOADREPORT_H
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "LoadProgress.h"
+#include "SmfDecoder.h"
+#include "../Utils/WorkStealingPool.h"
+
+// 一次加载的耗时报告：各阶段和主要步骤的用时、内存池分配、线程池中每个线程的忙碌时间
+//  - 阶段和步骤只在加载线程上记录，每次加载只有几十条，开销可以忽略
+//  - 打开跟踪（MidiParser::setTracingEnabled）时还会记录线程池中的每个任务，可以导出为
+//    Chrome 跟踪格式（chrome://tracing 或 Perfetto 打开）
+// 时间都是 steady_clock 的纳秒数（见 WorkStealingPool::getTimestampNanoseconds）
+struct LoadReport
+{
+    // 一段用时：阶段、加载线程上的步骤或线程池中的任务
+    struct Span
+    {
+        const char* name;          // 静态字符串
+        const char* category;      // "phase"、"step" 或 "task"
+        int thread;                // 0 为加载线程（也是线程池的0号线程），其余为线程池的工作线程
+        int index;                 // 任务的下标（例如轨道号），其他为 -1
+        int64_t startNanoseconds;
+        int64_t durationNanoseconds;
+    };
+
+    static constexpr int numPhases = (int) LoadPhase::cancelled + 1;
+
+    int64_t startNanoseconds = 0;
+    int64_t totalNanoseconds = 0;
+    int64_t phaseNanoseconds[numPhases] = {};
+    LoadPhase result = LoadPhase::idle;
+    bool fromCache = false;
+    bool compressedTracks = false;
+
+    // 计数
+    int64_t fileBytes = 0;
+    int64_t trackBytes = 0;                // 所有 MTrk 块的总长度
+    int64_t eventsDecoded = 0;
+    int64_t eventsMerged = 0;
+    int64_t trackEventBytes = 0;           // 轨道事件占用的内存（压缩存储时为压缩后的大小）
+    int64_t arenaAllocations = 0;          // 内存池的分配次数和分配出去的字节数
+    int64_t arenaBytesAllocated = 0;
+    int64_t arenaMappings = 0;             // 其中新向系统映射内存的次数和映射总量
+    int64_t arenaBytesMapped = 0;
+
+    std::vector<WorkStealingPool::WorkerActivity> workers;
+    std::vector<Span> spans;
+
+    // 恢复模式下修复的文件问题，按在文件中的顺序（从缓存加载时为空，数量见 MidiStatistics::repairedAnomalies）
+    std::vector<SmfAnomaly> anomalies;
+
+    void reset();
+
+    // 开始新的阶段（结束上一个阶段），加载线程调用
+    void enterPhase(LoadPhase phase);
+
+    // 结束当前阶段和整个加载
+    void finish(LoadPhase finalPhase);
+
+    // 加上线程池记录的任务
+    void addTaskSpans(const std::vector<WorkStealingPool::TaskSpan>& taskSpans);
+
+    double getPhaseSeconds(LoadPhase phase) const { return (double) phaseNanoseconds[(int) phase] * 1.0e-9; }
+    double getTotalSeconds() const { return (double) totalNanoseconds * 1.0e-9; }
+
+    // 多行文本报告
+    juce::String toString() const;
+
+    // 写出 Chrome 跟踪事件格式的JSON
+    void writeChromeTrace(juce::OutputStream& stream) const;
+    bool writeChromeTrace(const juce::File& file) const;
+
+private:
+    LoadPhase currentPhase = LoadPhase::idle;
+    int64_t phaseStart = 0;
+
+    void closePhase(int64_t now);
+};
+
+// 记录一段代码的用时，析构时作为一个步骤追加到报告
+class ScopedLoadTimer
+{
+public:
+    ScopedLoadTimer(LoadReport& reportToUse, const char* stepName)
+        : report(reportToUse), name(stepName), start(WorkStealingPool::getTimestampNanoseconds())
+    {
+    }
+
+    ~ScopedLoadTimer()
+    {
+        report.spans.push_back({ name, "step", 0, -1, start, WorkStealingPool::getTimestampNanoseconds() - start });
+    }
+
+private:
+    LoadReport& report;
+    const char* name;
+    const int64_t start;
+
+    JUCE_DECLARE_NON_COPYABLE (ScopedLoadTimer)
+};
+
+#endif //CANDYJAR_LOADREPORT_H
@@ -0,0 +1,148 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "MidiEventMerger.h"
+#include <algorithm>
+
+void MidiEventMerger::clear()
+{
+    cursors.clear();
+    tree.clear();
+    events = nullptr;
+    eventData = nullptr;
+    totalEvents = 0;
+    openNotes.fill(0);
+    activeNotes = 0;
+    maxPolyphony = 0;
+    numMerged.store(0, std::memory_order_release);
+}
+
+void MidiEventMerger::attach(const MergedMidiEvent* mergedEvents, size_t numEvents, int polyphony)
+{
+    clear();
+
+    eventData = mergedEvents;
+    totalEvents = numEvents;
+    maxPolyphony = polyphony;
+    numMerged.store(numEvents, std::memory_order_release);
+}
+
+void MidiEventMerger::prepare(const std::vector<MidiTrackEvents>& tracks, Arena& arena)
+{
+    clear();
+
+    for (const auto& track : tracks)
+        totalEvents += track.getNumChannelEvents();
+
+    // 唯一的一次输出分配（arena 不做初始化，不会提前触碰所有页面）
+    events = arena.allocateArray<MergedMidiEvent>(totalEvents);
+    eventData = events;
+
+    const uint32_t numCursors = (uint32_t) tracks.size();
+    cursors.reserve(numCursors);
+
+    for (uint32_t i = 0; i < numCursors; ++i)
+    {
+        cursors.emplace_back(tracks[i]);
+        advance(cursors.back());
+    }
+
+    // 所有内部节点先填哨兵，再依次插入每个叶子
+    tree.assign(numCursors == 0 ? 1 : numCursors, numCursors);
+
+    for (uint32_t i = numCursors; i-- > 0;)
+        adjust(i);
+}
+
+void MidiEventMerger::advance(Cursor& cursor)
+{
+    // 跳到下一个通道消息，沿途累加Meta/SysEx的delta，当前段读完时读下一段
+    for (;;)
+    {
+        const TrackEventSpan& span = cursor.span;
+
+        while (cursor.index < span.numEvents)
+        {
+            cursor.tick += span.deltaTicks[cursor.index];
+
+            if (isChannelStatus(span.status[cursor.index]))
+                return;
+
+            ++cursor.index;
+        }
+
+        if (!cursor.reader.next(cursor.span))
+            break;
+
+        cursor.index = 0;
+    }
+
+    cursor.tick = exhaustedTick;
+}
+
+void MidiEventMerger::adjust(uint32_t leaf)
+{
+    const uint32_t numCursors = (uint32_t) cursors.size();
+    uint32_t winner = leaf;
+
+    // 从叶子向根比较，败者留在节点上，胜者继续向上
+    for (uint32_t node = (leaf + numCursors) / 2; node > 0; node /= 2)
+    {
+        if (comesAfter(winner, tree[node]))
+            std::swap(winner, tree[node]);
+    }
+
+    tree[0] = winner;
+}
+
+size_t MidiEventMerger::mergeNext(size_t maxEvents)
+{
+    size_t count = numMerged.load(std::memory_order_relaxed);
+    const size_t limit = count + std::min(maxEvents, totalEvents - count);
+    const size_t start = count;
+
+    while (count < limit)
+    {
+        const uint32_t winner = tree[0];
+        Cursor& cursor = cursors[winner];
+
+        if (cursor.tick == exhaustedTick)
+            break;
+
+        const TrackEventSpan& span = cursor.span;
+        MergedMidiEvent& out = events[count++];
+        out.tick = cursor.tick > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t) cursor.tick;
+        out.track = winner;
+        out.status = span.status[cursor.index];
+        out.data1 = span.data1[cursor.index];
+        out.data2 = span.data2[cursor.index];
+        out.reserved = 0;
+
+        // 全局时间顺序下正在发声的音符数：和 NoteTable 一样，没有打开音符的 Note Off 被忽略，
+        // 不然黑乐谱中常见的多余 Note Off 会把计数压低
+        if (isNoteOnEvent(out.status, out.data2))
+        {
+            ++openNotes[(size_t) (out.status & 0x0F) * 128 + out.data1];
+            maxPolyphony = std::max(maxPolyphony, ++activeNotes);
+        }
+        else if (isNoteOffEvent(out.status, out.data2))
+        {
+            uint32_t& open = openNotes[(size_t) (out.status & 0x0F) * 128 + out.data1];
+
+            if (open > 0)
+            {
+                --open;
+                --activeNotes;
+            }
+        }
+
+        ++cursor.index;
+        advance(cursor);
+        adjust(winner);
+    }
+
+    // 发布新合并的事件
+    numMerged.store(count, std::memory_order_release);
+    return count - start;
+}
@@ -0,0 +1,99 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_MIDIEVENTMERGER_H
+#define CANDYJAR_MIDIEVENTMERGER_H
+
+#include "MidiTrackEvents.h"
+#include <array>
+#include <atomic>
+#include <memory>
+
+// 合并后全局时间有序的事件（12字节）
+// tick超过32位时截断为最大值，仍保持有序
+struct MergedMidiEvent
+{
+    uint32_t tick;
+    uint32_t track;
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+    uint8_t reserved;
+};
+
+// 用败者树把各轨道的通道消息k路归并成一条按tick排序的事件流
+//  - 总复杂度 O(N log T)，输出数组在 prepare() 中从 arena 一次性分配
+//  - mergeNext() 可以分批调用，已合并的前缀可以被其他线程同时读取（见 getNumMerged）
+//  - 相同tick的事件按轨道号、再按轨道内顺序排列，结果是确定的
+//  - Meta/SysEx 事件不进入合并流（速度变化由速度表处理）
+class MidiEventMerger
+{
+public:
+    MidiEventMerger() = default;
+
+    // 为一组轨道准备合并，tracks 在合并期间必须保持不变，输出数组在 arena 重置前有效
+    void prepare(const std::vector<MidiTrackEvents>& tracks, Arena& arena);
+
+    // 最多再合并 maxEvents 个事件，返回本次实际合并的数量
+    size_t mergeNext(size_t maxEvents);
+
+    // 一次合并剩余的全部事件
+    void mergeAll() { mergeNext(getTotalEvents()); }
+
+    // 直接引用外部内存中已经合并好的事件（例如映射的缓存文件），不复制；外部内存在 clear() 之前必须保持有效
+    void attach(const MergedMidiEvent* mergedEvents, size_t numEvents, int polyphony);
+
+    void clear();
+
+    bool isFinished() const { return getNumMerged() == totalEvents; }
+    size_t getTotalEvents() const { return totalEvents; }
+
+    // 已经可以读取的事件数，读取 getEvents()[0, getNumMerged()) 是线程安全的
+    size_t getNumMerged() const { return numMerged.load(std::memory_order_acquire); }
+    const MergedMidiEvent* getEvents() const { return eventData; }
+
+    // 已合并部分中同时发声的音符数峰值（合并时顺带统计）
+    // 按 (通道, 音高) 记录打开的音符，Note Off 只结束同一通道、同一音高上已经打开的音符（不区分轨道）
+    int getMaxPolyphony() const { return maxPolyphony; }
+
+private:
+    struct Cursor
+    {
+        explicit Cursor(const MidiTrackEvents& track) : reader(track, cursorSpanEvents) {}
+
+        TrackEventReader reader;
+        TrackEventSpan span;    // 当前读到的一段事件
+        size_t index = 0;       // 下一个待读取的事件在 span 中的下标
+        uint64_t tick = 0;      // 当前事件的绝对tick，耗尽时为 exhaustedTick
+    };
+
+    static constexpr uint64_t exhaustedTick = ~(uint64_t) 0;
+
+    // 压缩存储的轨道每个游标一次解压这么多事件：轨道可能有上万个，缓冲区不能按整块分配
+    static constexpr size_t cursorSpanEvents = 64;
+
+    std::vector<Cursor> cursors;
+    std::vector<uint32_t> tree;   // tree[0] 为胜者，其余节点保存败者
+    MergedMidiEvent* events = nullptr;            // prepare() 时在 arena 中分配
+    const MergedMidiEvent* eventData = nullptr;   // 指向 events 或外部内存
+    size_t totalEvents = 0;
+    std::atomic<size_t> numMerged {0};
+    std::array<uint32_t, 16 * 128> openNotes {};   // 每个 (通道, 音高) 正在发声的音符数
+    int activeNotes = 0;
+    int maxPolyphony = 0;
+
+    void advance(Cursor& cursor);
+    void adjust(uint32_t leaf);
+
+    // 轨道 a 是否排在轨道 b 之后（b == cursors.size() 表示初始化用的哨兵，永远最小）
+    bool comesAfter(uint32_t a, uint32_t b) const
+    {
+        const uint32_t sentinel = (uint32_t) cursors.size();
+        if (b == sentinel) return a != sentinel;
+        if (a == sentinel) return false;
+        return cursors[a].tick != cursors[b].tick ? cursors[a].tick > cursors[b].tick : a > b;
+    }
+};
+
+#endif //CANDYJAR_MIDIEVENTMERGER_H
@@ -0,0 +1,500 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "MidiEventStream.h"
+#include <algorithm>
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+ #include <sys/mman.h>
+#endif
+
+namespace
+{
+    // 每个轨道读过这么多字节后把之前的页面还给系统；按 64KB 对齐，对常见的页大小都成立
+    constexpr size_t releaseBytes = 1 << 20;
+    constexpr uintptr_t releaseAlignment = 1 << 16;
+
+    inline const uint8_t* alignDown(const uint8_t* pointer)
+    {
+        return reinterpret_cast<const uint8_t*>(reinterpret_cast<uintptr_t>(pointer) & ~(releaseAlignment - 1));
+    }
+
+    inline const uint8_t* alignUp(const uint8_t* pointer)
+    {
+        return alignDown(pointer + (releaseAlignment - 1));
+    }
+}
+
+void MidiEventStream::open(const uint8_t* fileBase, const std::vector<TrackChunkInfo>& chunks, short newTimeFormat, bool isMapped)
+{
+    close();
+
+    base = fileBase;
+    trackChunks = chunks;
+    releasePages = isMapped;
+    timeFormat = newTimeFormat;
+
+    // 轨道越多每个窗口越小，总内存保持在预算之内
+    windowEvents = juce::jlimit(minWindowEvents, maxWindowEvents,
+                                windowBudgetBytes / (sizeof(WindowEvent) * std::max((size_t) 1, chunks.size())));
+
+    cursors.resize(chunks.size());
+    windows.resize(chunks.size() * windowEvents);
+    heap.reserve(chunks.size());
+
+    maxCheckpoints = std::max(minCheckpoints, checkpointBudgetBytes / (sizeof(TrackState) * std::max((size_t) 1, chunks.size())));
+    checkpointInterval = minCheckpointInterval;
+    nextCheckpoint = checkpointInterval;
+
+    rewind();
+}
+
+void MidiEventStream::close()
+{
+    base = nullptr;
+    trackChunks.clear();
+    cursors.clear();
+    windows.clear();
+    heap.clear();
+    windowEvents = 0;
+    hasCurrent = false;
+    numEventsRead = 0;
+    errorMessage = {};
+    checkpoints.clear();
+    checkpointTracks.clear();
+}
+
+size_t MidiEventStream::getMemoryUsage() const
+{
+    return trackChunks.capacity() * sizeof(TrackChunkInfo)
+         + cursors.capacity() * sizeof(Cursor)
+         + windows.capacity() * sizeof(WindowEvent)
+         + heap.capacity() * sizeof(uint32_t)
+         + checkpoints.capacity() * sizeof(Checkpoint)
+         + checkpointTracks.capacity() * sizeof(TrackState);
+}
+
+void MidiEventStream::rewind()
+{
+    // 检查点和错误信息都与读取位置无关，保留下来
+    heap.clear();
+    hasCurrent = false;
+    numEventsRead = 0;
+
+    if (base == nullptr)
+        return;
+
+    // 初始速度和 TempoMap::build 相同
+    tempoSegment = TempoMap::Segment();
+
+    if (timeFormat < 0)
+    {
+        const int framesPerSecond = -(int) (int8_t) (timeFormat >> 8);
+        const int ticksPerFrame = std::max(1, timeFormat & 0xFF);
+        const double frameRate = framesPerSecond == 29 ? 30000.0 / 1001.0 : (double) std::max(1, framesPerSecond);
+        tempoSegment.secondsPerTick = 1.0 / (frameRate * ticksPerFrame);
+    }
+    else
+    {
+        ticksPerQuarterNote = (double) std::max((short) 1, timeFormat);
+        tempoSegment.microsecondsPerQuarterNote = TempoMap::defaultMicrosecondsPerQuarterNote;
+        tempoSegment.secondsPerTick = TempoMap::defaultMicrosecondsPerQuarterNote / (1000000.0 * ticksPerQuarterNote);
+    }
+
+    for (size_t i = 0; i < cursors.size(); ++i)
+    {
+        Cursor& cursor = cursors[i];
+        cursor = Cursor();
+        cursor.pos = base + trackChunks[i].offset;
+        cursor.end = cursor.pos + trackChunks[i].length;
+        cursor.released = alignUp(cursor.pos);
+
+        if (fillWindow((uint32_t) i))
+        {
+            heap.push_back((uint32_t) i);
+            siftUp(heap.size() - 1);
+        }
+    }
+
+    readNextChannelEvent();
+}
+
+void MidiEventStream::seek(double seconds)
+{
+    // 只有目标在当前事件之后时才能接着读，否则之前读过的事件里可能有需要的
+    const bool canContinue = hasCurrent && current.seconds < seconds;
+
+    // 检查点按时间有序，找到最后一个早于目标的
+    const auto after = std::lower_bound(checkpoints.begin(), checkpoints.end(), seconds,
+                                        [](const Checkpoint& checkpoint, double target) { return checkpoint.current.seconds < target; });
+
+    if (after != checkpoints.begin())
+    {
+        const size_t index = (size_t) (after - checkpoints.begin()) - 1;
+
+        if (!canContinue || numEventsRead < checkpoints[index].numEventsRead)
+            restoreCheckpoint(index);
+    }
+    else if (!canContinue)
+    {
+        rewind();
+    }
+
+    while (hasCurrent && current.seconds < seconds)
+        next();
+}
+
+void MidiEventStream::next()
+{
+    if (!hasCurrent)
+        return;
+
+    ++numEventsRead;
+    readNextChannelEvent();
+
+    if (numEventsRead == nextCheckpoint && hasCurrent)
+        saveCheckpoint();
+}
+
+void MidiEventStream::saveCheckpoint()
+{
+    const size_t numTracks = cursors.size();
+
+    if (checkpoints.size() == maxCheckpoints)
+    {
+        // 隔一个丢一个，留下的正好是加倍后的间隔上的检查点
+        size_t kept = 0;
+
+        for (size_t i = 1; i < checkpoints.size(); i += 2, ++kept)
+        {
+            checkpoints[kept] = checkpoints[i];
+            std::copy_n(checkpointTracks.begin() + (std::ptrdiff_t) (i * numTracks), numTracks,
+                        checkpointTracks.begin() + (std::ptrdiff_t) (kept * numTracks));
+        }
+
+        checkpoints.resize(kept);
+        checkpointTracks.resize(kept * numTracks);
+        checkpointInterval *= 2;
+        nextCheckpoint = (checkpoints.size() + 1) * checkpointInterval;
+
+        if (numEventsRead != nextCheckpoint)
+            return;
+    }
+
+    Checkpoint checkpoint;
+    checkpoint.numEventsRead = numEventsRead;
+    checkpoint.tempoSegment = tempoSegment;
+    checkpoint.current = current;
+    checkpoints.push_back(checkpoint);
+
+    for (const Cursor& cursor : cursors)
+        checkpointTracks.push_back({ cursor.windowPos, cursor.windowTick, cursor.windowBegin, cursor.windowRunningStatus, cursor.windowEnded });
+
+    nextCheckpoint = (checkpoints.size() + 1) * checkpointInterval;
+}
+
+void MidiEventStream::restoreCheckpoint(size_t index)
+{
+    const Checkpoint& checkpoint = checkpoints[index];
+    const TrackState* states = checkpointTracks.data() + index * cursors.size();
+
+    heap.clear();
+
+    for (size_t i = 0; i < cursors.size(); ++i)
+    {
+        Cursor& cursor = cursors[i];
+        cursor.pos = states[i].pos;
+        cursor.tick = states[i].tick;
+        cursor.runningStatus = states[i].runningStatus;
+        cursor.ended = states[i].ended;
+
+        // 重新读入的页面之后再还给系统
+        cursor.released = std::min(cursor.released, alignUp(cursor.pos));
+
+        // 窗口的解码是确定的，重新解码后跳过已经输出的事件
+        fillWindow((uint32_t) i);
+        cursor.windowBegin = states[i].windowBegin;
+
+        if (cursor.windowBegin < cursor.windowSize)
+        {
+            heap.push_back((uint32_t) i);
+            siftUp(heap.size() - 1);
+        }
+    }
+
+    tempoSegment = checkpoint.tempoSegment;
+    current = checkpoint.current;
+    hasCurrent = true;
+    numEventsRead = checkpoint.numEventsRead;
+}
+
+void MidiEventStream::readNextChannelEvent()
+{
+    WindowEvent event;
+    uint32_t trackIndex = 0;
+
+    while (popEvent(event, trackIndex))
+    {
+        if (event.status == 0xFF)
+        {
+            applyTempo(event.tick, event.tempo);
+            continue;
+        }
+
+        // 之前的 Set Tempo 都已经生效，之后的都不早于这个tick，直接用当前的速度段换算
+        current.tick = event.tick;
+        current.seconds = tempoSegment.startSeconds + ((double) event.tick - (double) tempoSegment.startTick) * tempoSegment.secondsPerTick;
+        current.track = trackIndex;
+        current.status = event.status;
+        current.data1 = event.data1;
+        current.data2 = event.data2;
+        hasCurrent = true;
+        return;
+    }
+
+    hasCurrent = false;
+}
+
+bool MidiEventStream::popEvent(WindowEvent& event, uint32_t& trackIndex)
+{
+    if (heap.empty())
+        return false;
+
+    trackIndex = heap.front();
+    Cursor& cursor = cursors[trackIndex];
+    event = windows[trackIndex * windowEvents + cursor.windowBegin];
+
+    // 轨道还有事件时留在堆顶向下调整，否则用堆尾替换
+    if (++cursor.windowBegin < cursor.windowSize || fillWindow(trackIndex))
+    {
+        siftDown(0);
+    }
+    else
+    {
+        heap.front() = heap.back();
+        heap.pop_back();
+
+        if (!heap.empty())
+            siftDown(0);
+    }
+
+    return true;
+}
+
+void MidiEventStream::applyTempo(uint64_t tick, uint32_t microsecondsPerQuarterNote)
+{
+    // 和 TempoMap::build 的逐段计算相同：同一tick上的多个速度以最后一个为准，相同的速度不开新段
+    if (timeFormat < 0)
+        return;
+
+    const double secondsPerTick = microsecondsPerQuarterNote / (1000000.0 * ticksPerQuarterNote);
+
+    if (tick == tempoSegment.startTick)
+    {
+        tempoSegment.microsecondsPerQuarterNote = microsecondsPerQuarterNote;
+        tempoSegment.secondsPerTick = secondsPerTick;
+        return;
+    }
+
+    if (microsecondsPerQuarterNote == tempoSegment.microsecondsPerQuarterNote)
+        return;
+
+    tempoSegment.startSeconds = tempoSegment.startSeconds + (double) (tick - tempoSegment.startTick) * tempoSegment.secondsPerTick;
+    tempoSegment.startTick = tick;
+    tempoSegment.microsecondsPerQuarterNote = microsecondsPerQuarterNote;
+    tempoSegment.secondsPerTick = secondsPerTick;
+}
+
+bool MidiEventStream::fillWindow(uint32_t trackIndex)
+{
+    Cursor& cursor = cursors[trackIndex];
+    WindowEvent* window = windows.data() + trackIndex * windowEvents;
+    uint32_t count = 0;
+
+    cursor.windowBegin = 0;
+    cursor.windowSize = 0;
+    cursor.windowPos = cursor.pos;
+    cursor.windowTick = cursor.tick;
+    cursor.windowRunningStatus = cursor.runningStatus;
+    cursor.windowEnded = cursor.ended;
+
+    const uint8_t* pos = cursor.pos;
+    const uint8_t* const end = cursor.end;
+
+    // 解码规则与 SmfDecoder::decodeTrack 相同，但只保留通道消息和 Set Tempo
+    auto fail = [&](const char* message)
+    {
+        if (errorMessage.isEmpty())
+            errorMessage = "Track " + juce::String(trackIndex + 1) + ": " + message;
+
+        cursor.ended = true;
+    };
+
+    while (!cursor.ended && count < windowEvents)
+    {
+        if (pos >= end)
+        {
+            cursor.ended = true;
+            break;
+        }
+
+        uint32_t delta = 0;
+        if (!SmfDecoder::readVariableLength(pos, end, delta))
+        {
+            fail("Truncated delta time");
+            break;
+        }
+
+        cursor.tick += delta;
+
+        if (pos >= end)
+        {
+            fail("Truncated event");
+            break;
+        }
+
+        uint8_t statusByte = *pos;
+
+        if (statusByte >= 0x80)
+            ++pos;
+        else if (cursor.runningStatus != 0)
+            statusByte = cursor.runningStatus;
+        else
+        {
+            fail("Data byte without running status");
+            break;
+        }
+
+        if (statusByte < 0xF0)
+        {
+            cursor.runningStatus = statusByte;
+            const int numDataBytes = ((statusByte & 0xE0) == 0xC0) ? 1 : 2;
+
+            if (end - pos < numDataBytes)
+            {
+                fail("Truncated channel message");
+                break;
+            }
+
+            WindowEvent& event = window[count++];
+            event.tick = cursor.tick;
+            event.tempo = 0;
+            event.status = statusByte;
+            event.data1 = pos[0] & 0x7F;
+            event.data2 = numDataBytes == 2 ? (pos[1] & 0x7F) : 0;
+            pos += numDataBytes;
+            continue;
+        }
+
+        uint8_t metaType = 0;
+        if (statusByte == 0xFF)
+        {
+            if (pos >= end)
+            {
+                fail("Truncated meta event");
+                break;
+            }
+
+            metaType = *pos++;
+        }
+        else if (statusByte != 0xF0 && statusByte != 0xF7)
+        {
+            fail("Unexpected status byte");
+            break;
+        }
+
+        uint32_t length = 0;
+        if (!SmfDecoder::readVariableLength(pos, end, length) || (size_t) (end - pos) < length)
+        {
+            fail("Truncated meta/sysex event");
+            break;
+        }
+
+        if (statusByte == 0xFF && metaType == 0x51 && length >= 3)
+        {
+            const uint32_t tempo = (uint32_t(pos[0]) << 16) | (uint32_t(pos[1]) << 8) | pos[2];
+
+            if (tempo > 0)
+            {
+                WindowEvent& event = window[count++];
+                event.tick = cursor.tick;
+                event.tempo = tempo;
+                event.status = 0xFF;
+                event.data1 = metaType;
+                event.data2 = 0;
+            }
+        }
+
+        pos += length;
+
+        if (statusByte == 0xFF && metaType == 0x2F)
+            cursor.ended = true;
+    }
+
+    cursor.pos = pos;
+    cursor.windowSize = count;
+
+    if (releasePages)
+        releaseConsumedPages(cursor);
+
+    return count > 0;
+}
+
+void MidiEventStream::releaseConsumedPages(Cursor& cursor)
+{
+    // 映射是只读的，丢弃的页面再次访问时会从文件重新读入，所以即使和其他轨道共用页面也是安全的
+    const uint8_t* const limit = alignDown(cursor.ended ? cursor.end : cursor.pos);
+
+    if (limit <= cursor.released || (size_t) (limit - cursor.released) < (cursor.ended ? 1 : releaseBytes))
+        return;
+
+   #if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+    madvise(const_cast<uint8_t*>(cursor.released), (size_t) (limit - cursor.released), MADV_DONTNEED);
+   #endif
+
+    cursor.released = limit;
+}
+
+void MidiEventStream::siftDown(size_t index)
+{
+    const size_t count = heap.size();
+    const uint32_t item = heap[index];
+
+    for (;;)
+    {
+        size_t child = index * 2 + 1;
+
+        if (child >= count)
+            break;
+
+        if (child + 1 < count && comesBefore(heap[child + 1], heap[child]))
+            ++child;
+
+        if (!comesBefore(heap[child], item))
+            break;
+
+        heap[index] = heap[child];
+        index = child;
+    }
+
+    heap[index] = item;
+}
+
+void MidiEventStream::siftUp(size_t index)
+{
+    const uint32_t item = heap[index];
+
+    while (index > 0)
+    {
+        const size_t parent = (index - 1) / 2;
+
+        if (!comesBefore(item, heap[parent]))
+            break;
+
+        heap[index] = heap[parent];
+        index = parent;
+    }
+
+    heap[index] = item;
+}
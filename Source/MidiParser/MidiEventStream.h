@@ -0,0 +1,182 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_MIDIEVENTSTREAM_H
+#define CANDYJAR_MIDIEVENTSTREAM_H
+
+#include "SmfDecoder.h"
+#include "TempoMap.h"
+
+// 流式读取得到的通道消息，已经按速度换算成秒
+struct StreamedMidiEvent
+{
+    double seconds = 0.0;
+    uint64_t tick = 0;
+    uint32_t track = 0;
+    uint8_t status = 0;
+    uint8_t data1 = 0;
+    uint8_t data2 = 0;
+};
+
+// 流式事件源：不解码整个文件，边播放边从映射的 MTrk 块中读取
+//  - 每个轨道一个游标，只解码游标之后一小段事件（解码窗口），窗口用完再接着解码下一段
+//  - 各轨道窗口的首个事件放在最小堆中，按 (tick, 轨道号, 轨道内顺序) 输出，与 MidiEventMerger 的顺序相同
+//  - Set Tempo 在输出顺序上被读到时才生效，速度段随读取位置增量推进，与 TempoMap 的换算结果逐位一致
+//  - 内存只与轨道数有关（所有窗口合计不超过 windowBudgetBytes，检查点合计不超过 checkpointBudgetBytes），
+//    与文件大小和事件数无关；文件是内存映射时，已经读过的部分会还给系统
+//  - 向前读取时每隔一段事件记下各轨道的读取位置（检查点），向回跳转时从最近的检查点重新解码，不必从头读起
+// 不是线程安全的，同一时间只能由一个线程读取
+class MidiEventStream
+{
+public:
+    MidiEventStream() = default;
+
+    // 所有轨道解码窗口合计的内存上限，每个轨道的窗口在 minWindowEvents 和 maxWindowEvents 之间
+    static constexpr size_t windowBudgetBytes = 4 << 20;
+    static constexpr size_t minWindowEvents = 4;
+    static constexpr size_t maxWindowEvents = 256;
+
+    // 所有检查点合计的内存上限（至少保留 minCheckpoints 个），检查点之间至少相隔 minCheckpointInterval 个通道消息
+    // 检查点用完时隔一个丢一个，间隔加倍
+    static constexpr size_t checkpointBudgetBytes = 4 << 20;
+    static constexpr size_t minCheckpoints = 4;
+    static constexpr uint64_t minCheckpointInterval = 1 << 16;
+
+    // 在文件内容上打开事件流，fileBase 在 close() 之前必须保持有效
+    // isMapped 为 true 时 fileBase 是只读的文件映射，已经读过的页面可以丢弃（之后需要时由系统重新读入）
+    void open(const uint8_t* fileBase, const std::vector<TrackChunkInfo>& chunks, short timeFormat, bool isMapped);
+    void close();
+
+    bool isOpen() const { return base != nullptr; }
+
+    // 回到文件开头
+    void rewind();
+
+    // 跳到指定位置（秒）：读取并丢弃之前的通道消息，速度变化照常生效
+    // 从目标之前最近的检查点（或者当前位置，如果更近）接着读，已经读过的范围内最多重读 getCheckpointInterval() 个事件；
+    // 超出读过的范围时耗时与需要跳过的事件数成正比
+    void seek(double seconds);
+
+    // 下一个通道消息，事件流结束时返回 nullptr；指针在下一次 next() 之前有效
+    const StreamedMidiEvent* peek() const { return hasCurrent ? &current : nullptr; }
+
+    // 丢弃 peek() 返回的事件，读取下一个
+    void next();
+
+    bool isExhausted() const { return !hasCurrent; }
+
+    // 已经输出的通道消息数
+    uint64_t getNumEventsRead() const { return numEventsRead; }
+
+    // 当前的速度段（起点为最近一次生效的 Set Tempo）
+    const TempoMap::Segment& getTempoSegment() const { return tempoSegment; }
+
+    size_t getNumTracks() const { return cursors.size(); }
+    size_t getWindowEvents() const { return windowEvents; }
+    size_t getNumCheckpoints() const { return checkpoints.size(); }
+    uint64_t getCheckpointInterval() const { return checkpointInterval; }
+
+    // 游标、窗口、堆和检查点占用的内存（字节）
+    size_t getMemoryUsage() const;
+
+    // 第一个读取失败的轨道的错误信息（截断的事件等），出错的轨道在出错处结束，其他轨道照常播放
+    const juce::String& getErrorMessage() const { return errorMessage; }
+
+private:
+    // 窗口中的事件：通道消息，或者 status = 0xFF 的 Set Tempo（tempo 为每四分音符微秒数）
+    struct WindowEvent
+    {
+        uint64_t tick;
+        uint32_t tempo;
+        uint8_t status;
+        uint8_t data1;
+        uint8_t data2;
+    };
+
+    struct Cursor
+    {
+        const uint8_t* pos = nullptr;
+        const uint8_t* end = nullptr;
+        const uint8_t* released = nullptr;   // 之前的页面已经还给系统
+        uint64_t tick = 0;
+        uint32_t windowBegin = 0;            // 窗口中下一个待输出的事件
+        uint32_t windowSize = 0;
+        uint8_t runningStatus = 0;
+        bool ended = false;                  // 块已经读完（或遇到 End of Track、解码错误）
+
+        // 当前窗口解码之前的状态，从这里重新解码会得到同一个窗口
+        const uint8_t* windowPos = nullptr;
+        uint64_t windowTick = 0;
+        uint8_t windowRunningStatus = 0;
+        bool windowEnded = false;
+    };
+
+    // 检查点中一个轨道的状态：重新解码的窗口起点，和窗口中下一个待输出的事件
+    struct TrackState
+    {
+        const uint8_t* pos;
+        uint64_t tick;
+        uint32_t windowBegin;
+        uint8_t runningStatus;
+        bool ended;
+    };
+
+    // 读完第 numEventsRead 个通道消息后的状态（current 是下一个要输出的事件）
+    struct Checkpoint
+    {
+        uint64_t numEventsRead;
+        TempoMap::Segment tempoSegment;
+        StreamedMidiEvent current;
+    };
+
+    const uint8_t* base = nullptr;
+    std::vector<TrackChunkInfo> trackChunks;
+    bool releasePages = false;
+    short timeFormat = 0;
+
+    std::vector<Cursor> cursors;
+    std::vector<WindowEvent> windows;    // 每个轨道 windowEvents 项
+    size_t windowEvents = 0;
+    std::vector<uint32_t> heap;          // 窗口不空的轨道，按首个事件排列的最小堆
+
+    TempoMap::Segment tempoSegment;
+    double ticksPerQuarterNote = 1.0;
+
+    StreamedMidiEvent current;
+    bool hasCurrent = false;
+    uint64_t numEventsRead = 0;
+    juce::String errorMessage;
+
+    std::vector<Checkpoint> checkpoints;       // 按位置排列，第 i 个在第 (i + 1) * checkpointInterval 个事件处
+    std::vector<TrackState> checkpointTracks;  // 每个检查点 cursors.size() 项
+    size_t maxCheckpoints = 0;
+    uint64_t checkpointInterval = minCheckpointInterval;
+    uint64_t nextCheckpoint = minCheckpointInterval;
+
+    // 解码轨道的下一段事件到窗口中，返回窗口是否不空
+    bool fillWindow(uint32_t trackIndex);
+    void releaseConsumedPages(Cursor& cursor);
+    void applyTempo(uint64_t tick, uint32_t microsecondsPerQuarterNote);
+
+    // 取出下一个窗口事件（通道消息或 Set Tempo），堆为空时返回 false
+    bool popEvent(WindowEvent& event, uint32_t& trackIndex);
+    void readNextChannelEvent();
+
+    void saveCheckpoint();
+    void restoreCheckpoint(size_t index);
+
+    bool comesBefore(uint32_t a, uint32_t b) const
+    {
+        const uint64_t tickA = windows[a * windowEvents + cursors[a].windowBegin].tick;
+        const uint64_t tickB = windows[b * windowEvents + cursors[b].windowBegin].tick;
+        return tickA != tickB ? tickA < tickB : a < b;
+    }
+
+    void siftDown(size_t index);
+    void siftUp(size_t index);
+
+    JUCE_DECLARE_NON_COPYABLE (MidiEventStream)
+};
+
+#endif //CANDYJAR_MIDIEVENTSTREAM_H
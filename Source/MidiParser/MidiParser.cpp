@@ -3,213 +3,795 @@
 //
 
 #include "MidiParser.h"
-#include <chrono>
 #include <thread>
+#include <algorithm>
+#include <cstring>
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+ #include <sys/mman.h>
+#endif
 
 MidiParser::MidiParser()
+    : cacheDirectory(juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                         .getChildFile("CandyJar").getChildFile("IndexCache"))
 {
 }
 
 MidiParser::~MidiParser()
 {
+    waitForCacheWrite();
 }
 
 void MidiParser::resetParser()
 {
-    midiFile.clear();
+    // 后台写入的缓存还在读取上一次的结果
+    waitForCacheWrite();
+    cancelCacheWrite = false;
+    
+    // 合并器引用着轨道数据，先清空
+    seekIndex.clear();
+    mergedEvents.clear();
+    noteTable.clear();
+    tempoMap.clear();
+    header = SmfHeader();
+    tracks.clear();
+    eventStream.close();
+    unmapFile();
+    indexCache.close();
+    
+    // 上面各结构中的数组都只是指向 arena 的指针，这里一次性回收，不逐个释放
+    arena.reset();
     statistics = MidiStatistics();
     lastErrorMessage = "";
-    shouldCancel = false;
+    progress.reset();
+    loadReport.reset();
+    
+    if (threadPool != nullptr && sharedPool == nullptr)
+    {
+        threadPool->resetWorkerActivity();
+        threadPool->takeTaskSpans();
+    }
 }
 
-std::future<bool> MidiParser::loadMidiFileAsync(const juce::File& file, ProgressCallback progressCallback)
+std::future<bool> MidiParser::loadMidiFileAsync(const juce::File& file, const MidiLoadOptions& options)
 {
-    // 重置解析器状态
+    // 重置解析器状态，新的异步加载不受之前的取消请求影响
     resetParser();
+    shouldCancel = false;
     
     // 返回一个future对象，可以在其他线程中执行加载操作
-    return std::async(std::launch::async, [this, file, progressCallback]() {
-        return loadMidiFile(file, progressCallback);
+    return std::async(std::launch::async, [this, file, options]() {
+        return loadMidiFile(file, options);
     });
 }
 
-bool MidiParser::loadMidiFile(const juce::File& file, ProgressCallback progressCallback)
+bool MidiParser::loadMidiFile(const juce::File& file, const MidiLoadOptions& options)
 {
     // 重置解析器状态
     resetParser();
+    loadOptions = options;
+    enterPhase(LoadPhase::opening);
     
     // 检查是否需要取消
     if (shouldCancel.load())
-    {
-        if (progressCallback)
-            progressCallback(0, "Loading cancelled");
-        return false;
-    }
+        return finishLoading(LoadPhase::cancelled);
     
     // 检查文件是否存在
     if (!file.existsAsFile())
     {
         lastErrorMessage = "File does not exist: " + file.getFullPathName();
-        if (progressCallback)
-            progressCallback(0, "Error: File does not exist");
-        return false;
+        return finishLoading(LoadPhase::failed);
     }
 
-    // 检查文件大小
-    auto fileSize = file.getSize();
-    lastErrorMessage = "File size: " + juce::String(fileSize) + " bytes";
+    // 把整个文件映射到内存，之后所有轨道都在映射上原地解析
+    // （映射是按需读入的，真正的磁盘读取大多发生在解码阶段的缺页中）
+    bool mapped;
+    {
+        ScopedLoadTimer timer(loadReport, "Map file");
+        mapped = mapFile(file);
+    }
+    
+    if (!mapped)
+    {
+        lastErrorMessage = "Cannot open file: " + file.getFullPathName();
+        return finishLoading(LoadPhase::failed);
+    }
+    
+    loadReport.fileBytes = (int64_t) fileLength;
     
-    if (progressCallback)
+    // 检查是否需要取消
+    if (shouldCancel.load())
+        return finishLoading(LoadPhase::cancelled);
+    
+    // 源文件没有变化时直接使用上次的解析结果
+    IndexCacheKey cacheKey;
+    
+    if (cacheEnabled)
     {
-        progressCallback(0, "Opening file: " + file.getFileName() + " (" + juce::String(fileSize) + " bytes)");
+        {
+            ScopedLoadTimer timer(loadReport, "Cache key");
+            cacheKey = IndexCacheKey::create(file, fileBase, fileLength, (recoveryEnabled ? 1 : 0) | loadOptions.getCacheBits());
+        }
+        
+        ScopedLoadTimer timer(loadReport, "Open cache");
+        
+        if (openCache(file, cacheKey))
+            return finishLoading(LoadPhase::finished);
     }
+        
+    // 第一遍：只读块头，得到每个轨道的位置；第二遍：多线程并行解码各轨道
+    enterPhase(LoadPhase::scanning);
+    std::vector<TrackChunkInfo> chunks;
+    bool result = scanTrackChunks(chunks)
+               && decodeTracks(chunks);
     
     // 检查是否需要取消
     if (shouldCancel.load())
+        return finishLoading(LoadPhase::cancelled);
+    
+    if (!result)
     {
-        if (progressCallback)
-            progressCallback(0, "Loading cancelled");
-        return false;
+        lastErrorMessage = "Failed to parse MIDI file: " + file.getFullPathName() + ". " + lastErrorMessage;
+        return finishLoading(LoadPhase::failed);
     }
 
-    // 创建文件输入流
-    juce::FileInputStream fileStream(file);
-    if (!fileStream.openedOk())
+    // 配对 Note On / Note Off，生成音符表
+    enterPhase(LoadPhase::pairingNotes);
+    
+    if (!noteTable.build(tracks, arena, getThreadPool(), &shouldCancel))
+        return finishLoading(LoadPhase::cancelled);
+    
+    // 根据所有轨道的 Set Tempo 事件建立速度表
+    enterPhase(LoadPhase::buildingTempoMap);
+    tempoMap.build(tracks, header.timeFormat);
+    
+    // 计算统计信息
+    enterPhase(LoadPhase::statistics);
+    calculateStatistics();
+    
+    if (shouldCancel.load())
+        return finishLoading(LoadPhase::cancelled);
+    
+    // 把所有轨道归并成一条全局有序的事件流
+    enterPhase(LoadPhase::merging);
+    
+    if (!mergeTracks())
+        return finishLoading(LoadPhase::cancelled);
+    
+    // 建立按时间定位的索引
+    enterPhase(LoadPhase::buildingSeekIndex);
+    
+    if (!seekIndex.build(noteTable, mergedEvents, arena, getThreadPool(), &shouldCancel))
+        return finishLoading(LoadPhase::cancelled);
+    
+    if (cacheEnabled)
+        writeCache(file, cacheKey);
+        
+    lastErrorMessage = "MIDI file loaded successfully. File type: " + juce::String(header.format) + 
+                      ", Tracks: " + juce::String(statistics.totalTracks) + 
+                      ", Events: " + juce::String(statistics.totalEvents) + 
+                      ", Notes: " + juce::String(statistics.totalNotes);
+    return finishLoading(LoadPhase::finished);
+}
+
+bool MidiParser::openStream(const juce::File& file)
+{
+    resetParser();
+    enterPhase(LoadPhase::opening);
+    
+    if (!file.existsAsFile())
     {
-        lastErrorMessage = "Cannot open file: " + file.getFullPathName();
-        if (progressCallback)
-            progressCallback(5, "Error: Cannot open file");
-        return false;
+        lastErrorMessage = "File does not exist: " + file.getFullPathName();
+        return finishLoading(LoadPhase::failed);
     }
     
-    if (progressCallback)
+    bool mapped;
     {
-        progressCallback(10, "File opened successfully");
+        ScopedLoadTimer timer(loadReport, "Map file");
+        mapped = mapFile(file);
     }
     
-    // 检查是否需要取消
+    if (!mapped)
+    {
+        lastErrorMessage = "Cannot open file: " + file.getFullPathName();
+        return finishLoading(LoadPhase::failed);
+    }
+    
+    loadReport.fileBytes = (int64_t) fileLength;
+    
+    // 只扫描块头，轨道内容在播放时才读取
+    enterPhase(LoadPhase::scanning);
+    std::vector<TrackChunkInfo> chunks;
+    
+    const bool scanned = scanTrackChunks(chunks);
+    
     if (shouldCancel.load())
+        return finishLoading(LoadPhase::cancelled);
+    
+    if (!scanned)
     {
-        if (progressCallback)
-            progressCallback(10, "Loading cancelled");
-        return false;
+        lastErrorMessage = "Failed to parse MIDI file: " + file.getFullPathName() + ". " + lastErrorMessage;
+        return finishLoading(LoadPhase::failed);
     }
+    
+    {
+        ScopedLoadTimer timer(loadReport, "Open stream");
+        eventStream.open(fileBase, chunks, header.timeFormat, mappedFile != nullptr);
+    }
+    
+    statistics.totalTracks = (int) chunks.size();
+    statistics.fileType = header.format;
+    statistics.timeFormat = header.timeFormat;
+    
+    lastErrorMessage = "MIDI file opened for streaming. File type: " + juce::String(header.format) + 
+                      ", Tracks: " + juce::String(statistics.totalTracks);
+    return finishLoading(LoadPhase::finished);
+}
 
-    // 尝试读取MIDI文件
-    if (progressCallback)
+void MidiParser::setUseHugePages(bool shouldUseHugePages)
+{
+    Arena::Options options = arena.getOptions();
+    options.useHugePages = shouldUseHugePages;
+    arena.setOptions(options);
+}
+
+void MidiParser::enterPhase(LoadPhase phase)
+{
+    progress.setPhase(phase);
+    loadReport.enterPhase(phase);
+    
+    // 之后线程池中的任务在跟踪中以阶段命名
+    if (threadPool != nullptr && sharedPool == nullptr)
+        threadPool->setTracing(tracingEnabled, LoadProgress::getPhaseName(phase));
+}
+
+bool MidiParser::finishLoading(LoadPhase phase)
+{
+    if (phase == LoadPhase::cancelled)
+        lastErrorMessage = "Loading cancelled";
+    
+    // 汇总耗时报告
+    loadReport.finish(phase);
+    loadReport.fromCache = indexCache.isOpen();
+    loadReport.trackBytes = progress.totalBytes.load();
+    loadReport.eventsDecoded = progress.eventsDecoded.load();
+    loadReport.eventsMerged = (int64_t) mergedEvents.getNumMerged();
+    loadReport.compressedTracks = compressedTracks;
+    
+    for (const auto& track : tracks)
+        loadReport.trackEventBytes += (int64_t) track.getEventBytes();
+    
+    loadReport.arenaAllocations = (int64_t) arena.getNumAllocations();
+    loadReport.arenaBytesAllocated = (int64_t) arena.getBytesAllocated();
+    loadReport.arenaMappings = (int64_t) arena.getNumMappings();
+    loadReport.arenaBytesMapped = (int64_t) arena.getBytesMapped();
+    
+    if (threadPool != nullptr && sharedPool == nullptr)
     {
-        progressCallback(20, "Parsing MIDI file header");
+        loadReport.workers = threadPool->getWorkerActivity();
+        loadReport.addTaskSpans(threadPool->takeTaskSpans());
     }
     
-    // 添加一个小延迟，让用户能看到进度更新
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        
-    int fileType = 0;
-    bool result = midiFile.readFrom(fileStream, true, &fileType);
+    // 最终统计（包括从缓存读取的）覆盖加载中的部分结果
+    if (phase == LoadPhase::finished)
+    {
+        LoadSnapshot snapshot;
+        snapshot.tracksDone = statistics.totalTracks;
+        snapshot.events = statistics.totalEvents;
+        snapshot.notes = statistics.totalNotes;
+        snapshot.ticks = (uint64_t) statistics.totalTicks;
+        snapshot.seconds = statistics.totalDuration;
+        progress.live.publishFinal(snapshot);
+    }
     
-    // 检查是否需要取消
-    if (shouldCancel.load())
+    // 取消请求只作用于一次加载
+    shouldCancel = false;
+    progress.setPhase(phase);
+    return phase == LoadPhase::finished;
+}
+
+bool MidiParser::openCache(const juce::File& file, const IndexCacheKey& key)
+{
+    if (!indexCache.open(IndexCache::getCacheFile(file, cacheDirectory), key, header, statistics, tempoMap, noteTable, mergedEvents, seekIndex))
+        return false;
+    
+    // 缓存中已经有全部结果，不再需要源文件
+    unmapFile();
+    
+    lastErrorMessage = "MIDI file loaded from cache. File type: " + juce::String(header.format) + 
+                      ", Tracks: " + juce::String(statistics.totalTracks) + 
+                      ", Events: " + juce::String(statistics.totalEvents) + 
+                      ", Notes: " + juce::String(statistics.totalNotes);
+    return true;
+}
+
+void MidiParser::writeCache(const juce::File& file, const IndexCacheKey& key)
+{
+    // 缓存只是加速手段，在后台写入，写入失败（例如目录只读）不影响本次加载
+    // 写入线程读取的结果在下一次 resetParser() 之前不会改变
+    const juce::File cacheFile = IndexCache::getCacheFile(file, cacheDirectory);
+    
+    cacheWriter = std::thread([this, cacheFile, key]
     {
-        if (progressCallback)
-            progressCallback(50, "Loading cancelled");
+        IndexCache::write(cacheFile, key, header, statistics, tempoMap, noteTable, mergedEvents, seekIndex, &cancelCacheWrite);
+    });
+}
+
+void MidiParser::waitForCacheWrite()
+{
+    if (cacheWriter.joinable())
+        cacheWriter.join();
+}
+
+bool MidiParser::mapFile(const juce::File& file)
+{
+    unmapFile();
+    
+    mappedFile = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+    
+    if (mappedFile->getData() != nullptr)
+    {
+        fileBase = static_cast<const uint8_t*>(mappedFile->getData());
+        fileLength = mappedFile->getSize();
+        
+       #if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+        // 每个轨道内部是顺序读取的，提示内核加大预读
+        posix_madvise(const_cast<uint8_t*>(fileBase), fileLength, POSIX_MADV_SEQUENTIAL);
+       #endif
+        
+        return true;
+    }
+    
+    // 映射失败（例如空文件或不支持映射的文件系统）时整体读入内存
+    mappedFile.reset();
+    
+    if (!file.loadFileAsData(fileData))
         return false;
+    
+    fileBase = static_cast<const uint8_t*>(fileData.getData());
+    fileLength = fileData.getSize();
+    return true;
+}
+
+void MidiParser::unmapFile()
+{
+    // 轨道中的Meta负载指向映射，必须先清空轨道
+    jassert(tracks.empty());
+    
+    mappedFile.reset();
+    fileData.reset();
+    fileBase = nullptr;
+    fileLength = 0;
+}
+
+bool MidiParser::scanTrackChunks(std::vector<TrackChunkInfo>& chunks)
+{
+    {
+        ScopedLoadTimer timer(loadReport, "Read header");
+        
+        if (!SmfDecoder::readHeader(fileBase, fileLength, header, lastErrorMessage))
+            return false;
     }
     
-    if (progressCallback)
+    const juce::int64 totalLength = (juce::int64) fileLength;
+    chunks.reserve((size_t) header.numTracks);
+    
+    // MThd块可能比6字节长，跳过多余部分
+    juce::int64 position = SmfDecoder::chunkHeaderSize + (juce::int64) header.headerLength;
+    
+    // 恢复模式下记录一个块级问题
+    auto addAnomaly = [this](SmfAnomaly::Type type, juce::int64 offset, const juce::String& detail)
+    {
+        SmfAnomaly anomaly;
+        anomaly.type = type;
+        anomaly.offset = offset;
+        anomaly.detail = detail;
+        loadReport.anomalies.push_back(anomaly);
+    };
+    
+    // 扫描所有MTrk块，直到文件结束（部分文件头中的轨道数并不可靠）
+    while (position + SmfDecoder::chunkHeaderSize <= totalLength)
     {
-        progressCallback(70, "Finishing parsing");
+        if (shouldCancel.load())
+            return false;
+        
+        uint32_t chunkLength = 0;
+        const bool isTrackChunk = SmfDecoder::readChunkHeader(fileBase + position, "MTrk", chunkLength);
+        
+        // 恢复模式：这里不像块头（上一个块的长度不对或者是垃圾数据），直接跳到下一个 MTrk
+        if (recoveryEnabled && !isTrackChunk && !SmfDecoder::isChunkBoundary(fileBase, fileLength, (size_t) position))
+        {
+            const juce::int64 next = (juce::int64) SmfDecoder::findTrackChunk(fileBase, fileLength, (size_t) position + 1);
+            addAnomaly(next < totalLength ? SmfAnomaly::Type::garbageSkipped : SmfAnomaly::Type::trailingGarbage, position,
+                       juce::String(next - position) + " bytes");
+            position = next;
+            continue;
+        }
+        
+        const juce::int64 chunkStart = position;
+        position += SmfDecoder::chunkHeaderSize;
+        
+        // 块长度超出文件末尾：严格模式下加载失败，恢复模式下只解码实际存在的部分
+        if ((juce::int64) chunkLength > totalLength - position)
+        {
+            const juce::int64 declaredLength = chunkLength;
+            
+            if (!recoveryEnabled)
+            {
+                lastErrorMessage = "Chunk at offset " + juce::String(chunkStart) + " declares " + juce::String(declaredLength)
+                                 + " bytes, but only " + juce::String(totalLength - position) + " remain in the file";
+                return false;
+            }
+            
+            chunkLength = (uint32_t) (totalLength - position);
+            
+            // 长度可能是错的而不是文件被截断，如果后面还有 MTrk 就只到那里为止
+            if (isTrackChunk)
+            {
+                const juce::int64 next = (juce::int64) SmfDecoder::findTrackChunk(fileBase, fileLength, (size_t) position);
+                
+                if (next < totalLength)
+                {
+                    chunkLength = (uint32_t) (next - position);
+                    addAnomaly(SmfAnomaly::Type::badChunkLength, chunkStart,
+                               "declared " + juce::String(declaredLength) + " bytes, used " + juce::String((juce::int64) chunkLength));
+                }
+                else
+                {
+                    addAnomaly(SmfAnomaly::Type::truncatedChunk, chunkStart,
+                               "declared " + juce::String(declaredLength) + " bytes, " + juce::String((juce::int64) chunkLength) + " present");
+                }
+            }
+        }
+        else if (recoveryEnabled && isTrackChunk
+                 && !SmfDecoder::isChunkBoundary(fileBase, fileLength, (size_t) (position + chunkLength))
+                 && !(chunkLength >= 3 && std::memcmp(fileBase + position + chunkLength - 3, "\xFF\x2F\x00", 3) == 0))
+        {
+            // 按长度跳过后不是下一个块，块也不是以 End of Track 结尾：长度改为到下一个 MTrk（或文件末尾）为止
+            // （以 End of Track 结尾时长度是对的，后面的垃圾数据在下一轮作为块之间的垃圾跳过）
+            const juce::int64 next = (juce::int64) SmfDecoder::findTrackChunk(fileBase, fileLength, (size_t) position);
+            addAnomaly(SmfAnomaly::Type::badChunkLength, chunkStart,
+                       "declared " + juce::String((juce::int64) chunkLength) + " bytes, used " + juce::String(next - position));
+            chunkLength = (uint32_t) (next - position);
+        }
+        
+        // 跳过未知块
+        if (isTrackChunk)
+            chunks.push_back({ position, chunkLength });
+        
+        position += chunkLength;
     }
     
-    // 添加一个小延迟，让用户能看到进度更新
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    // 不够一个块头的结尾
+    if (recoveryEnabled && position < totalLength)
+        addAnomaly(SmfAnomaly::Type::trailingGarbage, position, juce::String(totalLength - position) + " bytes");
     
-    if (!result)
+    if (chunks.empty())
     {
-        lastErrorMessage = "Failed to parse MIDI file: " + file.getFullPathName() + ". File type: " + juce::String(fileType);
-        if (progressCallback)
-            progressCallback(75, "Error: Failed to parse MIDI file");
+        lastErrorMessage = "No MTrk chunks found";
         return false;
     }
+    
+    juce::int64 totalBytes = 0;
+    for (const auto& chunk : chunks)
+        totalBytes += chunk.length;
+    
+    progress.totalBytes = totalBytes;
+    progress.totalTracks = (int) chunks.size();
+    return true;
+}
 
-    // 计算统计信息
-    if (progressCallback)
+bool MidiParser::decodeTracks(const std::vector<TrackChunkInfo>& chunks)
+{
+    const int numTracks = (int) chunks.size();
+    tracks.clear();
+    tracks.resize(chunks.size());
+    enterPhase(LoadPhase::decoding);
+    progress.live.reset(header.timeFormat);
+    
+    std::vector<juce::String> trackErrors(chunks.size());
+    std::atomic<bool> failed {false};
+    
+    // 恢复模式下每个轨道单独收集问题，最后按轨道顺序合并
+    std::vector<std::vector<SmfAnomaly>> trackAnomalies(recoveryEnabled ? chunks.size() : 0);
+    
+    // 过滤选项：范围内的轨道按选项过滤，范围外的轨道只读出 Set Tempo
+    const SmfEventFilter includedFilter = loadOptions.getEventFilter();
+    const SmfEventFilter excludedFilter;
+    
+    // 压缩存储时每个工作线程一个临时内存池：轨道先解码到这里，压缩进 arena 后整体重置
+    WorkStealingPool& pool = getThreadPool();
+    std::vector<std::unique_ptr<Arena>> scratchArenas(compressedTracks ? (size_t) pool.getNumThreads() : 0);
+    
+    // 力度过滤时每个工作线程一份配对栈，用到时才分配
+    std::vector<std::unique_ptr<SmfNoteStacks>> noteStacks(includedFilter.minVelocity > 0 ? (size_t) pool.getNumThreads() : 0);
+    
+    pool.parallelFor(numTracks, [&](int trackIndex, int workerIndex)
+    {
+        if (failed.load() || shouldCancel.load())
+            return;
+        
+        // 直接在映射上解码，不再复制块内容
+        const TrackChunkInfo& chunk = chunks[(size_t) trackIndex];
+        MidiTrackEvents decoded;
+        MidiTrackEvents& track = compressedTracks ? decoded : tracks[(size_t) trackIndex];
+        Arena* trackArena = &arena;
+        
+        if (compressedTracks)
+        {
+            auto& scratch = scratchArenas[(size_t) workerIndex];
+            if (scratch == nullptr)
+                scratch = std::make_unique<Arena>(arena.getOptions());
+            
+            trackArena = scratch.get();
+        }
+        
+        std::vector<SmfAnomaly>* anomalies = recoveryEnabled ? &trackAnomalies[(size_t) trackIndex] : nullptr;
+        juce::String trackError;
+        
+        const SmfEventFilter* filter = nullptr;
+        SmfNoteStacks* trackNoteStacks = nullptr;
+        
+        if (!loadOptions.includesTrack(trackIndex))
+        {
+            filter = &excludedFilter;
+        }
+        else if (loadOptions.filtersEvents())
+        {
+            filter = &includedFilter;
+            
+            if (filter->minVelocity > 0)
+            {
+                auto& stacks = noteStacks[(size_t) workerIndex];
+                if (stacks == nullptr)
+                    stacks = std::make_unique<SmfNoteStacks>();
+                
+                trackNoteStacks = stacks.get();
+            }
+        }
+        
+        if (!SmfDecoder::decodeTrack(fileBase, fileBase + chunk.offset, chunk.length, track, *trackArena, trackError,
+                                     &progress, &shouldCancel, anomalies, filter, trackNoteStacks))
+        {
+            trackErrors[(size_t) trackIndex] = "Track " + juce::String(trackIndex + 1) + ": " + trackError;
+            failed = true;
+            return;
+        }
+        
+        // 没有 Note Off 的音符在轨道末尾结束，合并后的事件流中也不会留下一直发声的音符
+        size_t numClosed = 0;
+        
+        if (anomalies != nullptr && track.getNumNoteOns() > 0)
+        {
+            numClosed = SmfDecoder::closeUnmatchedNotes(track, *trackArena);
+            
+            if (numClosed > 0)
+            {
+                SmfAnomaly anomaly;
+                anomaly.type = SmfAnomaly::Type::unmatchedNotes;
+                anomaly.offset = chunk.offset + chunk.length;
+                anomaly.detail = juce::String((juce::int64) numClosed) + " Note Off added";
+                anomalies->push_back(anomaly);
+            }
+        }
+        
+        if (compressedTracks)
+        {
+            // 事件压缩进 arena，Meta 引用复制过去，其余字段不变；临时内存池留给这个线程的下一个轨道
+            MidiTrackEvents& stored = tracks[(size_t) trackIndex];
+            stored.packed.compress(track.deltaTicks.data(), track.status.data(), track.data1.data(), track.data2.data(), track.size(), arena);
+            stored.metaEvents.reserve(arena, track.metaEvents.size());
+            
+            for (const MetaEventRef& meta : track.metaEvents)
+                stored.metaEvents.push_back(meta);
+            
+            stored.metaBase = track.metaBase;
+            stored.totalTicks = track.totalTicks;
+            stored.counts = track.counts;
+            trackArena->reset();
+        }
+        
+        progress.tracksDone.fetch_add(1, std::memory_order_relaxed);
+        progress.live.addTrack((int64_t) numClosed);
+    });
+    
+    for (size_t trackIndex = 0; trackIndex < trackAnomalies.size(); ++trackIndex)
     {
-        progressCallback(80, "Calculating statistics");
+        for (SmfAnomaly& anomaly : trackAnomalies[trackIndex])
+        {
+            anomaly.track = (int) trackIndex;
+            loadReport.anomalies.push_back(std::move(anomaly));
+        }
     }
     
-    calculateStatistics(progressCallback);
+    // 块级问题在扫描时已经记录，按文件中的位置排在一起
+    std::stable_sort(loadReport.anomalies.begin(), loadReport.anomalies.end(),
+                     [](const SmfAnomaly& a, const SmfAnomaly& b) { return a.offset < b.offset; });
     
-    if (progressCallback)
+    if (failed.load())
     {
-        progressCallback(90, "Finalizing");
+        // 报告下标最小的错误轨道
+        for (const auto& error : trackErrors)
+        {
+            if (error.isNotEmpty())
+            {
+                lastErrorMessage = error;
+                break;
+            }
+        }
+        
+        return false;
     }
     
-    // 添加一个小延迟，让用户能看到进度更新
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return !shouldCancel.load();
+}
+
+void MidiParser::unload()
+{
+    resetParser();
+    shouldCancel = false;
+}
 
-    if (progressCallback)
+void MidiParser::releaseMemory()
+{
+    resetParser();
+    arena.release();
+}
+
+WorkStealingPool& MidiParser::getThreadPool()
+{
+    if (sharedPool != nullptr)
+        return *sharedPool;
+    
+    int numThreads = requestedThreads.load();
+    if (numThreads <= 0)
+        numThreads = (int) std::max(1u, std::thread::hardware_concurrency());
+    
+    if (threadPool == nullptr || threadPool->getNumThreads() != numThreads)
     {
-        progressCallback(100, "MIDI file loaded successfully");
+        threadPool = std::make_unique<WorkStealingPool>(numThreads);
+        threadPool->setTracing(tracingEnabled, LoadProgress::getPhaseName(progress.getPhase()));
     }
+    
+    return *threadPool;
+}
+
+bool MidiParser::mergeTracks()
+{
+    mergedEvents.prepare(tracks, arena);
+    progress.totalMergeEvents = (juce::int64) mergedEvents.getTotalEvents();
+    
+    // 分批合并，批与批之间检查取消并更新进度
+    const size_t batchSize = 1 << 20;
+    
+    while (!mergedEvents.isFinished())
+    {
+        if (shouldCancel.load())
+            return false;
         
-    lastErrorMessage = "MIDI file loaded successfully. File type: " + juce::String(fileType) + 
-                      ", Tracks: " + juce::String(statistics.totalTracks) + 
-                      ", Events: " + juce::String(statistics.totalEvents) + 
-                      ", Notes: " + juce::String(statistics.totalNotes);
+        if (mergedEvents.mergeNext(batchSize) == 0)
+            break;
+        
+        progress.eventsMerged.store((juce::int64) mergedEvents.getNumMerged(), std::memory_order_relaxed);
+    }
+    
+    // 同时发声数需要全局时间顺序，在合并时顺带得到
+    statistics.maxPolyphony = mergedEvents.getMaxPolyphony();
     return true;
 }
 
-void MidiParser::calculateStatistics(ProgressCallback progressCallback)
+std::vector<size_t> MidiParser::queryWindow(juce::int64 startTick, juce::int64 endTick) const
 {
-    statistics.totalTracks = midiFile.getNumTracks();
-    statistics.fileType = 1; // 默认值，实际应该从文件头获取
-    statistics.timeFormat = midiFile.getTimeFormat();
+    std::vector<size_t> result;
     
-    int totalEvents = 0;
-    int totalNotes = 0;
+    if (endTick > 0)
+        seekIndex.queryNotes(noteTable, (uint64_t) juce::jmax((juce::int64) 0, startTick), (uint64_t) endTick, result);
     
-    // 遍历所有轨道计算统计信息
-    for (int trackIndex = 0; trackIndex < statistics.totalTracks; ++trackIndex)
+    return result;
+}
+
+juce::MidiFile MidiParser::getMidiFile() const
+{
+    juce::MidiFile midiFile;
+    
+    if (header.timeFormat > 0)
+        midiFile.setTicksPerQuarterNote(header.timeFormat);
+    else
+        midiFile.setSmpteTimeFormat(-(header.timeFormat >> 8), header.timeFormat & 0xFF);
+    
+    for (const auto& track : tracks)
     {
-        // 检查是否需要取消
-        if (shouldCancel.load())
-        {
-            if (progressCallback)
-                progressCallback(80 + (10 * trackIndex / statistics.totalTracks), "Loading cancelled");
-            return;
-        }
+        juce::MidiMessageSequence sequence;
+        sequence.ensureStorageAllocated((int) track.size());
         
-        const juce::MidiMessageSequence* track = midiFile.getTrack(trackIndex);
-        if (track != nullptr)
+        uint64_t tick = 0;
+        size_t metaIndex = 0;
+        TrackEventReader reader(track);
+        TrackEventSpan span;
+        
+        while (reader.next(span))
         {
-            int numEvents = track->getNumEvents();
-            totalEvents += numEvents;
-            
-            // 计算音符数量
-            for (int eventIndex = 0; eventIndex < numEvents; ++eventIndex)
+            for (size_t i = 0; i < span.numEvents; ++i)
             {
-                const auto* event = track->getEventPointer(eventIndex);
-                if (event != nullptr && event->message.isNoteOn())
+                tick += span.deltaTicks[i];
+                const uint8_t status = span.status[i];
+                
+                if (isChannelStatus(status))
                 {
-                    totalNotes++;
+                    const int numBytes = ((status & 0xE0) == 0xC0) ? 2 : 3;
+                    const uint8_t bytes[] = { status, span.data1[i], span.data2[i] };
+                    sequence.addEvent(juce::MidiMessage(bytes, numBytes, (double) tick));
+                    continue;
+                }
+                
+                const MetaEventRef& meta = track.metaEvents[metaIndex++];
+                const uint8_t* payload = track.getMetaData(meta);
+                
+                if (status == 0xFF)
+                {
+                    // 重新拼出 FF type length data
+                    std::vector<uint8_t> bytes { 0xFF, meta.type };
+                    uint32_t length = meta.length;
+                    uint8_t lengthBytes[4];
+                    int numLengthBytes = 0;
+                    do
+                    {
+                        lengthBytes[numLengthBytes++] = (uint8_t) (length & 0x7F);
+                        length >>= 7;
+                    } while (length != 0 && numLengthBytes < 4);
+                
+                    for (int b = numLengthBytes - 1; b >= 0; --b)
+                        bytes.push_back((uint8_t) (lengthBytes[b] | (b > 0 ? 0x80 : 0)));
+                
+                    bytes.insert(bytes.end(), payload, payload + meta.length);
+                    sequence.addEvent(juce::MidiMessage(bytes.data(), (int) bytes.size(), (double) tick));
+                }
+                else
+                {
+                    auto message = juce::MidiMessage::createSysExMessage(payload, (int) meta.length);
+                    message.setTimeStamp((double) tick);
+                    sequence.addEvent(message);
                 }
             }
         }
         
-        // 更新进度
-        if (progressCallback)
-        {
-            int progress = 80 + (10 * (trackIndex + 1) / statistics.totalTracks);
-            progressCallback(progress, "Processing track " + juce::String(trackIndex + 1) + "/" + juce::String(statistics.totalTracks));
-        }
+        sequence.updateMatchedPairs();
+        midiFile.addTrack(sequence);
+    }
+    
+    return midiFile;
+}
+
+void MidiParser::calculateStatistics()
+{
+    statistics.totalTracks = (int) tracks.size();
+    statistics.fileType = header.format;
+    statistics.timeFormat = header.timeFormat;
+    statistics.repairedAnomalies = (int) loadReport.anomalies.size();
+    
+    // 计数在解码时已经按轨道累加好，这里只合并，不再扫描事件
+    EventCounts counts;
+    juce::int64 totalEvents = 0;
+    uint64_t lastTick = 0;
+    
+    for (const auto& track : tracks)
+    {
+        counts += track.counts;
+        totalEvents += (juce::int64) track.size();
+        lastTick = juce::jmax(lastTick, track.totalTicks);
     }
     
     statistics.totalEvents = totalEvents;
-    statistics.totalNotes = totalNotes;
+    statistics.totalNotes = (juce::int64) counts.getTotalNotes();
     
-    // 计算总时长
-    statistics.totalDuration = midiFile.getLastTimestamp();
+    for (int i = 0; i < 8; ++i)
+        statistics.eventTypeCounts[i] = (juce::int64) counts.eventTypes[i];
     
-    // 转换为秒（如果可能）
-    midiFile.convertTimestampTicksToSeconds();
-}
\ No newline at end of file
+    for (int i = 0; i < 16; ++i)
+        statistics.channelNoteCounts[i] = (juce::int64) counts.channelNotes[i];
+    
+    // 计算总时长：tick数和通过速度表换算的秒数
+    statistics.totalTicks = (juce::int64) lastTick;
+    statistics.totalDuration = tempoMap.ticksToSeconds((double) lastTick);
+    statistics.tempoChanges = (int) tempoMap.getSegments().size() - 1;
+}
@@ -6,6 +6,17 @@
 #define CANDYJAR_MIDIPARSER_H
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "SmfDecoder.h"
+#include "MidiEventMerger.h"
+#include "NoteTable.h"
+#include "TempoMap.h"
+#include "LoadProgress.h"
+#include "SeekIndex.h"
+#include "IndexCache.h"
+#include "LoadReport.h"
+#include "LoadOptions.h"
+#include "MidiEventStream.h"
+#include "../Utils/WorkStealingPool.h"
 #include <atomic>
 #include <thread>
 #include <future>
@@ -14,11 +25,20 @@
 struct MidiStatistics
 {
     int totalTracks = 0;
-    int totalEvents = 0;
-    int totalNotes = 0;
+    juce::int64 totalEvents = 0;
+    juce::int64 totalNotes = 0;
     double totalDuration = 0.0; // 以秒为单位
+    juce::int64 totalTicks = 0;
+    int tempoChanges = 0;
     int fileType = 0;
     int timeFormat = 0;
+    
+    // 按状态字节高4位的事件分布：[0] Note Off, [1] Note On, [2] Poly Aftertouch, [3] CC,
+    // [4] Program Change, [5] Channel Pressure, [6] Pitch Bend, [7] Meta/SysEx
+    juce::int64 eventTypeCounts[8] = {};
+    juce::int64 channelNoteCounts[16] = {};
+    int maxPolyphony = 0;
+    int repairedAnomalies = 0;  // 恢复模式下修复的文件问题数（详细列表见 LoadReport::anomalies）
 };
 
 class MidiParser
@@ -27,36 +47,165 @@ public:
     MidiParser();
     ~MidiParser();
 
-    // 定义进度回调函数类型
-    using ProgressCallback = std::function<void(int progressPercentage, const juce::String& message)>;
-    
     // 异步加载MIDI文件
-    std::future<bool> loadMidiFileAsync(const juce::File& midiFile, ProgressCallback progressCallback = nullptr);
+    std::future<bool> loadMidiFileAsync(const juce::File& midiFile, const MidiLoadOptions& options = {});
     
     // 同步加载MIDI文件（改进版）
-    bool loadMidiFile(const juce::File& midiFile, ProgressCallback progressCallback = nullptr);
+    // options 可以只保留一部分事件（事件类型、通道、轨道范围、力度），被过滤的事件在解码时跳过，不占内存
+    bool loadMidiFile(const juce::File& midiFile, const MidiLoadOptions& options = {});
+    
+    // 最近一次加载使用的过滤选项
+    const MidiLoadOptions& getLoadOptions() const { return loadOptions; }
+    
+    // 以流式模式打开MIDI文件：只读文件头和块头，不解码轨道
+    // 通常几毫秒内返回，但恢复模式下块长度不对时要在文件中搜索下一个块头，可以用 cancelLoading() 取消
+    // 之后通过 getStream() 边播放边读取事件，内存占用与文件大小无关；
+    // 轨道、音符表、合并事件流和定位索引都为空，统计信息只有文件头中的部分
+    bool openStream(const juce::File& midiFile);
+    
+    // 流式模式的事件源（openStream 成功后有效，下一次加载时关闭）
+    MidiEventStream& getStream() { return eventStream; }
+    bool isStreaming() const { return eventStream.isOpen(); }
+    
+    // 加载进度，可以在任意线程轮询
+    const LoadProgress& getProgress() const { return progress; }
+    
+    // 转换为juce::MidiFile（每个事件都会单独分配内存，只适合小文件）
+    juce::MidiFile getMidiFile() const;
+    
+    // 获取解码后的轨道数据
+    const std::vector<MidiTrackEvents>& getTracks() const { return tracks; }
     
-    // 获取MIDI文件
-    const juce::MidiFile& getMidiFile() const { return midiFile; }
+    // 获取配对好的音符表
+    const NoteTable& getNoteTable() const { return noteTable; }
+    
+    // 获取速度表（tick与秒之间的换算）
+    const TempoMap& getTempoMap() const { return tempoMap; }
+    
+    // 获取所有轨道归并后的全局有序事件流
+    const MidiEventMerger& getMergedEvents() const { return mergedEvents; }
+    
+    // 按时间定位的索引：跳转时的事件位置和控制器状态
+    const SeekIndex& getSeekIndex() const { return seekIndex; }
+    
+    // 返回与 [startTick, endTick) 重叠的音符在音符表中的下标，复杂度 O(轨道数 * log n + k)
+    std::vector<size_t> queryWindow(juce::int64 startTick, juce::int64 endTick) const;
+    
+    // 获取MThd头信息
+    const SmfHeader& getHeader() const { return header; }
     
     // 获取统计信息
     const MidiStatistics& getStatistics() const { return statistics; }
     
+    // 最近一次加载的耗时报告（各阶段用时、内存池分配、线程忙碌时间），加载结束后读取
+    const LoadReport& getLoadReport() const { return loadReport; }
+    
+    // 是否在报告中记录线程池的每个任务（用于导出 Chrome 跟踪，默认关闭），在下一次加载时生效
+    void setTracingEnabled(bool shouldTrace) { tracingEnabled = shouldTrace; }
+    
     // 获取最后错误信息
     const juce::String& getLastErrorMessage() const { return lastErrorMessage; }
     
-    // 取消加载操作
-    void cancelLoading() { shouldCancel = true; }
+    // 取消加载操作，可以在任意线程调用，50毫秒内生效（解码、配对等循环内部也会检查）
+    // 在加载开始之前调用时，接下来的一次同步加载会立即取消；正在后台写入的缓存也会放弃
+    void cancelLoading() { shouldCancel = true; cancelCacheWrite = true; }
+    
+    // 设置解码线程数（<= 0 表示使用全部硬件线程），在下一次加载时生效
+    void setNumThreads(int numThreads) { requestedThreads = numThreads; }
+    
+    // 是否使用解析结果缓存（默认关闭）。开启后每个加载过的文件在缓存目录中留下一个和加载结果差不多大的文件，
+    // 缓存目录没有大小上限，也不会自动清理，由调用方管理。
+    // 缓存在加载完成后由后台线程写入，不计入加载时间；下一次加载、releaseMemory() 和析构时等它写完。
+    // 命中缓存时直接映射缓存文件，不解码轨道：getTracks() 为空，LoadReport::anomalies 也为空
+    // （修复过的问题数仍在 MidiStatistics::repairedAnomalies 中）
+    void setCacheEnabled(bool shouldUseCache) { cacheEnabled = shouldUseCache; }
+    
+    // 等待后台的缓存写入结束，没有正在写入的缓存时立即返回
+    void waitForCacheWrite();
+    
+    // 恢复模式（默认开启）：块长度错误、块之间的垃圾数据、截断的事件和缺少的 End of Track 不再导致加载失败，
+    // 没有 Note Off 的音符在轨道末尾补上 Note Off，修复的每个问题都列在 LoadReport::anomalies 中。
+    // 关闭时任何格式错误都会使加载失败。在下一次加载时生效
+    void setRecoveryEnabled(bool shouldRecover) { recoveryEnabled = shouldRecover; }
+    
+    // 压缩存储轨道事件（默认关闭）：每个轨道解码到工作线程的临时内存池后按块压缩，
+    // 轨道事件的内存约为原来的 1/3 到 1/4，代价是解码后多一遍压缩、之后的读取多一遍解压。
+    // 压缩的轨道只能通过 TrackEventReader 读取。在下一次加载时生效
+    void setCompressedTracks(bool shouldCompress) { compressedTracks = shouldCompress; }
+    
+    // 缓存目录，默认在用户数据目录下；设为 juce::File() 时缓存写在MIDI文件旁边
+    void setCacheDirectory(const juce::File& directory) { cacheDirectory = directory; }
+    
+    // 最近一次加载是否来自缓存
+    bool isLoadedFromCache() const { return indexCache.isOpen(); }
+    
+    // 加载数据所在的内存池是否尽量使用大页（默认关闭），在之后新映射的内存块上生效
+    void setUseHugePages(bool shouldUseHugePages);
+    
+    // 加载数据占用的内存池，重新加载时复用
+    const Arena& getArena() const { return arena; }
+    
+    // 解析用的线程池，加载之外也可以借用（不能和加载同时使用）
+    WorkStealingPool& getThreadPool();
+    
+    // 改用外部线程池（nullptr 恢复使用自己的线程池），线程池必须比解析器活得久，在下一次加载时生效
+    // 多个解析器可以共用一个线程池；在池内线程中加载时解码等并行步骤直接在当前线程串行执行。
+    // 共用时不记录线程忙碌时间和任务跟踪（线程池可能同时在为其他解析器工作），setNumThreads 不起作用
+    void setSharedThreadPool(WorkStealingPool* pool) { sharedPool = pool; }
+    
+    // 丢弃已加载的数据和还没生效的取消请求，内存池留给下一次加载复用（不能和加载同时调用）
+    void unload();
+    
+    // 丢弃已加载的数据，并把内存池全部归还系统（reset 只把内存留给下一次加载复用）
+    void releaseMemory();
 
 private:
-    juce::MidiFile midiFile;
+    // 每次加载的轨道、音符表、合并事件流和定位索引都在这里分配，重置时整体回收
+    Arena arena;
+    SmfHeader header;
+    std::vector<MidiTrackEvents> tracks;
+    MidiEventMerger mergedEvents;
+    NoteTable noteTable;
+    SeekIndex seekIndex;
+    TempoMap tempoMap;
+    MidiEventStream eventStream;
     MidiStatistics statistics;
     juce::String lastErrorMessage;
     std::atomic<bool> shouldCancel {false};
+    std::atomic<int> requestedThreads {0};
+    LoadProgress progress;
+    LoadReport loadReport;
+    bool tracingEnabled = false;
+    bool recoveryEnabled = true;
+    bool compressedTracks = false;
+    MidiLoadOptions loadOptions;
+    
+    // 解析结果缓存
+    bool cacheEnabled = false;
+    juce::File cacheDirectory;
+    IndexCache indexCache;
+    std::thread cacheWriter;                       // 只读取加载结果，resetParser() 先等它结束
+    std::atomic<bool> cancelCacheWrite {false};
+    std::unique_ptr<WorkStealingPool> threadPool;
+    WorkStealingPool* sharedPool = nullptr;
+    
+    // 文件内容：优先内存映射，失败时整体读入 fileData
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    juce::MemoryBlock fileData;
+    const uint8_t* fileBase = nullptr;
+    size_t fileLength = 0;
     
     // 内部方法
-    bool parseMidiData(juce::InputStream& stream, ProgressCallback progressCallback);
-    void calculateStatistics(ProgressCallback progressCallback);
+    bool mapFile(const juce::File& file);
+    void unmapFile();
+    bool scanTrackChunks(std::vector<TrackChunkInfo>& chunks);
+    bool decodeTracks(const std::vector<TrackChunkInfo>& chunks);
+    bool mergeTracks();
+    void calculateStatistics();
+    void enterPhase(LoadPhase phase);
+    bool finishLoading(LoadPhase phase);
+    bool openCache(const juce::File& file, const IndexCacheKey& key);
+    void writeCache(const juce::File& file, const IndexCacheKey& key);
     void resetParser();
 };
 
@@ -0,0 +1,207 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_MIDITRACKEVENTS_H
+#define CANDYJAR_MIDITRACKEVENTS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "../Utils/Arena.h"
+#include "CompressedTrackEvents.h"
+
+// 一段事件的计数结果，可以直接相加合并
+struct EventCounts
+{
+    // 按状态字节高4位统计：[0] = 0x8 Note Off ... [6] = 0xE Pitch Bend，[7] = 0xF Meta/SysEx
+    uint64_t eventTypes[8] = {};
+    // 每个通道力度不为0的 Note On 数量
+    uint64_t channelNotes[16] = {};
+
+    uint64_t getTotalNotes() const
+    {
+        uint64_t total = 0;
+        for (auto count : channelNotes)
+            total += count;
+        return total;
+    }
+
+    uint64_t getTotalEvents() const
+    {
+        uint64_t total = 0;
+        for (auto count : eventTypes)
+            total += count;
+        return total;
+    }
+
+    EventCounts& operator+= (const EventCounts& other)
+    {
+        for (int i = 0; i < 8; ++i)
+            eventTypes[i] += other.eventTypes[i];
+        for (int i = 0; i < 16; ++i)
+            channelNotes[i] += other.channelNotes[i];
+        return *this;
+    }
+};
+
+// Meta/SysEx事件的附加信息，负载数据不放进紧凑事件数组里
+struct MetaEventRef
+{
+    uint64_t tick = 0;        // 绝对tick
+    uint32_t eventIndex = 0;  // 在轨道事件数组中的下标
+    uint32_t length = 0;      // 负载长度（字节）
+    uint64_t dataOffset = 0;  // 负载相对 MidiTrackEvents::metaBase 的偏移（即在文件中的偏移）
+    uint8_t type = 0;         // Meta类型（SysEx为0）
+};
+
+// 单个轨道解码后的事件，按列紧凑存放：每个事件只占 4 + 1 + 1 + 1 = 7 字节
+//  - 通道消息：status为原始状态字节（已展开running status），data1/data2为数据字节
+//  - Meta事件：status = 0xFF，data1 = Meta类型
+//  - SysEx事件：status = 0xF0 或 0xF7
+// 各列都在加载用的 Arena 中分配，随 Arena::reset() 一起回收，轨道本身不释放任何内存
+// 压缩存储时（见 MidiParser::setCompressedTracks）四列为空，事件在 packed 中，只能通过 TrackEventReader 读取
+struct MidiTrackEvents
+{
+    ArenaArray<uint32_t> deltaTicks;
+    ArenaArray<uint8_t> status;
+    ArenaArray<uint8_t> data1;
+    ArenaArray<uint8_t> data2;
+
+    // Meta/SysEx负载不复制，直接指回内存映射的文件
+    ArenaArray<MetaEventRef> metaEvents;
+    const uint8_t* metaBase = nullptr;
+
+    CompressedTrackEvents packed;
+
+    uint64_t totalTicks = 0;     // 轨道长度（所有delta之和）
+    EventCounts counts;          // 按类型和通道的事件计数，解码时逐个事件累加，统计信息直接由它们合并
+
+    // 力度不为0的Note On数量，以及 Meta/SysEx 以外的通道消息数量
+    uint32_t getNumNoteOns() const { return (uint32_t) counts.getTotalNotes(); }
+    uint32_t getNumChannelEvents() const { return (uint32_t) (counts.getTotalEvents() - counts.eventTypes[7]); }
+
+    // 两种存储方式中只有一种有内容，直接相加，解码循环里不用判断
+    size_t size() const { return status.size() + packed.size(); }
+    bool empty() const { return size() == 0; }
+    bool isCompressed() const { return !packed.empty(); }
+
+    // 事件数据占用的字节数（不含 Meta 引用）
+    size_t getEventBytes() const { return status.size() * 7 + packed.getBytesUsed(); }
+
+    const uint8_t* getMetaData(const MetaEventRef& meta) const { return metaBase + meta.dataOffset; }
+
+    void reserve(Arena& arena, size_t numEvents, size_t numMetaEvents)
+    {
+        deltaTicks.reserve(arena, numEvents);
+        status.reserve(arena, numEvents);
+        data1.reserve(arena, numEvents);
+        data2.reserve(arena, numEvents);
+        metaEvents.reserve(arena, numMetaEvents);
+    }
+
+    // 把四列压缩到 arena 中，之后四列为空（原来的内存随各自的 arena 回收）
+    void compress(Arena& arena)
+    {
+        packed.compress(deltaTicks.data(), status.data(), data1.data(), data2.data(), status.size(), arena);
+        deltaTicks.clear();
+        status.clear();
+        data1.clear();
+        data2.clear();
+    }
+
+    void clear()
+    {
+        deltaTicks.clear();
+        status.clear();
+        data1.clear();
+        data2.clear();
+        packed.clear();
+        metaEvents.clear();
+        metaBase = nullptr;
+        totalTicks = 0;
+        counts = EventCounts();
+    }
+};
+
+// 轨道中连续的一段事件，按列存放
+struct TrackEventSpan
+{
+    const uint32_t* deltaTicks = nullptr;
+    const uint8_t* status = nullptr;
+    const uint8_t* data1 = nullptr;
+    const uint8_t* data2 = nullptr;
+    size_t firstEvent = 0;    // 第一个事件在轨道中的下标
+    size_t numEvents = 0;
+};
+
+// 按段顺序读取轨道事件，两种存储方式用同一个循环处理：
+//  - 未压缩的轨道一次返回整个轨道，直接指向原来的四列，不复制
+//  - 压缩的轨道每次把最多 maxSpanEvents 个事件（不跨块）解压到读取器自己的缓冲区，
+//    默认一整块（2048 个事件，14KB），缓冲区反复使用，一直留在缓存里
+class TrackEventReader
+{
+public:
+    explicit TrackEventReader(const MidiTrackEvents& trackToRead, size_t maxSpanEvents = CompressedTrackEvents::eventsPerBlock)
+        : track(&trackToRead), maxSpan(getSpanLimit(maxSpanEvents))
+    {
+        if (track->isCompressed())
+        {
+            deltaBuffer.resize(maxSpan);
+            byteBuffer.resize(maxSpan * 3);
+        }
+    }
+
+    // 读取下一段，之前返回的段失效；读完时返回 false
+    bool next(TrackEventSpan& span)
+    {
+        const size_t numEvents = track->size();
+
+        if (position >= numEvents)
+            return false;
+
+        span.firstEvent = position;
+
+        if (!track->isCompressed())
+        {
+            span.deltaTicks = track->deltaTicks.data();
+            span.status = track->status.data();
+            span.data1 = track->data1.data();
+            span.data2 = track->data2.data();
+            span.numEvents = numEvents;
+            position = numEvents;
+            return true;
+        }
+
+        span.numEvents = std::min(maxSpan, track->packed.getBlockEnd(position) - position);
+        span.deltaTicks = deltaBuffer.data();
+        span.status = byteBuffer.data();
+        span.data1 = byteBuffer.data() + maxSpan;
+        span.data2 = byteBuffer.data() + maxSpan * 2;
+        track->packed.decode(position, span.numEvents, deltaBuffer.data(), byteBuffer.data(),
+                             byteBuffer.data() + maxSpan, byteBuffer.data() + maxSpan * 2);
+        position += span.numEvents;
+        return true;
+    }
+
+private:
+    const MidiTrackEvents* track;
+    size_t maxSpan;   // 整组的倍数，每段都从整组开始；最后一段不满一组时多解出的事件也在缓冲区内
+    size_t position = 0;
+    std::vector<uint32_t> deltaBuffer;
+    std::vector<uint8_t> byteBuffer;
+
+    static size_t getSpanLimit(size_t maxSpanEvents)
+    {
+        constexpr size_t group = CompressedTrackEvents::eventsPerGroup;
+        const size_t limit = std::min(maxSpanEvents, CompressedTrackEvents::eventsPerBlock);
+        return std::max((limit + group - 1) / group * group, group);
+    }
+};
+
+// 状态字节辅助函数
+inline bool isChannelStatus(uint8_t status) { return status >= 0x80 && status < 0xF0; }
+inline bool isNoteOnEvent(uint8_t status, uint8_t velocity) { return (status & 0xF0) == 0x90 && velocity != 0; }
+inline bool isNoteOffEvent(uint8_t status, uint8_t velocity) { return (status & 0xF0) == 0x80 || ((status & 0xF0) == 0x90 && velocity == 0); }
+
+#endif //CANDYJAR_MIDITRACKEVENTS_H
@@ -0,0 +1,168 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "NoteTable.h"
+#include <algorithm>
+
+namespace
+{
+    constexpr uint32_t noOpenNote = ~(uint32_t) 0;
+    constexpr int numStacks = 16 * 128;
+
+    // 配对时每处理这么多事件检查一次取消
+    constexpr size_t cancelCheckInterval = 1 << 20;
+
+    inline uint32_t clampTick(uint64_t tick)
+    {
+        return tick > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t) tick;
+    }
+}
+
+void NoteTable::clear()
+{
+    startTicks.clear();
+    endTicks.clear();
+    keys.clear();
+    velocities.clear();
+    channels.clear();
+    trackIndices.clear();
+    trackOffsets.clear();
+    numUnmatchedNotes = 0;
+}
+
+void NoteTable::attach(size_t numNotes, const uint32_t* startTickData, const uint32_t* endTickData,
+                       const uint8_t* keyData, const uint8_t* velocityData, const uint8_t* channelData,
+                       const uint32_t* trackIndexData, const uint64_t* trackOffsetData, size_t numTracks,
+                       size_t numUnmatched)
+{
+    clear();
+
+    startTicks.setView(startTickData, numNotes);
+    endTicks.setView(endTickData, numNotes);
+    keys.setView(keyData, numNotes);
+    velocities.setView(velocityData, numNotes);
+    channels.setView(channelData, numNotes);
+    trackIndices.setView(trackIndexData, numNotes);
+
+    // 轨道偏移很小，复制一份
+    trackOffsets.assign(trackOffsetData, trackOffsetData + numTracks + 1);
+    numUnmatchedNotes = numUnmatched;
+}
+
+bool NoteTable::build(const std::vector<MidiTrackEvents>& tracks, Arena& arena, WorkStealingPool& pool,
+                      const std::atomic<bool>* cancelFlag)
+{
+    clear();
+
+    // 解码时已统计了每个轨道的 Note On 数量，前缀和就是每个轨道在表中的位置
+    trackOffsets.resize(tracks.size() + 1);
+    trackOffsets[0] = 0;
+
+    for (size_t i = 0; i < tracks.size(); ++i)
+        trackOffsets[i + 1] = trackOffsets[i] + tracks[i].getNumNoteOns();
+
+    const size_t numNotes = trackOffsets.back();
+    startTicks.allocate(arena, numNotes);
+    endTicks.allocate(arena, numNotes);
+    keys.allocate(arena, numNotes);
+    velocities.allocate(arena, numNotes);
+    channels.allocate(arena, numNotes);
+    trackIndices.allocate(arena, numNotes);
+
+    // 每个工作线程一组栈顶，整个构建过程中不再分配内存
+    std::vector<uint32_t> stackHeads((size_t) pool.getNumThreads() * numStacks);
+    std::vector<size_t> unmatched(tracks.size());
+
+    pool.parallelFor((int) tracks.size(), [&](int trackIndex, int workerIndex)
+    {
+        if (cancelFlag != nullptr && cancelFlag->load(std::memory_order_relaxed))
+            return;
+
+        uint32_t* openNotes = stackHeads.data() + (size_t) workerIndex * numStacks;
+        unmatched[(size_t) trackIndex] = pairTrack(tracks[(size_t) trackIndex], (uint32_t) trackIndex, openNotes, cancelFlag);
+    });
+
+    if (cancelFlag != nullptr && cancelFlag->load())
+        return false;
+
+    for (auto count : unmatched)
+        numUnmatchedNotes += count;
+
+    return true;
+}
+
+size_t NoteTable::pairTrack(const MidiTrackEvents& track, uint32_t trackIndex, uint32_t* openNotes, const std::atomic<bool>* cancelFlag)
+{
+    std::fill(openNotes, openNotes + numStacks, noOpenNote);
+
+    const size_t base = trackOffsets[trackIndex];
+    size_t noteIndex = base;
+    uint64_t tick = 0;
+
+    // 压缩存储的轨道一次解压一块，未压缩的轨道只有一段
+    TrackEventReader reader(track);
+    TrackEventSpan span;
+
+    // 每个 (通道, 音高) 一个后进先出的栈。音符未结束时，它的 endTicks 槽位暂存
+    // 栈中下一个音符的下标，这样栈本身不需要任何额外内存
+    while (reader.next(span))
+    {
+        const uint32_t* deltas = span.deltaTicks;
+        const uint8_t* status = span.status;
+        const uint8_t* data1 = span.data1;
+        const uint8_t* data2 = span.data2;
+
+        for (size_t i = 0; i < span.numEvents; ++i)
+        {
+            // 取消后结果会被丢弃，直接返回
+            if (((span.firstEvent + i) & (cancelCheckInterval - 1)) == 0 && cancelFlag != nullptr && cancelFlag->load(std::memory_order_relaxed))
+                return 0;
+
+            tick += deltas[i];
+            const uint8_t type = status[i] & 0xF0;
+
+            if (type != 0x80 && type != 0x90)
+                continue;
+
+            const uint8_t channel = status[i] & 0x0F;
+            const uint8_t key = data1[i];
+            uint32_t& head = openNotes[channel * 128 + key];
+
+            if (isNoteOnEvent(status[i], data2[i]))
+            {
+                startTicks[noteIndex] = clampTick(tick);
+                keys[noteIndex] = key;
+                velocities[noteIndex] = data2[i];
+                channels[noteIndex] = channel;
+                trackIndices[noteIndex] = trackIndex;
+                endTicks[noteIndex] = head;
+                head = (uint32_t) (noteIndex - base);
+                ++noteIndex;
+            }
+            else if (head != noOpenNote)
+            {
+                const size_t openIndex = base + head;
+                head = endTicks[openIndex];
+                endTicks[openIndex] = clampTick(tick);
+            }
+        }
+    }
+
+    // 没有 Note Off 的音符持续到轨道结束
+    size_t numUnmatched = 0;
+    const uint32_t trackEnd = clampTick(track.totalTicks);
+
+    for (int stack = 0; stack < numStacks; ++stack)
+    {
+        for (uint32_t open = openNotes[stack]; open != noOpenNote;)
+        {
+            const size_t openIndex = base + open;
+            open = endTicks[openIndex];
+            endTicks[openIndex] = trackEnd;
+            ++numUnmatched;
+        }
+    }
+
+    return numUnmatched;
+}
@@ -0,0 +1,63 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_NOTETABLE_H
+#define CANDYJAR_NOTETABLE_H
+
+#include "MidiTrackEvents.h"
+#include "../Utils/WorkStealingPool.h"
+#include "../Utils/PodArray.h"
+
+// 配对好 Note On / Note Off 的音符表，按列存放（每个音符 4 + 4 + 1 + 1 + 1 + 4 = 15 字节）
+// 音符先按轨道、再按起始tick排序，每个轨道的音符是连续的一段（见 getTrackNoteBegin/End）
+class NoteTable
+{
+public:
+    // 从解码后的轨道构建音符表，各列在 arena 中分配，各轨道在线程池中并行配对
+    // cancelFlag 置位时尽快返回 false，此时表的内容无效
+    bool build(const std::vector<MidiTrackEvents>& tracks, Arena& arena, WorkStealingPool& pool,
+               const std::atomic<bool>* cancelFlag = nullptr);
+
+    // 直接引用外部内存中的列（例如映射的缓存文件），不复制；外部内存在 clear() 之前必须保持有效
+    // trackOffsets 有 numTracks + 1 项
+    void attach(size_t numNotes, const uint32_t* startTickData, const uint32_t* endTickData,
+                const uint8_t* keyData, const uint8_t* velocityData, const uint8_t* channelData,
+                const uint32_t* trackIndexData, const uint64_t* trackOffsetData, size_t numTracks,
+                size_t numUnmatched);
+
+    void clear();
+
+    size_t size() const { return startTicks.size(); }
+    bool empty() const { return startTicks.empty(); }
+
+    const uint32_t* getStartTicks() const { return startTicks.data(); }
+    const uint32_t* getEndTicks() const { return endTicks.data(); }
+    const uint8_t* getKeys() const { return keys.data(); }
+    const uint8_t* getVelocities() const { return velocities.data(); }
+    const uint8_t* getChannels() const { return channels.data(); }
+    const uint32_t* getTracks() const { return trackIndices.data(); }
+
+    // 轨道 trackIndex 的音符在表中的范围 [begin, end)
+    size_t getTrackNoteBegin(size_t trackIndex) const { return trackOffsets[trackIndex]; }
+    size_t getTrackNoteEnd(size_t trackIndex) const { return trackOffsets[trackIndex + 1]; }
+    size_t getNumTracks() const { return trackOffsets.empty() ? 0 : trackOffsets.size() - 1; }
+
+    // 没有对应 Note Off 的音符数量（这些音符在轨道结束处截止）
+    size_t getNumUnmatchedNotes() const { return numUnmatchedNotes; }
+
+private:
+    PodArray<uint32_t> startTicks;
+    PodArray<uint32_t> endTicks;
+    PodArray<uint8_t> keys;
+    PodArray<uint8_t> velocities;
+    PodArray<uint8_t> channels;
+    PodArray<uint32_t> trackIndices;
+    std::vector<size_t> trackOffsets;
+    size_t numUnmatchedNotes = 0;
+
+    // 配对一个轨道的音符，openNotes 是每个 (通道, 音高) 的栈顶，调用者预先分配
+    size_t pairTrack(const MidiTrackEvents& track, uint32_t trackIndex, uint32_t* openNotes, const std::atomic<bool>* cancelFlag);
+};
+
+#endif //CANDYJAR_NOTETABLE_H
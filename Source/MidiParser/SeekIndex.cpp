@@ -0,0 +1,502 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "SeekIndex.h"
+#include <algorithm>
+
+namespace
+{
+    // 稀疏控制器项中CC号之外的种类
+    constexpr uint32_t programKind = 128;
+    constexpr uint32_t channelPressureKind = 129;
+    constexpr uint32_t pitchBendKind = 130;
+
+    // 长度为0的音符按1 tick算，否则它不和任何区间重叠
+    inline uint64_t getEffectiveEnd(uint32_t start, uint32_t end)
+    {
+        return std::max((uint64_t) end, (uint64_t) start + 1);
+    }
+
+    inline uint32_t nextPowerOfTwo(uint32_t value)
+    {
+        uint32_t result = 1;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    // 每处理这么多个音符检查一次取消
+    constexpr size_t cancelCheckInterval = 1 << 20;
+
+    // 每个轨道的检查点布局，两遍构建之间共享
+    struct TrackLayout
+    {
+        uint32_t interval = 1;
+        uint64_t numCheckpoints = 0;
+        uint64_t numActive = 0;
+        uint64_t numLong = 0;
+    };
+}
+
+//==============================================================================
+void ControllerState::reset()
+{
+    std::fill(&controllers[0][0], &controllers[0][0] + 16 * 128, unset);
+    std::fill(programs, programs + 16, unset);
+    std::fill(channelPressure, channelPressure + 16, unset);
+    std::fill(pitchBend, pitchBend + 16, unset);
+}
+
+void ControllerState::apply(uint8_t status, uint8_t data1, uint8_t data2)
+{
+    const int channel = status & 0x0F;
+
+    switch (status & 0xF0)
+    {
+        case 0xB0: controllers[channel][data1 & 0x7F] = data2; break;
+        case 0xC0: programs[channel] = data1; break;
+        case 0xD0: channelPressure[channel] = data1; break;
+        case 0xE0: pitchBend[channel] = (int16_t) (data1 | (data2 << 7)); break;
+        default:   break;
+    }
+}
+
+//==============================================================================
+void SeekIndex::clear()
+{
+    visitArrays(*this, [](auto& array) { array.clear(); });
+}
+
+uint32_t SeekIndex::getControllerInterval(const MidiEventMerger& events)
+{
+    // 检查点数不超过 maxControllerCheckpoints
+    const size_t numEvents = events.getTotalEvents();
+    const uint32_t lastTick = numEvents > 0 ? events.getEvents()[numEvents - 1].tick : 0;
+    return lastTick / maxControllerCheckpoints + 1;
+}
+
+bool SeekIndex::build(const NoteTable& notes, const MidiEventMerger& events, Arena& arena, WorkStealingPool& pool,
+                      const std::atomic<bool>* cancelFlag)
+{
+    clear();
+
+    auto isCancelled = [cancelFlag] { return cancelFlag != nullptr && cancelFlag->load(std::memory_order_relaxed); };
+
+    const size_t numTracks = notes.getNumTracks();
+    const uint32_t* startTicks = notes.getStartTicks();
+    const uint32_t* endTicks = notes.getEndTicks();
+
+    // 第一遍：每个轨道的检查点间隔和各部分的大小
+    std::vector<TrackLayout> layouts(numTracks);
+
+    pool.parallelFor((int) numTracks, [&](int trackIndex, int)
+    {
+        const size_t begin = notes.getTrackNoteBegin((size_t) trackIndex);
+        const size_t end = notes.getTrackNoteEnd((size_t) trackIndex);
+        TrackLayout& layout = layouts[(size_t) trackIndex];
+
+        if (begin == end || isCancelled())
+            return;
+
+        const uint64_t lastStart = startTicks[end - 1];
+        const uint64_t interval = ((lastStart + 1) * notesPerCheckpoint + (end - begin) - 1) / (end - begin);
+        layout.interval = (uint32_t) std::min(std::max(interval, (uint64_t) 1), (uint64_t) 0xFFFFFFFFu);
+        layout.numCheckpoints = lastStart / layout.interval + 1;
+
+        const uint64_t longDuration = (uint64_t) longNoteIntervals * layout.interval;
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (((i - begin) & (cancelCheckInterval - 1)) == 0 && isCancelled())
+                return;
+
+            const uint64_t noteEnd = getEffectiveEnd(startTicks[i], endTicks[i]);
+
+            if (noteEnd - startTicks[i] > longDuration)
+            {
+                ++layout.numLong;
+                continue;
+            }
+
+            // 满足 start < k * interval < end 的检查点 k
+            const uint64_t first = startTicks[i] / layout.interval + 1;
+            const uint64_t last = std::min((noteEnd - 1) / layout.interval, layout.numCheckpoints - 1);
+
+            if (last >= first)
+                layout.numActive += last - first + 1;
+        }
+    });
+
+    if (isCancelled())
+        return false;
+
+    // 各轨道在平坦数组中的位置
+    trackIntervals.allocate(arena, numTracks);
+    trackCheckpoints.allocate(arena, numTracks + 1);
+    trackLongNotes.allocate(arena, numTracks + 1);
+    trackTrees.allocate(arena, numTracks + 1);
+    trackCheckpoints[0] = 0;
+    trackLongNotes[0] = 0;
+    trackTrees[0] = 0;
+    std::vector<uint64_t> activeOffsets(numTracks + 1, 0);
+
+    for (size_t track = 0; track < numTracks; ++track)
+    {
+        const TrackLayout& layout = layouts[track];
+        const uint64_t treeSize = layout.numLong > 0 ? 2 * (uint64_t) nextPowerOfTwo((uint32_t) layout.numLong) : 0;
+
+        trackIntervals[track] = layout.interval;
+        trackCheckpoints[track + 1] = trackCheckpoints[track] + layout.numCheckpoints;
+        trackLongNotes[track + 1] = trackLongNotes[track] + layout.numLong;
+        trackTrees[track + 1] = trackTrees[track] + treeSize;
+        activeOffsets[track + 1] = activeOffsets[track] + layout.numActive;
+    }
+
+    const size_t numCheckpoints = (size_t) trackCheckpoints[numTracks];
+    checkpointFirstNotes.allocate(arena, numCheckpoints);
+    checkpointActive.allocate(arena, numCheckpoints + 1);
+    checkpointActive[numCheckpoints] = activeOffsets[numTracks];
+    activeNotes.allocate(arena, (size_t) activeOffsets[numTracks]);
+    longNotes.allocate(arena, (size_t) trackLongNotes[numTracks]);
+    longNoteTrees.allocate(arena, (size_t) trackTrees[numTracks]);
+
+    // 控制器检查点只有一条事件流，作为最后一个任务和各轨道一起执行
+    const uint32_t controllerInterval = getControllerInterval(events);
+    const size_t numEvents = events.getTotalEvents();
+    const size_t numControllerCheckpoints = numEvents > 0 ? events.getEvents()[numEvents - 1].tick / controllerInterval + 1 : 0;
+    controllerEvents.allocate(arena, numControllerCheckpoints);
+    controllerSnapshots.allocate(arena, numControllerCheckpoints + 1);
+    std::vector<uint32_t> snapshotValues;
+
+    // 第二遍：填充
+    pool.parallelFor((int) numTracks + 1, [&](int taskIndex, int)
+    {
+        if (taskIndex == (int) numTracks)
+        {
+            const MergedMidiEvent* mergedEvents = events.getEvents();
+            ControllerState state;
+            size_t eventIndex = 0;
+
+            for (size_t checkpoint = 0; checkpoint < numControllerCheckpoints; ++checkpoint)
+            {
+                if (isCancelled())
+                    return;
+
+                const uint64_t tick = (uint64_t) checkpoint * controllerInterval;
+
+                for (; eventIndex < numEvents && mergedEvents[eventIndex].tick < tick; ++eventIndex)
+                    state.apply(mergedEvents[eventIndex].status, mergedEvents[eventIndex].data1, mergedEvents[eventIndex].data2);
+
+                controllerEvents[checkpoint] = eventIndex;
+                controllerSnapshots[checkpoint] = snapshotValues.size();
+
+                auto addValue = [&](uint32_t channel, uint32_t kind, int16_t value)
+                {
+                    if (value != ControllerState::unset)
+                        snapshotValues.push_back((channel << 24) | (kind << 16) | (uint32_t) value);
+                };
+
+                for (uint32_t channel = 0; channel < 16; ++channel)
+                {
+                    for (uint32_t controller = 0; controller < 128; ++controller)
+                        addValue(channel, controller, state.controllers[channel][controller]);
+
+                    addValue(channel, programKind, state.programs[channel]);
+                    addValue(channel, channelPressureKind, state.channelPressure[channel]);
+                    addValue(channel, pitchBendKind, state.pitchBend[channel]);
+                }
+            }
+
+            controllerSnapshots[numControllerCheckpoints] = snapshotValues.size();
+            return;
+        }
+
+        const size_t track = (size_t) taskIndex;
+        const TrackLayout& layout = layouts[track];
+
+        if (layout.numCheckpoints == 0 || isCancelled())
+            return;
+
+        const size_t begin = notes.getTrackNoteBegin(track);
+        const size_t end = notes.getTrackNoteEnd(track);
+        const uint32_t numNotes = (uint32_t) (end - begin);
+        const uint64_t interval = layout.interval;
+        const uint64_t longDuration = (uint64_t) longNoteIntervals * interval;
+        const size_t checkpointBase = (size_t) trackCheckpoints[track];
+
+        // 每个检查点第一个不早于它的音符
+        uint32_t note = 0;
+
+        for (uint64_t checkpoint = 0; checkpoint < layout.numCheckpoints; ++checkpoint)
+        {
+            if ((checkpoint & (cancelCheckInterval / notesPerCheckpoint - 1)) == 0 && isCancelled())
+                return;
+
+            while (note < numNotes && startTicks[begin + note] < checkpoint * interval)
+                ++note;
+
+            checkpointFirstNotes[checkpointBase + checkpoint] = note;
+        }
+
+        // 活动音符：先计数得到每个检查点的范围，再按音符顺序填入
+        std::vector<uint64_t> cursors(layout.numCheckpoints, 0);
+        std::vector<uint32_t> trackLongs;
+        trackLongs.reserve((size_t) layout.numLong);
+
+        for (uint32_t i = 0; i < numNotes; ++i)
+        {
+            if ((i & (cancelCheckInterval - 1)) == 0 && isCancelled())
+                return;
+
+            const uint32_t start = startTicks[begin + i];
+            const uint64_t noteEnd = getEffectiveEnd(start, endTicks[begin + i]);
+
+            if (noteEnd - start > longDuration)
+            {
+                trackLongs.push_back(i);
+                continue;
+            }
+
+            const uint64_t last = std::min((noteEnd - 1) / interval, layout.numCheckpoints - 1);
+            for (uint64_t checkpoint = start / interval + 1; checkpoint <= last; ++checkpoint)
+                ++cursors[checkpoint];
+        }
+
+        uint64_t offset = activeOffsets[track];
+
+        for (uint64_t checkpoint = 0; checkpoint < layout.numCheckpoints; ++checkpoint)
+        {
+            checkpointActive[checkpointBase + checkpoint] = offset;
+            const uint64_t count = cursors[checkpoint];
+            cursors[checkpoint] = offset;
+            offset += count;
+        }
+
+        for (uint32_t i = 0; i < numNotes; ++i)
+        {
+            if ((i & (cancelCheckInterval - 1)) == 0 && isCancelled())
+                return;
+
+            const uint32_t start = startTicks[begin + i];
+            const uint64_t noteEnd = getEffectiveEnd(start, endTicks[begin + i]);
+
+            if (noteEnd - start > longDuration)
+                continue;
+
+            const uint64_t last = std::min((noteEnd - 1) / interval, layout.numCheckpoints - 1);
+            for (uint64_t checkpoint = start / interval + 1; checkpoint <= last; ++checkpoint)
+                activeNotes[(size_t) cursors[checkpoint]++] = i;
+        }
+
+        // 长音符和它们的线段树（填充的叶子为0，永远不会被报告）
+        if (trackLongs.empty())
+            return;
+
+        const size_t longBase = (size_t) trackLongNotes[track];
+        std::copy(trackLongs.begin(), trackLongs.end(), &longNotes[longBase]);
+
+        const size_t treeBase = (size_t) trackTrees[track];
+        const size_t leaves = (size_t) (trackTrees[track + 1] - trackTrees[track]) / 2;
+
+        for (size_t i = 0; i < trackLongs.size(); ++i)
+        {
+            const size_t index = begin + trackLongs[i];
+            const uint64_t noteEnd = getEffectiveEnd(startTicks[index], endTicks[index]);
+            longNoteTrees[treeBase + leaves + i] = (uint32_t) std::min(noteEnd, (uint64_t) 0xFFFFFFFFu);
+        }
+
+        for (size_t i = trackLongs.size(); i < leaves; ++i)
+            longNoteTrees[treeBase + leaves + i] = 0;
+
+        for (size_t node = leaves; --node > 0;)
+            longNoteTrees[treeBase + node] = std::max(longNoteTrees[treeBase + 2 * node], longNoteTrees[treeBase + 2 * node + 1]);
+    });
+
+    if (isCancelled())
+        return false;
+
+    controllerValues.allocate(arena, snapshotValues.size());
+
+    for (size_t i = 0; i < snapshotValues.size(); ++i)
+        controllerValues[i] = snapshotValues[i];
+
+    return true;
+}
+
+//==============================================================================
+void SeekIndex::queryNotes(const NoteTable& notes, uint64_t startTick, uint64_t endTick, std::vector<size_t>& result) const
+{
+    if (endTick <= startTick || trackIntervals.size() != notes.getNumTracks())
+        return;
+
+    for (size_t track = 0; track < notes.getNumTracks(); ++track)
+        queryTrack(notes, track, startTick, endTick, result);
+}
+
+void SeekIndex::queryTrack(const NoteTable& notes, size_t track, uint64_t startTick, uint64_t endTick, std::vector<size_t>& result) const
+{
+    const uint64_t checkpointBegin = trackCheckpoints[track];
+    const uint64_t numCheckpoints = trackCheckpoints[track + 1] - checkpointBegin;
+
+    if (numCheckpoints == 0)
+        return;
+
+    const size_t begin = notes.getTrackNoteBegin(track);
+    const size_t numNotes = notes.getTrackNoteEnd(track) - begin;
+    const uint32_t* startTicks = notes.getStartTicks() + begin;
+    const uint32_t* endTicks = notes.getEndTicks() + begin;
+    const uint64_t interval = trackIntervals[track];
+    const uint64_t longDuration = (uint64_t) longNoteIntervals * interval;
+
+    // 短音符：不晚于 startTick 的最近检查点上仍在发声的音符，加上从检查点开始到 endTick 之前开始的音符
+    // 后者中在 startTick 之前已经结束的最多是一个间隔内的音符
+    const size_t checkpoint = (size_t) (checkpointBegin + std::min(startTick / interval, numCheckpoints - 1));
+
+    for (uint64_t i = checkpointActive[checkpoint]; i < checkpointActive[checkpoint + 1]; ++i)
+    {
+        const uint32_t note = activeNotes[(size_t) i];
+
+        if (getEffectiveEnd(startTicks[note], endTicks[note]) > startTick)
+            result.push_back(begin + note);
+    }
+
+    for (size_t note = checkpointFirstNotes[checkpoint]; note < numNotes && startTicks[note] < endTick; ++note)
+    {
+        const uint64_t noteEnd = getEffectiveEnd(startTicks[note], endTicks[note]);
+
+        if (noteEnd > startTick && noteEnd - startTicks[note] <= longDuration)
+            result.push_back(begin + note);
+    }
+
+    // 长音符：二分找到在 endTick 之前开始的前缀，再在线段树中只进入结束tick最大值超过 startTick 的子树
+    const size_t longBegin = (size_t) trackLongNotes[track];
+    const size_t numLong = (size_t) trackLongNotes[track + 1] - longBegin;
+
+    if (numLong == 0)
+        return;
+
+    const uint32_t* longs = longNotes.data() + longBegin;
+    const size_t limit = (size_t) (std::lower_bound(longs, longs + numLong, endTick,
+                                                    [startTicks](uint32_t note, uint64_t tick) { return startTicks[note] < tick; })
+                                   - longs);
+
+    const uint32_t* tree = longNoteTrees.data() + trackTrees[track];
+    const size_t leaves = (size_t) (trackTrees[track + 1] - trackTrees[track]) / 2;
+
+    // 显式栈代替递归，深度不超过树高
+    struct Node { size_t index, first, width; };
+    Node stack[64];
+    int depth = 0;
+    stack[depth++] = { 1, 0, leaves };
+
+    while (depth > 0)
+    {
+        const Node node = stack[--depth];
+
+        if (node.first >= limit || tree[node.index] <= startTick)
+            continue;
+
+        if (node.width == 1)
+        {
+            result.push_back(begin + longs[node.first]);
+            continue;
+        }
+
+        // 右子树先入栈，保证按起始tick顺序输出
+        const size_t half = node.width / 2;
+        stack[depth++] = { node.index * 2 + 1, node.first + half, half };
+        stack[depth++] = { node.index * 2, node.first, half };
+    }
+}
+
+size_t SeekIndex::seek(const MidiEventMerger& events, uint64_t tick, ControllerState& state) const
+{
+    state.reset();
+
+    const size_t numEvents = events.getTotalEvents();
+    const MergedMidiEvent* mergedEvents = events.getEvents();
+
+    if (controllerEvents.empty())
+        return 0;
+
+    // 最近检查点的快照
+    const uint64_t interval = getControllerInterval(events);
+    const size_t checkpoint = (size_t) std::min(tick / interval, (uint64_t) controllerEvents.size() - 1);
+
+    for (uint64_t i = controllerSnapshots[checkpoint]; i < controllerSnapshots[checkpoint + 1]; ++i)
+    {
+        const uint32_t value = controllerValues[(size_t) i];
+        const uint32_t channel = value >> 24;
+        const uint32_t kind = (value >> 16) & 0xFF;
+        const int16_t amount = (int16_t) (value & 0xFFFF);
+
+        if (kind < 128)                         state.controllers[channel][kind] = amount;
+        else if (kind == programKind)           state.programs[channel] = amount;
+        else if (kind == channelPressureKind)   state.channelPressure[channel] = amount;
+        else if (kind == pitchBendKind)         state.pitchBend[channel] = amount;
+    }
+
+    // 回放检查点之后、目标位置之前的事件
+    size_t eventIndex = (size_t) controllerEvents[checkpoint];
+
+    for (; eventIndex < numEvents && mergedEvents[eventIndex].tick < tick; ++eventIndex)
+        state.apply(mergedEvents[eventIndex].status, mergedEvents[eventIndex].data1, mergedEvents[eventIndex].data2);
+
+    return eventIndex;
+}
+
+//==============================================================================
+bool SeekIndex::isConsistent(const NoteTable& notes, const MidiEventMerger& events) const
+{
+    const size_t numTracks = notes.getNumTracks();
+
+    // 偏移数组：numItems + 1 项，从0开始单调不减，以 total 结束
+    auto isOffsetArray = [](const PodArray<uint64_t>& offsets, size_t numItems, uint64_t total)
+    {
+        if (offsets.size() != numItems + 1 || offsets[0] != 0 || offsets[numItems] != total)
+            return false;
+
+        for (size_t i = 0; i < numItems; ++i)
+            if (offsets[i + 1] < offsets[i])
+                return false;
+
+        return true;
+    };
+
+    if (trackIntervals.size() != numTracks
+        || !isOffsetArray(trackCheckpoints, numTracks, checkpointFirstNotes.size())
+        || !isOffsetArray(checkpointActive, checkpointFirstNotes.size(), activeNotes.size())
+        || !isOffsetArray(trackLongNotes, numTracks, longNotes.size())
+        || !isOffsetArray(trackTrees, numTracks, longNoteTrees.size()))
+        return false;
+
+    for (size_t track = 0; track < numTracks; ++track)
+    {
+        const size_t numNotes = notes.getTrackNoteEnd(track) - notes.getTrackNoteBegin(track);
+        const uint64_t numCheckpoints = trackCheckpoints[track + 1] - trackCheckpoints[track];
+        const uint64_t numLong = trackLongNotes[track + 1] - trackLongNotes[track];
+        const uint64_t treeSize = trackTrees[track + 1] - trackTrees[track];
+
+        if (trackIntervals[track] == 0 || numLong > numNotes
+            || (numNotes > 0) != (numCheckpoints > 0)
+            || treeSize != (numLong > 0 ? 2 * (uint64_t) nextPowerOfTwo((uint32_t) numLong) : 0))
+            return false;
+
+        if (numNotes > 0 && numCheckpoints != notes.getStartTicks()[notes.getTrackNoteEnd(track) - 1] / trackIntervals[track] + 1)
+            return false;
+    }
+
+    const size_t numEvents = events.getTotalEvents();
+    const size_t numControllerCheckpoints = numEvents > 0 ? events.getEvents()[numEvents - 1].tick / getControllerInterval(events) + 1 : 0;
+
+    if (controllerEvents.size() != numControllerCheckpoints
+        || !isOffsetArray(controllerSnapshots, numControllerCheckpoints, controllerValues.size()))
+        return false;
+
+    for (size_t i = 0; i < numControllerCheckpoints; ++i)
+        if (controllerEvents[i] > numEvents)
+            return false;
+
+    return true;
+}
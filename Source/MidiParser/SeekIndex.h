@@ -0,0 +1,119 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_SEEKINDEX_H
+#define CANDYJAR_SEEKINDEX_H
+
+#include "NoteTable.h"
+#include "MidiEventMerger.h"
+#include "../Utils/WorkStealingPool.h"
+#include "../Utils/PodArray.h"
+
+// 某一时刻各通道的控制器状态，没有设置过的值为 unset
+struct ControllerState
+{
+    static constexpr int16_t unset = -1;
+
+    int16_t controllers[16][128];
+    int16_t programs[16];
+    int16_t channelPressure[16];
+    int16_t pitchBend[16];      // 14位值，8192 为中间位置
+
+    ControllerState() { reset(); }
+
+    void reset();
+
+    // 应用一条通道消息，音符消息和 Poly Aftertouch 被忽略
+    void apply(uint8_t status, uint8_t data1, uint8_t data2);
+};
+
+// 按时间定位的索引，加载时从音符表和合并事件流一次性建好，之后查询只读
+//  - 每个轨道每隔 N tick 一个检查点，记录该处第一个音符的位置和正在发声的音符
+//    （N 按轨道的音符密度选取，平均每个间隔约 notesPerCheckpoint 个音符）
+//  - 跨越多个间隔的长音符不放进检查点，而是放在每个轨道的一棵按结束tick取最大值的线段树中，
+//    这样检查点里的活动音符数有上限，总内存和音符数成正比
+//  - 合并事件流上每隔固定tick一个检查点，记录事件位置和此前的控制器状态（稀疏保存）
+// 所有数据都在平坦的 PodArray 中，可以整体写入缓存并直接从映射中恢复（见 visitArrays）
+class SeekIndex
+{
+public:
+    // 每个检查点间隔内平均的音符数
+    static constexpr uint32_t notesPerCheckpoint = 64;
+    // 持续时间超过这么多个检查点间隔的音符算作长音符
+    static constexpr uint32_t longNoteIntervals = 4;
+    // 事件流上控制器检查点的最大数量
+    static constexpr uint32_t maxControllerCheckpoints = 4096;
+
+    // 从音符表和已经合并完的事件流建立索引，各轨道在线程池中并行处理（events 必须已经 isFinished()）
+    // 各数组在 arena 中分配；cancelFlag 置位时尽快返回 false，此时索引的内容无效
+    bool build(const NoteTable& notes, const MidiEventMerger& events, Arena& arena, WorkStealingPool& pool,
+               const std::atomic<bool>* cancelFlag = nullptr);
+
+    void clear();
+
+    bool empty() const { return trackIntervals.empty() && controllerEvents.empty(); }
+
+    // 把与 [startTick, endTick) 重叠的音符在音符表中的下标追加到 result（长度为0的音符按1 tick算）
+    // 结果按轨道分组，组内不保证顺序。复杂度 O(轨道数 * log n + k)
+    void queryNotes(const NoteTable& notes, uint64_t startTick, uint64_t endTick, std::vector<size_t>& result) const;
+
+    // 返回合并事件流中第一个 tick >= tick 的事件下标，并把 state 设为该位置之前的控制器状态
+    // 只需要从最近的检查点回放不到一个间隔的事件
+    size_t seek(const MidiEventMerger& events, uint64_t tick, ControllerState& state) const;
+
+    // 所有数组的数量和访问方式，缓存按这个顺序逐个保存
+    static constexpr int numArrays = 12;
+
+    // index 为 SeekIndex 或 const SeekIndex，依次对每个数组调用 visitor(array)
+    template <typename Index, typename Visitor>
+    static void visitArrays(Index& index, Visitor&& visitor)
+    {
+        visitor(index.trackIntervals);
+        visitor(index.trackCheckpoints);
+        visitor(index.checkpointFirstNotes);
+        visitor(index.checkpointActive);
+        visitor(index.activeNotes);
+        visitor(index.trackLongNotes);
+        visitor(index.longNotes);
+        visitor(index.trackTrees);
+        visitor(index.longNoteTrees);
+        visitor(index.controllerEvents);
+        visitor(index.controllerSnapshots);
+        visitor(index.controllerValues);
+    }
+
+    // 从外部内存恢复各数组后检查它们之间的一致性（数组长度和各级偏移），不一致时不能使用
+    bool isConsistent(const NoteTable& notes, const MidiEventMerger& events) const;
+
+private:
+    // 每个轨道的检查点间隔（tick）
+    PodArray<uint32_t> trackIntervals;
+    // 轨道 t 的检查点为 [trackCheckpoints[t], trackCheckpoints[t + 1])，共 numTracks + 1 项
+    PodArray<uint64_t> trackCheckpoints;
+    // 检查点处第一个 start >= 检查点tick 的音符（相对轨道起点的下标）
+    PodArray<uint32_t> checkpointFirstNotes;
+    // 检查点 c 的活动音符为 activeNotes[checkpointActive[c], checkpointActive[c + 1])，共 numCheckpoints + 1 项
+    PodArray<uint64_t> checkpointActive;
+    // 在检查点之前开始、检查点处仍在发声的短音符（相对下标，按起始tick排序）
+    PodArray<uint32_t> activeNotes;
+    // 轨道 t 的长音符为 longNotes[trackLongNotes[t], trackLongNotes[t + 1])
+    PodArray<uint64_t> trackLongNotes;
+    // 长音符（相对下标，按起始tick排序）
+    PodArray<uint32_t> longNotes;
+    // 轨道 t 的线段树为 longNoteTrees[trackTrees[t], trackTrees[t + 1])，大小为长音符数向上取2的幂的两倍
+    PodArray<uint64_t> trackTrees;
+    // 线段树节点保存子树中长音符结束tick的最大值，叶子依次对应长音符
+    PodArray<uint32_t> longNoteTrees;
+    // 控制器检查点 c 位于 tick = c * controllerInterval，对应第一个 tick >= 该值的事件
+    PodArray<uint64_t> controllerEvents;
+    // 控制器检查点 c 的状态为 controllerValues[controllerSnapshots[c], controllerSnapshots[c + 1])，共 numCheckpoints + 1 项
+    PodArray<uint64_t> controllerSnapshots;
+    // 稀疏的控制器值，每项为 (通道 << 24) | (种类 << 16) | 值，种类 0-127 为CC号，其余见 SeekIndex.cpp
+    PodArray<uint32_t> controllerValues;
+
+    static uint32_t getControllerInterval(const MidiEventMerger& events);
+    void queryTrack(const NoteTable& notes, size_t track, uint64_t startTick, uint64_t endTick, std::vector<size_t>& result) const;
+};
+
+#endif //CANDYJAR_SEEKINDEX_H
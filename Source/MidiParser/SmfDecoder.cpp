@@ -0,0 +1,725 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "SmfDecoder.h"
+#include <array>
+#include <cstring>
+#include <memory>
+
+#if defined (__x86_64__) || defined (_M_X64)
+ #define CANDYJAR_DECODER_SSE2 1
+ #include <emmintrin.h>
+#else
+ #define CANDYJAR_DECODER_SSE2 0
+#endif
+
+// 只在少数事件上执行的代码不内联，留在热循环之外
+#if defined (_MSC_VER)
+ #define CANDYJAR_COLD __declspec(noinline)
+#else
+ #define CANDYJAR_COLD __attribute__((noinline, cold))
+#endif
+
+namespace
+{
+    // 编译期生成的状态字节分类表，热循环中每个事件只查一次（running status 时两次）
+    constexpr std::array<SmfEventKind, 256> makeStatusKinds()
+    {
+        std::array<SmfEventKind, 256> kinds {};
+
+        for (int status = 0; status < 256; ++status)
+        {
+            SmfEventKind kind = SmfEventKind::invalid;
+
+            if (status < 0x80)
+                kind = SmfEventKind::runningStatus;
+            else if (status < 0x90)
+                kind = SmfEventKind::noteOff;
+            else if (status < 0xA0)
+                kind = SmfEventKind::noteOn;
+            else if (status >= 0xB0 && status < 0xC0)
+                kind = SmfEventKind::controlChange;
+            else if (status >= 0xC0 && status < 0xE0)
+                kind = SmfEventKind::oneDataByte;
+            else if (status < 0xF0)
+                kind = SmfEventKind::twoDataBytes;
+            else if (status == 0xF0 || status == 0xF7)
+                kind = SmfEventKind::sysex;
+            else if (status == 0xFF)
+                kind = SmfEventKind::meta;
+
+            kinds[(size_t) status] = kind;
+        }
+
+        return kinds;
+    }
+
+    constexpr std::array<SmfEventKind, 256> statusKinds = makeStatusKinds();
+
+    static_assert(statusKinds[0x00] == SmfEventKind::runningStatus && statusKinds[0x7F] == SmfEventKind::runningStatus, "Data bytes");
+    static_assert(statusKinds[0x80] == SmfEventKind::noteOff && statusKinds[0x9F] == SmfEventKind::noteOn, "Notes");
+    static_assert(statusKinds[0xA0] == SmfEventKind::twoDataBytes && statusKinds[0xE5] == SmfEventKind::twoDataBytes, "Aftertouch / Pitch Bend");
+    static_assert(statusKinds[0xB3] == SmfEventKind::controlChange, "Control Change");
+    static_assert(statusKinds[0xC0] == SmfEventKind::oneDataByte && statusKinds[0xDF] == SmfEventKind::oneDataByte, "Program Change / Channel Pressure");
+    static_assert(statusKinds[0xF0] == SmfEventKind::sysex && statusKinds[0xF7] == SmfEventKind::sysex, "SysEx");
+    static_assert(statusKinds[0xFF] == SmfEventKind::meta && statusKinds[0xF1] == SmfEventKind::invalid, "System messages");
+
+    // 一个通道消息（状态字节已经读过或来自 running status），数据字节不够时返回 false
+    // 每种消息类型一个实例：数据字节数是常量，统计计数在写入事件时顺便累加，Note On 的计数不分支
+    template <SmfEventKind kind>
+    inline bool decodeChannelEvent(const uint8_t*& pos, const uint8_t* end, uint8_t statusByte, uint32_t delta, MidiTrackEvents& track)
+    {
+        static_assert(kind < SmfEventKind::runningStatus, "Channel messages only");
+        constexpr int numDataBytes = kind == SmfEventKind::oneDataByte ? 1 : 2;
+
+        if (end - pos < numDataBytes)
+            return false;
+
+        const uint8_t d1 = pos[0] & 0x7F;
+        const uint8_t d2 = numDataBytes == 2 ? (pos[1] & 0x7F) : 0;
+        pos += numDataBytes;
+
+        track.deltaTicks.push_back(delta);
+        track.status.push_back(statusByte);
+        track.data1.push_back(d1);
+        track.data2.push_back(d2);
+
+        // 音符和控制器的类型下标是常量，其余两类各有两种状态字节
+        if constexpr (kind == SmfEventKind::noteOff)
+            ++track.counts.eventTypes[0];
+        else if constexpr (kind == SmfEventKind::noteOn)
+            ++track.counts.eventTypes[1];
+        else if constexpr (kind == SmfEventKind::controlChange)
+            ++track.counts.eventTypes[3];
+        else
+            ++track.counts.eventTypes[(statusByte >> 4) & 7];
+
+        if constexpr (kind == SmfEventKind::noteOn)
+            track.counts.channelNotes[statusByte & 0x0F] += d2 != 0 ? 1u : 0u;
+
+        return true;
+    }
+
+    // 过滤模式下判断一个通道消息（数据字节已确认足够）是否保留
+    // 力度过滤时 Note On / Note Off 都要经过配对栈，即使它们本身已经被类型或通道过滤掉
+    inline bool keepsChannelEvent(const SmfEventFilter& filter, SmfNoteStacks* noteStacks, uint8_t statusByte, const uint8_t* data)
+    {
+        bool keep = filter.keepStatus[statusByte];
+        const uint8_t type = statusByte & 0xF0;
+
+        if (filter.minVelocity > 0 && (type == 0x80 || type == 0x90))
+        {
+            const size_t stack = (size_t) (statusByte & 0x0F) * 128 + (data[0] & 0x7F);
+            const uint8_t velocity = data[1] & 0x7F;
+
+            if (isNoteOnEvent(statusByte, velocity))
+            {
+                const bool kept = velocity >= filter.minVelocity;
+                noteStacks->push(stack, kept);
+                keep = keep && kept;
+            }
+            else if (!noteStacks->empty(stack))
+            {
+                keep = noteStacks->pop(stack) && keep;
+            }
+        }
+
+        return keep;
+    }
+
+    enum class MetaResult
+    {
+        decoded,
+        skipped,
+        endOfTrack,
+        truncatedType,
+        truncatedPayload
+    };
+
+    // Meta / SysEx 事件（状态字节已经读过）：负载不复制，只记录在文件中的位置
+    // filter 不为空且不保留这个事件时只跳过负载（End of Track 仍然结束轨道）；保留时 pendingDelta 并入 delta
+    CANDYJAR_COLD MetaResult decodeMetaEvent(const uint8_t* fileBase, const uint8_t*& pos, const uint8_t* end,
+                                             uint8_t statusByte, uint32_t delta, uint32_t& pendingDelta, uint64_t tick,
+                                             MidiTrackEvents& track, const SmfEventFilter* filter)
+    {
+        uint8_t metaType = 0;
+
+        if (statusByte == 0xFF)
+        {
+            if (pos >= end)
+                return MetaResult::truncatedType;
+
+            metaType = *pos++;
+        }
+
+        uint32_t length = 0;
+        if (!SmfDecoder::readVariableLength(pos, end, length) || (size_t) (end - pos) < length)
+            return MetaResult::truncatedPayload;
+
+        const bool isEndOfTrack = statusByte == 0xFF && metaType == 0x2F;
+
+        if (filter != nullptr && !(statusByte == 0xFF ? filter->keepsMeta(metaType) : filter->keepStatus[statusByte]))
+        {
+            pos += length;
+            return isEndOfTrack ? MetaResult::endOfTrack : MetaResult::skipped;
+        }
+
+        delta += pendingDelta;
+        pendingDelta = 0;
+
+        MetaEventRef meta;
+        meta.tick = tick;
+        meta.eventIndex = (uint32_t) track.size();
+        meta.length = length;
+        meta.dataOffset = (uint64_t) (pos - fileBase);
+        meta.type = metaType;
+        track.metaEvents.push_back(meta);
+        pos += length;
+
+        track.deltaTicks.push_back(delta);
+        track.status.push_back(statusByte);
+        track.data1.push_back(metaType);
+        track.data2.push_back(0);
+        ++track.counts.eventTypes[7];
+
+        return isEndOfTrack ? MetaResult::endOfTrack : MetaResult::decoded;
+    }
+}
+
+const char* SmfAnomaly::getTypeName(Type type)
+{
+    switch (type)
+    {
+        case Type::badChunkLength:    return "Bad chunk length";
+        case Type::truncatedChunk:    return "Truncated chunk";
+        case Type::garbageSkipped:    return "Garbage skipped";
+        case Type::trailingGarbage:   return "Trailing garbage";
+        case Type::truncatedEvent:    return "Truncated event";
+        case Type::invalidEvent:      return "Invalid event";
+        case Type::missingEndOfTrack: return "Missing End of Track";
+        case Type::unmatchedNotes:    return "Unmatched notes";
+    }
+
+    return "Unknown";
+}
+
+juce::String SmfAnomaly::toString() const
+{
+    juce::String text;
+    text << getTypeName(type) << " at 0x" << juce::String::toHexString(offset);
+
+    if (track >= 0)
+        text << " (track " << (track + 1) << ")";
+
+    if (detail.isNotEmpty())
+        text << ": " << detail;
+
+    return text;
+}
+
+bool SmfDecoder::readHeader(const uint8_t* data, size_t size, SmfHeader& header, juce::String& error)
+{
+    if (size < (size_t) headerChunkSize)
+    {
+        error = "File is too small to be a MIDI file";
+        return false;
+    }
+
+    uint32_t headerLength = 0;
+    if (!readChunkHeader(data, "MThd", headerLength))
+    {
+        error = "Missing MThd header";
+        return false;
+    }
+
+    if (headerLength < 6)
+    {
+        error = "Invalid MThd length: " + juce::String((int) headerLength);
+        return false;
+    }
+
+    header.format = readBigEndian16(data + 8);
+    header.numTracks = readBigEndian16(data + 10);
+    header.timeFormat = (short) readBigEndian16(data + 12);
+    header.headerLength = headerLength;
+
+    if (header.format > 2)
+    {
+        error = "Unsupported MIDI file type: " + juce::String(header.format);
+        return false;
+    }
+
+    return true;
+}
+
+bool SmfDecoder::readChunkHeader(const uint8_t* data, const char* chunkId, uint32_t& chunkLength)
+{
+    chunkLength = readBigEndian32(data + 4);
+    return std::memcmp(data, chunkId, 4) == 0;
+}
+
+bool SmfDecoder::isChunkBoundary(const uint8_t* fileBase, size_t fileSize, size_t position)
+{
+    if (position == fileSize)
+        return true;
+
+    if (position > fileSize || fileSize - position < (size_t) chunkHeaderSize)
+        return false;
+
+    const uint8_t* chunk = fileBase + position;
+
+    if (std::memcmp(chunk, "MTrk", 4) == 0)
+        return true;
+
+    // 其他块ID必须是4个可打印字符，并且按长度跳过后正好是文件末尾或 MTrk
+    for (int i = 0; i < 4; ++i)
+        if (chunk[i] < 0x20 || chunk[i] > 0x7E)
+            return false;
+
+    const size_t next = position + (size_t) chunkHeaderSize + readBigEndian32(chunk + 4);
+
+    return next == fileSize
+        || (next < fileSize && fileSize - next >= (size_t) chunkHeaderSize && std::memcmp(fileBase + next, "MTrk", 4) == 0);
+}
+
+size_t SmfDecoder::findTrackChunk(const uint8_t* fileBase, size_t fileSize, size_t position)
+{
+    if (position >= fileSize || fileSize - position < 4)
+        return fileSize;
+
+    // 只在还能放下块头的范围内查找
+    const size_t last = fileSize - 4;
+    size_t i = position;
+
+   #if CANDYJAR_DECODER_SSE2
+    // 同时比较16个候选位置的首字节 'M' 和第4个字节 'k'，两者都相同的位置再逐个确认
+    const __m128i first = _mm_set1_epi8('M');
+    const __m128i fourth = _mm_set1_epi8('k');
+
+    for (; i + 16 + 3 <= fileSize; i += 16)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(fileBase + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(fileBase + i + 3));
+        unsigned mask = (unsigned) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, fourth)));
+
+        for (size_t bit = 0; mask != 0; ++bit, mask >>= 1)
+            if ((mask & 1) != 0 && fileBase[i + bit + 1] == 'T' && fileBase[i + bit + 2] == 'r')
+                return i + bit;
+    }
+   #endif
+
+    for (; i <= last; ++i)
+    {
+        const void* found = std::memchr(fileBase + i, 'M', last - i + 1);
+
+        if (found == nullptr)
+            break;
+
+        i = (size_t) (static_cast<const uint8_t*>(found) - fileBase);
+
+        if (std::memcmp(fileBase + i, "MTrk", 4) == 0)
+            return i;
+    }
+
+    return fileSize;
+}
+
+void SmfNoteStacks::reset(Arena& newArena)
+{
+    arena = &newArena;
+    depth.fill(0);
+
+    // 溢出数组可能在已经重置的 arena 中，只忘记不访问
+    for (uint16_t stack : spilledStacks)
+        spill[stack].clear();
+
+    spilledStacks.clear();
+}
+
+uint64_t& SmfNoteStacks::getSpillWord(size_t stack, uint32_t level)
+{
+    ArenaArray<uint64_t>& words = spill[stack];
+    const size_t index = (level - 64) / 64;
+
+    if (words.capacity() == 0)
+    {
+        words.reserve(*arena, 4);
+        spilledStacks.push_back((uint16_t) stack);
+    }
+
+    while (words.size() <= index)
+        words.push_back(0);
+
+    return words[index];
+}
+
+size_t SmfDecoder::closeUnmatchedNotes(MidiTrackEvents& track, Arena& arena)
+{
+    // 每个 (通道, 音高) 未结束的音符数，和 NoteTable 一样：没有打开音符时的 Note Off 被忽略
+    std::vector<uint32_t> openNotes(16 * 128, 0);
+    size_t numOpen = 0;
+    uint64_t tick = 0;
+
+    for (size_t i = 0; i < track.size(); ++i)
+    {
+        tick += track.deltaTicks[i];
+        const uint8_t statusByte = track.status[i];
+        const uint8_t type = statusByte & 0xF0;
+
+        if (type != 0x80 && type != 0x90)
+            continue;
+
+        uint32_t& open = openNotes[(size_t) (statusByte & 0x0F) * 128 + track.data1[i]];
+
+        if (isNoteOnEvent(statusByte, track.data2[i]))
+        {
+            ++open;
+            ++numOpen;
+        }
+        else if (open > 0)
+        {
+            --open;
+            --numOpen;
+        }
+    }
+
+    if (numOpen == 0)
+        return 0;
+
+    // 解码时的预留是按估算的事件数留的，补上的事件一次预留，不让数组翻倍
+    track.reserve(arena, track.size() + numOpen, track.metaEvents.size());
+
+    // 补上的 Note Off 放在轨道结束的位置（截断的事件之前的delta也算在轨道长度内）
+    uint32_t delta = (uint32_t) std::min<uint64_t>(track.totalTicks - tick, 0xFFFFFFFFu);
+    size_t numAdded = 0;
+
+    for (size_t stack = 0; stack < openNotes.size(); ++stack)
+    {
+        for (uint32_t n = 0; n < openNotes[stack]; ++n)
+        {
+            track.deltaTicks.push_back(delta);
+            track.status.push_back((uint8_t) (0x80 | (stack / 128)));
+            track.data1.push_back((uint8_t) (stack % 128));
+            track.data2.push_back(0);
+            ++track.counts.eventTypes[0];
+            ++numAdded;
+            delta = 0;
+        }
+    }
+
+    return numAdded;
+}
+
+namespace
+{
+    // 解码循环，过滤和不过滤各一个实例，不过滤时丢弃事件的代码在编译期去掉
+    template <bool filtered>
+    bool decodeTrackEvents(const uint8_t* fileBase, const uint8_t* data, size_t size, MidiTrackEvents& track, Arena& arena,
+                           juce::String& error, LoadProgress* progress, const std::atomic<bool>* cancelFlag,
+                           std::vector<SmfAnomaly>* anomalies, const SmfEventFilter* filter, SmfNoteStacks* noteStacks)
+    {
+        track.metaBase = fileBase;
+
+        const uint8_t* pos = data;
+        const uint8_t* const end = data + size;
+
+        // 预留分两步，避免按上限预留的内存长期占在 arena 中（reset() 保留已用过的块，Windows 上预留即计入提交量）：
+        //  - 先按每个事件3字节预留，但最多 reserveSampleEvents 个，小轨道一次预留就够
+        //  - 解码到这么多事件后按已解码部分的字节/事件比例估算剩余事件数，多留十六分之一重新预留一次
+        //    估算不足时由 ArenaArray 翻倍扩容（旧数组留在 arena 中直到重置）
+        // 过滤时按保留下来的事件计算比例，丢弃的事件越多预留越少
+        constexpr size_t reserveSampleEvents = 4096;
+        const size_t firstEvent = track.size();
+        track.reserve(arena, firstEvent + std::min(size / 3 + 1, reserveSampleEvents), track.metaEvents.size() + 16);
+        size_t reestimateAt = size / 3 + 1 > reserveSampleEvents ? firstEvent + reserveSampleEvents : SIZE_MAX;
+
+        uint64_t tick = track.totalTicks;
+        uint8_t runningStatus = 0;
+
+        // 上次发布进度时的位置
+        const uint8_t* publishedPos = data;
+        size_t publishedEvents = track.size();
+        size_t publishedMetaEvents = track.metaEvents.size();
+        uint64_t publishedNotes = track.counts.getTotalNotes();
+
+        auto publishProgress = [&]
+        {
+            const uint64_t notes = track.counts.getTotalNotes();
+
+            progress->bytesConsumed.fetch_add((int64_t) (pos - publishedPos), std::memory_order_relaxed);
+            progress->eventsDecoded.fetch_add((int64_t) (track.size() - publishedEvents), std::memory_order_relaxed);
+            progress->live.addEvents((int64_t) (track.size() - publishedEvents), (int64_t) (notes - publishedNotes), tick, track.metaBase,
+                                     track.metaEvents.data() + publishedMetaEvents, track.metaEvents.size() - publishedMetaEvents);
+            publishedPos = pos;
+            publishedEvents = track.size();
+            publishedMetaEvents = track.metaEvents.size();
+            publishedNotes = notes;
+        };
+
+        // 每 publishInterval 个事件发布一次进度并检查取消，返回 false 表示已取消
+        auto publishAndPoll = [&]
+        {
+            if (progress != nullptr)
+                publishProgress();
+
+            if (cancelFlag != nullptr && cancelFlag->load(std::memory_order_relaxed))
+            {
+                error = "Cancelled";
+                return false;
+            }
+
+            return true;
+        };
+
+        // 按已解码部分的比例估算剩余的事件数，重新预留
+        auto reserveRemaining = [&]
+        {
+            const double bytesPerEvent = (double) (pos - data) / (double) (track.size() - firstEvent);
+            const size_t estimate = (size_t) ((double) (end - pos) / bytesPerEvent);
+            track.reserve(arena, track.size() + estimate + estimate / 16 + 16, track.metaEvents.size());
+            reestimateAt = SIZE_MAX;
+        };
+
+        auto checkpoint = [&]
+        {
+            if (track.size() >= reestimateAt)
+                reserveRemaining();
+
+            return (track.size() & (LoadProgress::publishInterval - 1)) != 0 || publishAndPoll();
+        };
+
+        // 过滤模式：被丢弃事件的 delta 累加在这里，写入下一个保留的事件
+        // 累加值接近 uint32 上限时不再丢弃（下一个事件照常保留），保证加上一个 delta（最多28位）之后不溢出
+        constexpr uint32_t maxPendingDelta = 0xF0000000u;
+        uint32_t pendingDelta = 0;
+        size_t numSkipped = 0;
+
+        // 力度过滤时每个 (通道, 音高) 一个栈，记录未结束的 Note On 是否被丢弃，配对规则与 NoteTable 相同
+        if (filtered && filter->minVelocity > 0)
+            noteStacks->reset(arena);
+
+        auto canSkip = [&](uint32_t delta)
+        {
+            return (uint64_t) pendingDelta + delta <= maxPendingDelta;
+        };
+
+        // 丢弃一个事件，返回 false 表示已取消
+        auto skip = [&](uint32_t delta)
+        {
+            pendingDelta += delta;
+            return (++numSkipped & (LoadProgress::publishInterval - 1)) != 0 || publishAndPoll();
+        };
+
+        bool recovered = false;
+
+        // 解码错误：严格模式下返回 false；恢复模式下记录问题并返回 true，调用处随即结束这个轨道
+        auto recover = [&](SmfAnomaly::Type type, const uint8_t* eventStart, const char* message)
+        {
+            if (anomalies == nullptr)
+            {
+                error = message;
+                return false;
+            }
+
+            SmfAnomaly anomaly;
+            anomaly.type = type;
+            anomaly.offset = (juce::int64) (eventStart - fileBase);
+            anomaly.detail = juce::String(message) + ", " + juce::String((juce::int64) (end - eventStart)) + " bytes dropped";
+            anomalies->push_back(anomaly);
+            recovered = true;
+            return true;
+        };
+
+        bool endOfTrack = false;
+
+        while (pos < end)
+        {
+            const uint8_t* const eventStart = pos;
+
+            // 绝大多数 delta 只有一个字节
+            uint32_t delta = *pos;
+
+            if (delta < 0x80)
+            {
+                ++pos;
+            }
+            else if (!SmfDecoder::readVariableLength(pos, end, delta))
+            {
+                if (!recover(SmfAnomaly::Type::truncatedEvent, eventStart, "Truncated delta time"))
+                    return false;
+
+                break;
+            }
+
+            tick += delta;
+
+            if (pos >= end)
+            {
+                if (!recover(SmfAnomaly::Type::truncatedEvent, eventStart, "Truncated event"))
+                    return false;
+
+                break;
+            }
+
+            uint8_t statusByte = *pos;
+            SmfEventKind kind = statusKinds[statusByte];
+
+            if (kind == SmfEventKind::runningStatus)
+            {
+                if (runningStatus == 0)
+                {
+                    if (!recover(SmfAnomaly::Type::invalidEvent, eventStart, "Data byte without running status"))
+                        return false;
+
+                    break;
+                }
+
+                statusByte = runningStatus;
+                kind = statusKinds[statusByte];
+            }
+            else
+            {
+                ++pos;
+            }
+
+            if (kind < SmfEventKind::runningStatus)
+            {
+                // 通道消息：每种类型一个特化的处理函数，数据字节数在编译期确定
+                runningStatus = statusByte;
+                bool decoded = false;
+
+                if constexpr (filtered)
+                {
+                    const int numDataBytes = kind == SmfEventKind::oneDataByte ? 1 : 2;
+
+                    if (end - pos >= numDataBytes)
+                    {
+                        if (!keepsChannelEvent(*filter, noteStacks, statusByte, pos) && canSkip(delta))
+                        {
+                            pos += numDataBytes;
+
+                            if (!skip(delta))
+                                return false;
+
+                            continue;
+                        }
+
+                        delta += pendingDelta;
+                        pendingDelta = 0;
+                    }
+                }
+
+                switch (kind)
+                {
+                    case SmfEventKind::noteOn:        decoded = decodeChannelEvent<SmfEventKind::noteOn> (pos, end, statusByte, delta, track); break;
+                    case SmfEventKind::noteOff:       decoded = decodeChannelEvent<SmfEventKind::noteOff> (pos, end, statusByte, delta, track); break;
+                    case SmfEventKind::controlChange: decoded = decodeChannelEvent<SmfEventKind::controlChange> (pos, end, statusByte, delta, track); break;
+                    case SmfEventKind::twoDataBytes:  decoded = decodeChannelEvent<SmfEventKind::twoDataBytes> (pos, end, statusByte, delta, track); break;
+                    default:                          decoded = decodeChannelEvent<SmfEventKind::oneDataByte> (pos, end, statusByte, delta, track); break;
+                }
+
+                if (!decoded)
+                {
+                    if (!recover(SmfAnomaly::Type::truncatedEvent, eventStart, "Truncated channel message"))
+                        return false;
+
+                    break;
+                }
+
+                if (!checkpoint())
+                    return false;
+
+                continue;
+            }
+
+            if (kind == SmfEventKind::invalid)
+            {
+                if (anomalies == nullptr)
+                {
+                    error = "Unexpected status byte: " + juce::String((int) statusByte);
+                    return false;
+                }
+
+                recover(SmfAnomaly::Type::invalidEvent, eventStart, "Unexpected status byte");
+                break;
+            }
+
+            // Meta / SysEx 事件在冷路径上解码，只记录负载在文件中的位置
+            const MetaResult result = decodeMetaEvent(fileBase, pos, end, statusByte, delta, pendingDelta, tick, track,
+                                                      filtered && canSkip(delta) ? filter : nullptr);
+
+            if (result == MetaResult::skipped)
+            {
+                if (!skip(delta))
+                    return false;
+
+                continue;
+            }
+
+            if (result == MetaResult::truncatedType)
+            {
+                if (!recover(SmfAnomaly::Type::truncatedEvent, eventStart, "Truncated meta event"))
+                    return false;
+
+                break;
+            }
+
+            if (result == MetaResult::truncatedPayload)
+            {
+                if (!recover(SmfAnomaly::Type::truncatedEvent, eventStart, "Truncated meta/sysex event"))
+                    return false;
+
+                break;
+            }
+
+            if (result == MetaResult::endOfTrack)
+            {
+                endOfTrack = true;
+                break;
+            }
+
+            if (!checkpoint())
+                return false;
+        }
+
+        track.totalTicks = tick;
+
+        // 因为解码错误提前结束的轨道已经记录过了
+        if (anomalies != nullptr && !endOfTrack && !recovered)
+        {
+            SmfAnomaly anomaly;
+            anomaly.type = SmfAnomaly::Type::missingEndOfTrack;
+            anomaly.offset = (juce::int64) (end - fileBase);
+            anomalies->push_back(anomaly);
+        }
+
+        // 提前遇到 End of Track 时剩余的字节也算作已处理
+        if (progress != nullptr)
+        {
+            pos = end;
+            publishProgress();
+        }
+
+        return true;
+    }
+}
+
+bool SmfDecoder::decodeTrack(const uint8_t* fileBase, const uint8_t* data, size_t size, MidiTrackEvents& track, Arena& arena,
+                             juce::String& error, LoadProgress* progress, const std::atomic<bool>* cancelFlag,
+                             std::vector<SmfAnomaly>* anomalies, const SmfEventFilter* filter, SmfNoteStacks* noteStacks)
+{
+    if (filter == nullptr)
+        return decodeTrackEvents<false> (fileBase, data, size, track, arena, error, progress, cancelFlag, anomalies, nullptr, nullptr);
+
+    // 调用方没有提供配对栈时只为这一个轨道分配
+    std::unique_ptr<SmfNoteStacks> localStacks;
+
+    if (filter->minVelocity > 0 && noteStacks == nullptr)
+    {
+        localStacks = std::make_unique<SmfNoteStacks>();
+        noteStacks = localStacks.get();
+    }
+
+    return decodeTrackEvents<true> (fileBase, data, size, track, arena, error, progress, cancelFlag, anomalies, filter, noteStacks);
+}
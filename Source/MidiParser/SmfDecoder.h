@@ -0,0 +1,189 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_SMFDECODER_H
+#define CANDYJAR_SMFDECODER_H
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "MidiTrackEvents.h"
+#include "LoadProgress.h"
+#include <array>
+
+// MThd 头信息
+struct SmfHeader
+{
+    int format = 0;
+    int numTracks = 0;
+    short timeFormat = 0;  // 正数为每四分音符tick数，负数为SMPTE格式
+    uint32_t headerLength = 0;
+};
+
+// MTrk块在文件中的位置（由第一遍只读块头的扫描得到）
+struct TrackChunkInfo
+{
+    juce::int64 offset = 0;   // 块内容的起始偏移（不含8字节块头）
+    uint32_t length = 0;      // 块内容长度（已按文件实际大小截断）
+};
+
+// 恢复模式下发现并修复的文件问题
+struct SmfAnomaly
+{
+    enum class Type
+    {
+        badChunkLength,      // 块长度之后不是下一个块，长度改为到下一个 MTrk 为止
+        truncatedChunk,      // 块长度超出文件末尾，截断到文件末尾
+        garbageSkipped,      // 块之间无法识别的字节，跳到下一个 MTrk
+        trailingGarbage,     // 最后一个块之后无法识别的字节
+        truncatedEvent,      // 块末尾不完整的事件，轨道在此结束
+        invalidEvent,        // 无法解码的事件（没有 running status 的数据字节、未知的状态字节），轨道在此结束
+        missingEndOfTrack,   // 轨道没有 End of Track
+        unmatchedNotes       // 没有对应 Note Off 的音符，在轨道末尾补上 Note Off
+    };
+
+    Type type = Type::badChunkLength;
+    int track = -1;                 // 所在轨道（从0开始），块级问题为 -1
+    juce::int64 offset = 0;         // 在文件中的偏移
+    juce::String detail;
+
+    static const char* getTypeName(Type type);
+    juce::String toString() const;
+};
+
+// 状态字节的分类，解码器按编译期生成的256项表分派
+// 通道消息排在 runningStatus 之前，解码时用一次比较区分通道消息和其他事件
+enum class SmfEventKind : uint8_t
+{
+    noteOff,          // 0x80-0x8F
+    noteOn,           // 0x90-0x9F
+    controlChange,    // 0xB0-0xBF
+    twoDataBytes,     // Poly Aftertouch、Pitch Bend
+    oneDataByte,      // Program Change、Channel Pressure
+    runningStatus,    // 0x00-0x7F：数据字节，沿用上一个通道消息的状态
+    sysex,            // 0xF0、0xF7
+    meta,             // 0xFF
+    invalid           // 其他系统消息，不能出现在 SMF 中
+};
+
+// 解码时丢弃的事件（不写入轨道，delta 累加到下一个保留的事件上），由 MidiLoadOptions 生成
+// 默认构造的过滤只保留 Set Tempo，用于范围之外的轨道
+struct SmfEventFilter
+{
+    std::array<bool, 256> keepStatus {};   // 按状态字节（已展开 running status），0xF0/0xF7 为 SysEx，0xFF 为 Meta
+    uint8_t minVelocity = 0;               // 力度低于这个值的 Note On 连同配对的 Note Off 一起丢弃
+
+    // Set Tempo 总是保留，速度表需要它
+    bool keepsMeta(uint8_t metaType) const { return keepStatus[0xFF] || metaType == 0x51; }
+};
+
+// 力度过滤时配对 Note On / Note Off 的栈，每个 (通道, 音高) 一个，记录未结束的 Note On 是否被丢弃
+// 每层只占一位：前64层放在固定数组里，更深的部分（同一音高叠了64个以上的音符）溢出到 arena 中
+// 整个结构约 90KB，由调用方每个工作线程准备一份，解码器在每个轨道开始时 reset()
+class SmfNoteStacks
+{
+public:
+    static constexpr size_t numStacks = 16 * 128;
+
+    // 清空所有栈，之后溢出的部分从 arena 分配；arena 重置之后要先 reset() 才能继续使用
+    void reset(Arena& newArena);
+
+    bool empty(size_t stack) const { return depth[stack] == 0; }
+
+    inline void push(size_t stack, bool kept)
+    {
+        const uint32_t level = depth[stack]++;
+        uint64_t& word = level < 64 ? bits[stack] : getSpillWord(stack, level);
+        const uint64_t mask = (uint64_t) 1 << (level & 63);
+        word = kept ? (word | mask) : (word & ~mask);
+    }
+
+    // 弹出并返回栈顶，栈不能为空
+    inline bool pop(size_t stack)
+    {
+        const uint32_t level = --depth[stack];
+        const uint64_t word = level < 64 ? bits[stack] : spill[stack][(level - 64) / 64];
+        return ((word >> (level & 63)) & 1) != 0;
+    }
+
+private:
+    Arena* arena = nullptr;
+    std::array<uint32_t, numStacks> depth {};
+    std::array<uint64_t, numStacks> bits {};
+    std::array<ArenaArray<uint64_t>, numStacks> spill;
+    std::vector<uint16_t> spilledStacks;   // 用过溢出数组的栈，reset() 时只清这些
+
+    uint64_t& getSpillWord(size_t stack, uint32_t level);
+};
+
+// 标准MIDI文件（SMF）解码器
+// 直接把 MTrk 块解码进 MidiTrackEvents 的紧凑数组，不为单个事件分配内存
+class SmfDecoder
+{
+public:
+    // MThd 块的最小长度（含8字节块头）
+    static constexpr int headerChunkSize = 14;
+    static constexpr int chunkHeaderSize = 8;
+
+    // 解析 MThd 块，data至少要有 headerChunkSize 字节
+    static bool readHeader(const uint8_t* data, size_t size, SmfHeader& header, juce::String& error);
+
+    // 读取8字节块头，返回块ID是否为给定的四个字符
+    static bool readChunkHeader(const uint8_t* data, const char* chunkId, uint32_t& chunkLength);
+
+    // 恢复模式用：position 处是否像一个块的开头（文件末尾、MTrk 块头，或者长度正好接上 MTrk/文件末尾的其他块）
+    static bool isChunkBoundary(const uint8_t* fileBase, size_t fileSize, size_t position);
+
+    // 从 position 开始查找下一个 "MTrk"，返回它的偏移，找不到时返回 fileSize（x86-64 上用 SSE2 每次比较16个位置）
+    static size_t findTrackChunk(const uint8_t* fileBase, size_t fileSize, size_t position);
+
+    // 解码一个 MTrk 块的内容（不含块头），结果追加到 track 中，事件数组在 arena 中分配
+    // fileBase 是整个文件的起始地址，Meta/SysEx负载以相对它的偏移记录，data必须在其生命周期内有效
+    // track.counts 按事件类型和通道逐个事件累加（统计信息不再需要单独扫描一遍）
+    // 每解码 LoadProgress::publishInterval 个事件：progress 不为空时累加一次已解码的字节数和事件数，
+    // 并把新增的事件数、音符数和速度变化发布到 progress->live，
+    // cancelFlag 不为空且已置位时立即返回 false（错误信息为 "Cancelled"）
+    // anomalies 不为空时是恢复模式：截断或无法解码的事件不算错误，轨道在该处结束，问题追加到 anomalies 中
+    // （只在出错的路径上多一次判断，正常事件的解码速度不变）
+    // filter 不为空时被过滤的事件只跳过不写入，轨道的事件数、计数和 Meta 列表都只算保留的事件
+    // noteStacks 是力度过滤用的配对栈，多个轨道连续解码时由调用方传入复用，为空时按需临时分配
+    static bool decodeTrack(const uint8_t* fileBase, const uint8_t* data, size_t size, MidiTrackEvents& track, Arena& arena,
+                            juce::String& error, LoadProgress* progress = nullptr, const std::atomic<bool>* cancelFlag = nullptr,
+                            std::vector<SmfAnomaly>* anomalies = nullptr, const SmfEventFilter* filter = nullptr,
+                            SmfNoteStacks* noteStacks = nullptr);
+
+    // 在轨道末尾为没有 Note Off 的音符补上 Note Off（力度0），配对规则与 NoteTable 相同，返回补上的数量
+    // arena 必须是解码这个轨道时用的那个
+    static size_t closeUnmatchedNotes(MidiTrackEvents& track, Arena& arena);
+
+    // 读取可变长度数值（最多4字节），失败时返回false
+    static inline bool readVariableLength(const uint8_t*& pos, const uint8_t* end, uint32_t& value)
+    {
+        value = 0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (pos >= end)
+                return false;
+
+            const uint8_t byte = *pos++;
+            value = (value << 7) | (byte & 0x7F);
+
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+
+        return false;
+    }
+
+    static inline uint32_t readBigEndian32(const uint8_t* data)
+    {
+        return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | uint32_t(data[3]);
+    }
+
+    static inline uint16_t readBigEndian16(const uint8_t* data)
+    {
+        return uint16_t((data[0] << 8) | data[1]);
+    }
+};
+
+#endif //CANDYJAR_SMFDECODER_H
@@ -0,0 +1,124 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "TempoMap.h"
+#include <algorithm>
+
+void TempoMap::clear()
+{
+    segments.clear();
+    smpte = false;
+}
+
+void TempoMap::setSegments(const Segment* newSegments, size_t numSegments, bool isSmpteFormat)
+{
+    segments.assign(newSegments, newSegments + numSegments);
+    smpte = isSmpteFormat;
+}
+
+void TempoMap::build(const std::vector<MidiTrackEvents>& tracks, short timeFormat)
+{
+    std::vector<TempoChange> changes;
+
+    if (timeFormat >= 0)
+        for (const auto& track : tracks)
+            collectTempoChanges(track.metaBase, track.metaEvents.data(), track.metaEvents.size(), changes);
+
+    build(changes, timeFormat);
+}
+
+void TempoMap::collectTempoChanges(const uint8_t* metaBase, const MetaEventRef* metaEvents, size_t numMetaEvents,
+                                   std::vector<TempoChange>& changes)
+{
+    for (size_t i = 0; i < numMetaEvents; ++i)
+    {
+        const MetaEventRef& meta = metaEvents[i];
+
+        if (meta.type != 0x51 || meta.length < 3)
+            continue;
+
+        const uint8_t* data = metaBase + meta.dataOffset;
+        const uint32_t tempo = (uint32_t(data[0]) << 16) | (uint32_t(data[1]) << 8) | data[2];
+
+        if (tempo > 0)
+            changes.push_back({ meta.tick, tempo });
+    }
+}
+
+void TempoMap::build(std::vector<TempoChange>& changes, short timeFormat)
+{
+    clear();
+
+    if (timeFormat < 0)
+    {
+        // SMPTE：高字节为负的帧率（-29 表示 29.97 drop frame），低字节为每帧tick数
+        smpte = true;
+        const int framesPerSecond = -(int) (int8_t) (timeFormat >> 8);
+        const int ticksPerFrame = std::max(1, timeFormat & 0xFF);
+        const double frameRate = framesPerSecond == 29 ? 30000.0 / 1001.0 : (double) std::max(1, framesPerSecond);
+
+        Segment segment;
+        segment.secondsPerTick = 1.0 / (frameRate * ticksPerFrame);
+        segments.push_back(segment);
+        return;
+    }
+
+    const double ticksPerQuarterNote = (double) std::max((short) 1, timeFormat);
+
+    // 按tick稳定排序，同一tick上的多个速度以最后一个为准
+    std::stable_sort(changes.begin(), changes.end(),
+                     [](const TempoChange& a, const TempoChange& b) { return a.tick < b.tick; });
+
+    Segment first;
+    first.microsecondsPerQuarterNote = defaultMicrosecondsPerQuarterNote;
+    first.secondsPerTick = defaultMicrosecondsPerQuarterNote / (1000000.0 * ticksPerQuarterNote);
+    segments.push_back(first);
+
+    for (const auto& change : changes)
+    {
+        Segment& last = segments.back();
+
+        if (change.tick == last.startTick)
+        {
+            last.microsecondsPerQuarterNote = change.microsecondsPerQuarterNote;
+            last.secondsPerTick = change.microsecondsPerQuarterNote / (1000000.0 * ticksPerQuarterNote);
+            continue;
+        }
+
+        if (change.microsecondsPerQuarterNote == last.microsecondsPerQuarterNote)
+            continue;
+
+        Segment segment;
+        segment.startTick = change.tick;
+        segment.startSeconds = last.startSeconds + (double) (change.tick - last.startTick) * last.secondsPerTick;
+        segment.microsecondsPerQuarterNote = change.microsecondsPerQuarterNote;
+        segment.secondsPerTick = change.microsecondsPerQuarterNote / (1000000.0 * ticksPerQuarterNote);
+        segments.push_back(segment);
+    }
+}
+
+double TempoMap::ticksToSeconds(double tick) const
+{
+    if (segments.empty())
+        return 0.0;
+
+    // 找到最后一个 startTick <= tick 的段
+    auto it = std::upper_bound(segments.begin(), segments.end(), tick,
+                               [](double value, const Segment& segment) { return value < (double) segment.startTick; });
+
+    const Segment& segment = it == segments.begin() ? segments.front() : *(it - 1);
+    return segment.startSeconds + (tick - (double) segment.startTick) * segment.secondsPerTick;
+}
+
+double TempoMap::secondsToTicks(double seconds) const
+{
+    if (segments.empty())
+        return 0.0;
+
+    auto it = std::upper_bound(segments.begin(), segments.end(), seconds,
+                               [](double value, const Segment& segment) { return value < segment.startSeconds; });
+
+    const Segment& segment = it == segments.begin() ? segments.front() : *(it - 1);
+    return (double) segment.startTick + (seconds - segment.startSeconds) / segment.secondsPerTick;
+}
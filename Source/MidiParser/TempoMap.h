@@ -0,0 +1,59 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_TEMPOMAP_H
+#define CANDYJAR_TEMPOMAP_H
+
+#include "MidiTrackEvents.h"
+
+// 速度表：把所有轨道的 Set Tempo 事件整理成分段线性的 tick → 秒 映射
+// 每段保存起点的累计秒数，任意方向的换算都只需要一次二分查找
+class TempoMap
+{
+public:
+    struct Segment
+    {
+        uint64_t startTick = 0;
+        double startSeconds = 0.0;
+        double secondsPerTick = 0.0;
+        uint32_t microsecondsPerQuarterNote = 0;  // SMPTE格式下为0
+    };
+
+    // 一个 Set Tempo 事件
+    struct TempoChange
+    {
+        uint64_t tick;
+        uint32_t microsecondsPerQuarterNote;
+    };
+
+    // timeFormat 为 MThd 中的原始值：正数为每四分音符tick数，负数为SMPTE格式
+    void build(const std::vector<MidiTrackEvents>& tracks, short timeFormat);
+
+    // 由已经收集的速度变化建立：changes 被原地按tick稳定排序，同一tick上的多个速度以最后一个为准
+    void build(std::vector<TempoChange>& changes, short timeFormat);
+
+    // 收集一段 Meta 引用中的 Set Tempo（FF 51 03 tt tt tt），追加到 changes
+    static void collectTempoChanges(const uint8_t* metaBase, const MetaEventRef* metaEvents, size_t numMetaEvents,
+                                    std::vector<TempoChange>& changes);
+
+    // 直接设置已经计算好的分段（例如从缓存文件读取）
+    void setSegments(const Segment* newSegments, size_t numSegments, bool isSmpteFormat);
+
+    void clear();
+
+    double ticksToSeconds(double tick) const;
+    double secondsToTicks(double seconds) const;
+
+    const std::vector<Segment>& getSegments() const { return segments; }
+    bool isSmpte() const { return smpte; }
+
+    // 默认速度 120 BPM
+    static constexpr uint32_t defaultMicrosecondsPerQuarterNote = 500000;
+
+private:
+    std::vector<Segment> segments;
+    bool smpte = false;
+};
+
+#endif //CANDYJAR_TEMPOMAP_H
@@ -0,0 +1,180 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "NotePyramid.h"
+#include <algorithm>
+
+namespace
+{
+    // 每个任务负责的音高数，任务之间写不同的行，不需要同步
+    constexpr int keysPerTask = 8;
+    constexpr int numGroups = NotePyramid::numKeys / keysPerTask;
+
+    // 扫描音符时每处理这么多个检查一次取消
+    constexpr size_t cancelCheckInterval = 1 << 20;
+
+    // 桶宽不超过 2^32，累加时截断到桶宽就不会溢出
+    inline void addCoverage(uint32_t& covered, uint64_t ticks, uint64_t bucketWidth)
+    {
+        covered = (uint32_t) std::min((uint64_t) covered + ticks, bucketWidth);
+    }
+}
+
+void NotePyramid::clear()
+{
+    data.clear();
+    levelOffsets.clear();
+    levelBuckets.clear();
+    baseShift = 0;
+    endTick = 0;
+}
+
+bool NotePyramid::build(const NoteTable& notes, WorkStealingPool& pool, const std::atomic<bool>* cancelFlag)
+{
+    clear();
+
+    const size_t numNotes = notes.size();
+
+    if (numNotes == 0)
+        return true;
+
+    const uint32_t* startTicks = notes.getStartTicks();
+    const uint32_t* endTicks = notes.getEndTicks();
+    const uint8_t* keys = notes.getKeys();
+
+    // 长度为0的音符按1 tick算，保证至少占一个桶
+    for (size_t i = 0; i < numNotes; ++i)
+        endTick = std::max(endTick, std::max((uint64_t) endTicks[i], (uint64_t) startTicks[i] + 1));
+
+    while (((endTick - 1) >> baseShift) + 1 > maxBaseBuckets)
+        ++baseShift;
+
+    // 各层的大小：每层桶数减半，直到只剩一个桶
+    size_t totalBytes = 0;
+
+    for (uint32_t buckets = (uint32_t) (((endTick - 1) >> baseShift) + 1); ; buckets = (buckets + 1) / 2)
+    {
+        levelOffsets.push_back(totalBytes);
+        levelBuckets.push_back(buckets);
+        totalBytes += (size_t) numKeys * buckets;
+
+        if (buckets == 1)
+            break;
+    }
+
+    data.resize(totalBytes);
+
+    // 先按音高组对音符下标做一次计数排序，每个任务只处理自己那一组的音符
+    const auto isCancelled = [cancelFlag]
+    {
+        return cancelFlag != nullptr && cancelFlag->load(std::memory_order_relaxed);
+    };
+
+    size_t groupOffsets[numGroups + 1] = {};
+
+    for (size_t i = 0; i < numNotes; ++i)
+        ++groupOffsets[keys[i] / keysPerTask + 1];
+
+    for (int group = 0; group < numGroups; ++group)
+        groupOffsets[group + 1] += groupOffsets[group];
+
+    if (isCancelled())
+    {
+        clear();
+        return false;
+    }
+
+    std::vector<uint32_t> order(numNotes);
+    size_t groupEnds[numGroups];
+    std::copy(groupOffsets, groupOffsets + numGroups, groupEnds);
+
+    for (size_t i = 0; i < numNotes; ++i)
+        order[groupEnds[keys[i] / keysPerTask]++] = (uint32_t) i;
+
+    const uint32_t numBaseBuckets = levelBuckets[0];
+    const uint64_t bucketWidth = (uint64_t) 1 << baseShift;
+    const int numLevels = getNumLevels();
+    std::atomic<bool> cancelled {false};
+
+    pool.parallelFor(numGroups, [&](int taskIndex, int)
+    {
+        const int firstKey = taskIndex * keysPerTask;
+
+        // 每个音高一行：桶内被部分覆盖的tick数（超过桶宽时截断），以及完全覆盖的音符数的差分
+        std::vector<uint32_t> partial((size_t) keysPerTask * numBaseBuckets, 0);
+        std::vector<int32_t> fullDelta((size_t) keysPerTask * (numBaseBuckets + 1), 0);
+
+        for (size_t position = groupOffsets[taskIndex]; position < groupOffsets[taskIndex + 1]; ++position)
+        {
+            if (((position - groupOffsets[taskIndex]) & (cancelCheckInterval - 1)) == 0 && isCancelled())
+            {
+                cancelled = true;
+                return;
+            }
+
+            const uint32_t i = order[position];
+            const int row = keys[i] - firstKey;
+
+            const uint64_t start = startTicks[i];
+            const uint64_t end = std::max((uint64_t) endTicks[i], start + 1);
+            const uint64_t first = start >> baseShift;
+            const uint64_t last = (end - 1) >> baseShift;
+            uint32_t* partialRow = partial.data() + (size_t) row * numBaseBuckets;
+
+            if (first == last)
+            {
+                addCoverage(partialRow[first], end - start, bucketWidth);
+                continue;
+            }
+
+            // 首尾两个桶按实际覆盖的长度累加，中间的桶被完全覆盖，用差分一次记下
+            addCoverage(partialRow[first], ((first + 1) << baseShift) - start, bucketWidth);
+            addCoverage(partialRow[last], end - (last << baseShift), bucketWidth);
+
+            int32_t* deltaRow = fullDelta.data() + (size_t) row * (numBaseBuckets + 1);
+            ++deltaRow[first + 1];
+            --deltaRow[last];
+        }
+
+        for (int row = 0; row < keysPerTask; ++row)
+        {
+            const uint32_t* partialRow = partial.data() + (size_t) row * numBaseBuckets;
+            const int32_t* deltaRow = fullDelta.data() + (size_t) row * (numBaseBuckets + 1);
+            uint8_t* output = getWritableRow(0, firstKey + row);
+            int64_t fullCount = 0;
+
+            for (uint32_t bucket = 0; bucket < numBaseBuckets; ++bucket)
+            {
+                fullCount += deltaRow[bucket];
+
+                // 同一音高的音符重叠时覆盖量可能超过桶宽，截断为满
+                const uint64_t covered = std::min(partialRow[bucket] + ((uint64_t) fullCount << baseShift), bucketWidth);
+                output[bucket] = (uint8_t) ((covered * 255 + bucketWidth - 1) >> baseShift);
+            }
+
+            // 逐层向上取平均
+            for (int level = 1; level < numLevels; ++level)
+            {
+                const uint8_t* source = getRow(level - 1, firstKey + row);
+                const uint32_t numSource = levelBuckets[(size_t) level - 1];
+                uint8_t* target = getWritableRow(level, firstKey + row);
+
+                for (uint32_t bucket = 0; bucket < levelBuckets[(size_t) level]; ++bucket)
+                {
+                    const uint32_t left = source[bucket * 2];
+                    const uint32_t right = bucket * 2 + 1 < numSource ? source[bucket * 2 + 1] : 0;
+                    target[bucket] = (uint8_t) ((left + right + 1) >> 1);
+                }
+            }
+        }
+    });
+
+    if (cancelled.load())
+    {
+        clear();
+        return false;
+    }
+
+    return true;
+}
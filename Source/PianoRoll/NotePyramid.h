@@ -0,0 +1,60 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_NOTEPYRAMID_H
+#define CANDYJAR_NOTEPYRAMID_H
+
+#include "../MidiParser/NoteTable.h"
+#include "../Utils/WorkStealingPool.h"
+#include <atomic>
+#include <vector>
+
+// 钢琴卷帘用的多分辨率音符摘要（类似 mipmap）
+//  - 第0层把时间切成宽度为 2^baseShift tick 的桶，记录每个音高在每个桶内被音符覆盖的比例（0~255）
+//  - 上一层的桶是下一层相邻两个桶的平均（向上取整，只要有音符就不为0），直到只剩一个桶
+//  - 绘制时按每像素的tick数选层，每帧的开销只和像素数有关，和音符数无关
+// 每层按音高分行存放：getRow(level, key)[bucket]
+class NotePyramid
+{
+public:
+    static constexpr int numKeys = 128;
+    // 第0层最多的桶数，决定最细的分辨率和内存（每层 128 * 桶数 字节，总共约两倍）
+    static constexpr uint32_t maxBaseBuckets = 1 << 16;
+
+    // 从音符表建立金字塔，各音高在线程池中并行统计；cancelFlag 置位时尽快返回 false，此时内容无效
+    // 音符数不能超过 2^32
+    bool build(const NoteTable& notes, WorkStealingPool& pool, const std::atomic<bool>* cancelFlag = nullptr);
+
+    void clear();
+
+    bool empty() const { return levelBuckets.empty(); }
+
+    int getNumLevels() const { return (int) levelBuckets.size(); }
+    uint32_t getNumBuckets(int level) const { return levelBuckets[(size_t) level]; }
+
+    // 第 level 层每个桶的宽度为 2^(baseShift + level) tick
+    int getBaseShift() const { return baseShift; }
+
+    // 所有音符结束处的tick
+    uint64_t getEndTick() const { return endTick; }
+
+    const uint8_t* getRow(int level, int key) const
+    {
+        return data.data() + levelOffsets[(size_t) level] + (size_t) key * levelBuckets[(size_t) level];
+    }
+
+private:
+    std::vector<uint8_t> data;
+    std::vector<size_t> levelOffsets;
+    std::vector<uint32_t> levelBuckets;
+    int baseShift = 0;
+    uint64_t endTick = 0;
+
+    uint8_t* getWritableRow(int level, int key)
+    {
+        return data.data() + levelOffsets[(size_t) level] + (size_t) key * levelBuckets[(size_t) level];
+    }
+};
+
+#endif //CANDYJAR_NOTEPYRAMID_H
@@ -0,0 +1,147 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "PianoRollComponent.h"
+
+namespace
+{
+    // 跟随播放时播放线在视图中的位置（占宽度的比例）
+    constexpr double playheadPosition = 0.25;
+
+    // 滚轮 delta 每 1.0 滚动的视图宽度（一格通常约 0.1），以及每格缩放的倍数
+    constexpr double scrollAmount = 2.0;
+    constexpr double zoomFactor = 1.5;
+}
+
+PianoRollComponent::PianoRollComponent(WorkStealingPool& pool)
+    : renderPool(pool),
+      vBlankAttachment(this, [this] { onVBlank(); })
+{
+    setOpaque(true);
+}
+
+PianoRollComponent::~PianoRollComponent()
+{
+}
+
+void PianoRollComponent::setSong(const NotePyramid* pyramid, const TempoMap* tempoMap)
+{
+    notePyramid = pyramid;
+    tempo = tempoMap;
+    playheadTick = -1.0;
+    showWholeSong();
+}
+
+void PianoRollComponent::showWholeSong()
+{
+    const double endTick = notePyramid != nullptr ? (double) notePyramid->getEndTick() : 0.0;
+    view.startTick = 0.0;
+    view.ticksPerPixel = juce::jmax(endTick, 1.0) / juce::jmax(getWidth(), 1);
+    imageValid = false;
+    repaint();
+}
+
+void PianoRollComponent::onVBlank()
+{
+    double newPlayheadTick = -1.0;
+
+    if (getPlayPosition && tempo != nullptr)
+    {
+        const double seconds = getPlayPosition();
+
+        if (seconds >= 0.0)
+            newPlayheadTick = tempo->secondsToTicks(seconds);
+    }
+
+    if (newPlayheadTick == playheadTick)
+        return;
+
+    playheadTick = newPlayheadTick;
+
+    // 播放线移出视图右侧的一部分后整体滚动，保持它停在左侧 playheadPosition 处
+    if (playheadTick >= 0.0)
+    {
+        const double viewWidthTicks = getWidth() * view.ticksPerPixel;
+        const double x = (playheadTick - view.startTick) / view.ticksPerPixel;
+
+        if (x < 0.0 || x > getWidth() * playheadPosition)
+        {
+            view.startTick = playheadTick - viewWidthTicks * playheadPosition;
+            imageValid = false;
+        }
+    }
+
+    repaint();
+}
+
+void PianoRollComponent::renderImage()
+{
+    const int width = getWidth();
+    const int height = getHeight();
+
+    if (!image.isValid() || image.getWidth() != width || image.getHeight() != height)
+        image = juce::Image(juce::Image::ARGB, width, height, false, juce::SoftwareImageType());
+
+    juce::Image::BitmapData bitmap(image, juce::Image::BitmapData::writeOnly);
+    static const NotePyramid emptyPyramid;
+
+    rasteriser.render(notePyramid != nullptr ? *notePyramid : emptyPyramid, view,
+                      reinterpret_cast<uint32_t*>(bitmap.data), width, height,
+                      (size_t) bitmap.lineStride / sizeof(uint32_t), renderPool);
+
+    renderedView = view;
+    imageValid = true;
+}
+
+void PianoRollComponent::paint(juce::Graphics& g)
+{
+    if (getWidth() <= 0 || getHeight() <= 0)
+        return;
+
+    if (!imageValid)
+        renderImage();
+
+    g.drawImageAt(image, 0, 0);
+
+    if (playheadTick >= 0.0)
+    {
+        const float x = (float) ((playheadTick - renderedView.startTick) / renderedView.ticksPerPixel);
+        g.setColour(juce::Colours::white);
+        g.drawVerticalLine(juce::roundToInt(x), 0.0f, (float) getHeight());
+    }
+}
+
+void PianoRollComponent::resized()
+{
+    showWholeSong();
+}
+
+void PianoRollComponent::mouseWheelMove(const juce::MouseEvent& event, const juce::MouseWheelDetails& wheel)
+{
+    const float delta = std::abs(wheel.deltaX) > std::abs(wheel.deltaY) ? wheel.deltaX : wheel.deltaY;
+
+    if (delta == 0.0f)
+        return;
+
+    if (event.mods.isCommandDown())
+    {
+        // 保持鼠标下的tick不动
+        const double anchorTick = view.startTick + event.position.x * view.ticksPerPixel;
+        view.ticksPerPixel *= delta > 0.0f ? 1.0 / zoomFactor : zoomFactor;
+        view.ticksPerPixel = juce::jmax(view.ticksPerPixel, 1.0 / 64.0);
+        view.startTick = anchorTick - event.position.x * view.ticksPerPixel;
+    }
+    else
+    {
+        view.startTick -= delta * scrollAmount * getWidth() * view.ticksPerPixel;
+    }
+
+    imageValid = false;
+    repaint();
+}
+
+void PianoRollComponent::mouseDoubleClick(const juce::MouseEvent&)
+{
+    showWholeSong();
+}
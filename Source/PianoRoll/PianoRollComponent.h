@@ -0,0 +1,57 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_PIANOROLLCOMPONENT_H
+#define CANDYJAR_PIANOROLLCOMPONENT_H
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../MidiParser/TempoMap.h"
+#include "PianoRollRasteriser.h"
+#include <functional>
+
+// 钢琴卷帘视图
+//  - 音符由 PianoRollRasteriser 从 NotePyramid 直接画进一张软件图像，再整体绘制到屏幕
+//  - 每次屏幕刷新（VBlank）检查一次播放位置，播放时视图跟随播放线滚动
+//  - 滚轮左右滚动，按住 Ctrl/Cmd 滚动时以鼠标位置为中心缩放，双击恢复到显示整首曲子
+class PianoRollComponent : public juce::Component
+{
+public:
+    // 光栅化在 pool 中并行，pool 必须比组件活得久
+    explicit PianoRollComponent(WorkStealingPool& pool);
+    ~PianoRollComponent() override;
+
+    // 设置要显示的曲子（两者在换掉之前必须保持有效），传 nullptr 清空
+    void setSong(const NotePyramid* pyramid, const TempoMap* tempoMap);
+
+    // 每帧调用一次取得播放位置（秒），为空或返回负数时不显示播放线
+    std::function<double()> getPlayPosition;
+
+    //==============================================================================
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+    void mouseWheelMove(const juce::MouseEvent& event, const juce::MouseWheelDetails& wheel) override;
+    void mouseDoubleClick(const juce::MouseEvent& event) override;
+
+private:
+    const NotePyramid* notePyramid = nullptr;
+    const TempoMap* tempo = nullptr;
+
+    WorkStealingPool& renderPool;
+    PianoRollRasteriser rasteriser;
+    juce::Image image;
+    PianoRollView view;
+    PianoRollView renderedView;
+    bool imageValid = false;
+
+    double playheadTick = -1.0;
+    juce::VBlankAttachment vBlankAttachment;
+
+    void onVBlank();
+    void showWholeSong();
+    void renderImage();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PianoRollComponent)
+};
+
+#endif //CANDYJAR_PIANOROLLCOMPONENT_H
@@ -0,0 +1,167 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "PianoRollRasteriser.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // 每个工作线程分到的行段数，行段越多负载越均衡
+    constexpr int bandsPerThread = 4;
+
+    // 有音符但覆盖很少的桶也至少显示这么多比例的音符颜色，缩小时稀疏的音符不会消失
+    constexpr int minimumCoverage = 64;
+
+    inline bool isBlackKey(int key)
+    {
+        const int pitchClass = key % 12;
+        return pitchClass == 1 || pitchClass == 3 || pitchClass == 6 || pitchClass == 8 || pitchClass == 10;
+    }
+
+    inline uint32_t blend(uint32_t from, uint32_t to, int amount)
+    {
+        uint32_t result = 0xFF000000u;
+
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            const int a = (int) ((from >> shift) & 0xFF);
+            const int b = (int) ((to >> shift) & 0xFF);
+            result |= (uint32_t) (a + ((b - a) * amount + 127) / 255) << shift;
+        }
+
+        return result;
+    }
+
+    // 第 y 行像素覆盖的音高范围 [lowKey, highKey]，高度不足128像素时一行会覆盖多个音高
+    inline void getRowKeys(const PianoRollView& view, int y, int height, int& highKey, int& lowKey)
+    {
+        const int numKeys = view.highestKey - view.lowestKey + 1;
+        highKey = view.highestKey - (int) ((int64_t) y * numKeys / height);
+        lowKey = view.highestKey - (int) (((int64_t) (y + 1) * numKeys - 1) / height);
+    }
+}
+
+void PianoRollRasteriser::setPalette(const PianoRollPalette& newPalette)
+{
+    for (int coverage = 0; coverage < 256; ++coverage)
+    {
+        const int amount = coverage == 0 ? 0 : minimumCoverage + (255 - minimumCoverage) * coverage / 255;
+        colours[0][coverage] = blend(newPalette.whiteKeyBackground, newPalette.note, amount);
+        colours[1][coverage] = blend(newPalette.blackKeyBackground, newPalette.note, amount);
+    }
+
+    octaveLineColour = newPalette.octaveLine | 0xFF000000u;
+}
+
+void PianoRollRasteriser::render(const NotePyramid& pyramid, const PianoRollView& view, uint32_t* pixels,
+                                 int width, int height, size_t lineStride, WorkStealingPool& pool)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    // 选层：桶宽不超过一个像素对应的tick数的最粗一层，这样每列只跨1~3个桶
+    int level = 0;
+    columnFirst.assign((size_t) width, 1);
+    columnLast.assign((size_t) width, 0);
+
+    if (!pyramid.empty())
+    {
+        const double ticksPerPixel = std::max(view.ticksPerPixel, 1.0e-9);
+        level = std::min(std::max((int) std::floor(std::log2(ticksPerPixel)) - pyramid.getBaseShift(), 0),
+                         pyramid.getNumLevels() - 1);
+
+        const int shift = pyramid.getBaseShift() + level;
+        const double endTick = (double) pyramid.getEndTick();
+
+        for (int x = 0; x < width; ++x)
+        {
+            const double columnStart = view.startTick + x * ticksPerPixel;
+            const double columnEnd = columnStart + ticksPerPixel;
+
+            if (columnEnd <= 0.0 || columnStart >= endTick)
+                continue;
+
+            const uint64_t firstTick = (uint64_t) std::max(0.0, std::floor(columnStart));
+            const uint64_t lastTick = (uint64_t) std::min(endTick, std::ceil(columnEnd)) - 1;
+            columnFirst[(size_t) x] = (uint32_t) (firstTick >> shift);
+            columnLast[(size_t) x] = (uint32_t) (std::max(firstTick, lastTick) >> shift);
+        }
+    }
+
+    const int numBands = std::min(height, pool.getNumThreads() * bandsPerThread);
+
+    pool.parallelForWithoutWaiting(numBands, [&](int band, int)
+    {
+        const int firstRow = (int) ((int64_t) band * height / numBands);
+        const int endRow = (int) ((int64_t) (band + 1) * height / numBands);
+        int previousHigh = -1, previousLow = -1;
+        bool previousLine = false;
+
+        for (int y = firstRow; y < endRow; ++y)
+        {
+            int highKey, lowKey;
+            getRowKeys(view, y, height, highKey, lowKey);
+
+            // 每个 C 音所占像素的最下面一行画八度分隔线（每个音高至少3像素高时）
+            bool octaveLine = false;
+
+            if (y + 1 < height && highKey == lowKey && lowKey % 12 == 0 && height >= 3 * (view.highestKey - view.lowestKey + 1))
+            {
+                int nextHigh, nextLow;
+                getRowKeys(view, y + 1, height, nextHigh, nextLow);
+                octaveLine = nextHigh != highKey;
+            }
+
+            uint32_t* row = pixels + (size_t) y * lineStride;
+
+            if (y > firstRow && highKey == previousHigh && lowKey == previousLow && octaveLine == previousLine)
+                std::memcpy(row, row - lineStride, (size_t) width * sizeof(uint32_t));
+            else
+                renderRow(pyramid, level, highKey, lowKey, octaveLine, row, width);
+
+            previousHigh = highKey;
+            previousLow = lowKey;
+            previousLine = octaveLine;
+        }
+    });
+}
+
+void PianoRollRasteriser::renderRow(const NotePyramid& pyramid, int level, int highKey, int lowKey, bool octaveLine,
+                                    uint32_t* row, int width) const
+{
+    if (octaveLine)
+    {
+        std::fill(row, row + width, octaveLineColour);
+        return;
+    }
+
+    const uint32_t* palette = colours[highKey == lowKey && isBlackKey(highKey) ? 1 : 0];
+
+    if (pyramid.empty())
+    {
+        std::fill(row, row + width, palette[0]);
+        return;
+    }
+
+    const uint32_t lastBucket = pyramid.getNumBuckets(level) - 1;
+
+    for (int x = 0; x < width; ++x)
+    {
+        const uint32_t first = columnFirst[(size_t) x];
+        const uint32_t last = std::min(columnLast[(size_t) x], lastBucket);
+        uint8_t coverage = 0;
+
+        for (int key = lowKey; key <= highKey; ++key)
+        {
+            const uint8_t* buckets = pyramid.getRow(level, key);
+
+            for (uint32_t bucket = first; bucket <= last; ++bucket)
+                coverage = std::max(coverage, buckets[bucket]);
+        }
+
+        row[x] = palette[coverage];
+    }
+}
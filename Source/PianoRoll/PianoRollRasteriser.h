@@ -0,0 +1,57 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_PIANOROLLRASTERISER_H
+#define CANDYJAR_PIANOROLLRASTERISER_H
+
+#include "NotePyramid.h"
+
+// 钢琴卷帘的可见范围
+struct PianoRollView
+{
+    double startTick = 0.0;        // 左边缘对应的tick
+    double ticksPerPixel = 1.0;
+    int lowestKey = 0;             // 底部的音高
+    int highestKey = NotePyramid::numKeys - 1;   // 顶部的音高
+};
+
+// 颜色都是 0xAARRGGBB，和 juce::PixelARGB 在内存中的布局一致
+struct PianoRollPalette
+{
+    uint32_t whiteKeyBackground = 0xFF2A2A2Au;
+    uint32_t blackKeyBackground = 0xFF222222u;
+    uint32_t note = 0xFFE8A33Cu;
+    uint32_t octaveLine = 0xFF3C3C3Cu;
+};
+
+// 把 NotePyramid 直接写进32位像素缓冲区的CPU光栅化器
+//  - 每列按每像素的tick数选一层金字塔，取该列覆盖的桶中的最大值，滚动时不会闪烁
+//  - 图像按行分成若干段在线程池中并行填充；相同音高的像素行只算一次，其余直接复制
+//    线程池正被加载占用时不等待，在当前线程画完
+// 每帧的开销是 O(宽 * 高)，和音符数无关
+class PianoRollRasteriser
+{
+public:
+    PianoRollRasteriser() { setPalette(PianoRollPalette()); }
+
+    void setPalette(const PianoRollPalette& newPalette);
+
+    // 画满 width * height 像素，lineStride 是相邻两行之间的像素数；pyramid 为空时只画背景
+    void render(const NotePyramid& pyramid, const PianoRollView& view, uint32_t* pixels,
+                int width, int height, size_t lineStride, WorkStealingPool& pool);
+
+private:
+    // 覆盖比例到颜色的查找表：[0] 白键行，[1] 黑键行
+    uint32_t colours[2][256];
+    uint32_t octaveLineColour = 0;
+
+    // 每列在所选层中覆盖的桶 [first, last]，first > last 表示这一列没有音符
+    std::vector<uint32_t> columnFirst;
+    std::vector<uint32_t> columnLast;
+
+    void renderRow(const NotePyramid& pyramid, int level, int highKey, int lowKey, bool octaveLine,
+                   uint32_t* row, int width) const;
+};
+
+#endif //CANDYJAR_PIANOROLLRASTERISER_H
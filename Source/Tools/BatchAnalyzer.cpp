@@ -0,0 +1,268 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "BatchAnalyzer.h"
+#include "StatisticsJson.h"
+#include <condition_variable>
+#include <mutex>
+
+namespace
+{
+    // 正在加载的文件的估算内存合计，超过预算时新的加载等待
+    class MemoryBudget
+    {
+    public:
+        explicit MemoryBudget(juce::int64 budgetBytes) : budget(budgetBytes) {}
+
+        void acquire(juce::int64 bytes)
+        {
+            std::unique_lock<std::mutex> guard(lock);
+
+            // 没有其他加载时总是放行，否则超过预算的文件永远等不到
+            released.wait(guard, [&] { return numLoads == 0 || used + bytes <= budget; });
+            used += bytes;
+            maxLoads = std::max(maxLoads, ++numLoads);
+        }
+
+        void release(juce::int64 bytes)
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                used -= bytes;
+                --numLoads;
+            }
+
+            released.notify_all();
+        }
+
+        int getMaxConcurrentLoads() const
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return maxLoads;
+        }
+
+    private:
+        const juce::int64 budget;
+        mutable std::mutex lock;
+        std::condition_variable released;
+        juce::int64 used = 0;
+        int numLoads = 0;
+        int maxLoads = 0;
+    };
+
+    void loadFile(MidiParser& parser, BatchAnalyzer::FileResult& result, const MidiLoadOptions& loadOptions)
+    {
+        const double startTime = juce::Time::getMillisecondCounterHiRes();
+        result.ok = parser.loadMidiFile(result.file, loadOptions);
+        result.loadSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+
+        if (result.ok)
+            result.statistics = parser.getStatistics();
+        else
+            result.error = parser.getLastErrorMessage();
+    }
+
+    juce::String escapeCsv(const juce::String& field)
+    {
+        if (!field.containsAnyOf(",\"\r\n"))
+            return field;
+
+        return "\"" + field.replace("\"", "\"\"") + "\"";
+    }
+}
+
+juce::Array<juce::File> BatchAnalyzer::collectFiles(const juce::File& directoryOrList)
+{
+    juce::Array<juce::File> files;
+
+    if (directoryOrList.isDirectory())
+    {
+        files = directoryOrList.findChildFiles(juce::File::findFiles, true, "*.mid;*.midi;*.smf");
+        files.sort();
+        return files;
+    }
+
+    juce::StringArray lines;
+    directoryOrList.readLines(lines);
+
+    for (const auto& line : lines)
+    {
+        const juce::String path = line.trim();
+
+        if (path.isNotEmpty() && !path.startsWithChar('#'))
+            files.add(directoryOrList.getParentDirectory().getChildFile(path));
+    }
+
+    return files;
+}
+
+BatchAnalyzer::Summary BatchAnalyzer::run(const juce::Array<juce::File>& files, const Options& options, std::vector<FileResult>& results)
+{
+    const double startTime = juce::Time::getMillisecondCounterHiRes();
+
+    results.assign((size_t) files.size(), FileResult());
+    std::vector<int> smallFiles, largeFiles;
+
+    for (int i = 0; i < files.size(); ++i)
+    {
+        FileResult& result = results[(size_t) i];
+        result.file = files[i];
+        result.bytes = std::max((juce::int64) 0, files[i].getSize());
+        result.splitAcrossTracks = result.bytes >= options.largeFileBytes;
+        (result.splitAcrossTracks ? largeFiles : smallFiles).push_back(i);
+    }
+
+    WorkStealingPool pool(options.numThreads);
+    MemoryBudget budget(options.memoryBudgetBytes);
+
+    // 每个工作线程一个解析器，内存池在这个线程加载的文件之间复用
+    std::vector<std::unique_ptr<MidiParser>> parsers;
+    for (int i = 0; i < pool.getNumThreads(); ++i)
+    {
+        auto parser = std::make_unique<MidiParser>();
+        parser->setSharedThreadPool(&pool);
+        parser->setCacheEnabled(options.useCache);
+        parser->setRecoveryEnabled(options.recovery);
+        parser->setCompressedTracks(options.compressTracks);
+        parsers.push_back(std::move(parser));
+    }
+
+    // 空闲解析器保留的内存也算在预算里：超过每个线程的份额就还给系统
+    const size_t retainedBytesPerParser = (size_t) std::max((juce::int64) 0, options.memoryBudgetBytes / pool.getNumThreads());
+
+    // 小文件：每个线程同时加载一个，解析器的并行步骤在池内线程中串行执行
+    pool.parallelFor((int) smallFiles.size(), [&](int index, int workerIndex)
+    {
+        FileResult& result = results[(size_t) smallFiles[(size_t) index]];
+        MidiParser& parser = *parsers[(size_t) workerIndex];
+        const juce::int64 estimate = result.bytes * memoryPerFileByte;
+
+        budget.acquire(estimate);
+        loadFile(parser, result, options.loadOptions);
+        budget.release(estimate);
+
+        if (parser.getArena().getBytesMapped() > retainedBytesPerParser)
+            parser.releaseMemory();
+    });
+
+    // 大文件：一次只加载一个，按轨道在整个线程池上并行
+    for (const int fileIndex : largeFiles)
+    {
+        FileResult& result = results[(size_t) fileIndex];
+        const juce::int64 estimate = result.bytes * memoryPerFileByte;
+
+        budget.acquire(estimate);
+        loadFile(*parsers.front(), result, options.loadOptions);
+        budget.release(estimate);
+
+        parsers.front()->releaseMemory();
+    }
+
+    Summary summary;
+    summary.files = (int) results.size();
+    summary.numThreads = pool.getNumThreads();
+    summary.maxConcurrentLoads = budget.getMaxConcurrentLoads();
+
+    for (const auto& result : results)
+    {
+        summary.totalBytes += result.bytes;
+
+        if (result.ok)
+        {
+            ++summary.succeeded;
+            summary.totalEvents += result.statistics.totalEvents;
+        }
+        else
+        {
+            ++summary.failed;
+        }
+    }
+
+    summary.wallSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+    return summary;
+}
+
+bool BatchAnalyzer::writeCsv(const std::vector<FileResult>& results, const juce::File& output, juce::String& error)
+{
+    juce::String csv = "file,bytes,ok,splitAcrossTracks,loadSeconds,tracks,events,notes,durationSeconds,ticks,"
+                       "tempoChanges,fileType,timeFormat,maxPolyphony,repairedAnomalies,error\n";
+
+    for (const auto& result : results)
+    {
+        const MidiStatistics& statistics = result.statistics;
+
+        juce::StringArray fields;
+        fields.add(escapeCsv(result.file.getFullPathName()));
+        fields.add(juce::String(result.bytes));
+        fields.add(result.ok ? "1" : "0");
+        fields.add(result.splitAcrossTracks ? "1" : "0");
+        fields.add(juce::String(result.loadSeconds, 6));
+        fields.add(juce::String(statistics.totalTracks));
+        fields.add(juce::String(statistics.totalEvents));
+        fields.add(juce::String(statistics.totalNotes));
+        fields.add(juce::String(statistics.totalDuration, 6));
+        fields.add(juce::String(statistics.totalTicks));
+        fields.add(juce::String(statistics.tempoChanges));
+        fields.add(juce::String(statistics.fileType));
+        fields.add(juce::String(statistics.timeFormat));
+        fields.add(juce::String(statistics.maxPolyphony));
+        fields.add(juce::String(statistics.repairedAnomalies));
+        fields.add(escapeCsv(result.error));
+
+        csv << fields.joinIntoString(",") << "\n";
+    }
+
+    if (!output.replaceWithText(csv, false, false, "\n"))
+    {
+        error = "Cannot write " + output.getFullPathName();
+        return false;
+    }
+
+    return true;
+}
+
+juce::var BatchAnalyzer::toVar(const Summary& summary)
+{
+    juce::DynamicObject::Ptr object = new juce::DynamicObject();
+    object->setProperty("files", summary.files);
+    object->setProperty("succeeded", summary.succeeded);
+    object->setProperty("failed", summary.failed);
+    object->setProperty("threads", summary.numThreads);
+    object->setProperty("maxConcurrentLoads", summary.maxConcurrentLoads);
+    object->setProperty("totalBytes", summary.totalBytes);
+    object->setProperty("totalEvents", summary.totalEvents);
+    object->setProperty("wallSeconds", summary.wallSeconds);
+    object->setProperty("filesPerSecond", summary.getFilesPerSecond());
+    object->setProperty("megabytesPerSecond", summary.getMegabytesPerSecond());
+    object->setProperty("eventsPerSecond", summary.getEventsPerSecond());
+    object->setProperty("peakRssBytes", StatisticsJson::getPeakResidentBytes());
+    return object.get();
+}
+
+juce::var BatchAnalyzer::toVar(const Summary& summary, const std::vector<FileResult>& results)
+{
+    juce::Array<juce::var> files;
+
+    for (const auto& result : results)
+    {
+        juce::DynamicObject::Ptr file = new juce::DynamicObject();
+        file->setProperty("file", result.file.getFullPathName());
+        file->setProperty("bytes", result.bytes);
+        file->setProperty("ok", result.ok);
+        file->setProperty("splitAcrossTracks", result.splitAcrossTracks);
+        file->setProperty("loadSeconds", result.loadSeconds);
+
+        if (result.ok)
+            file->setProperty("statistics", StatisticsJson::toVar(result.statistics));
+        else
+            file->setProperty("error", result.error);
+
+        files.add(file.get());
+    }
+
+    juce::DynamicObject::Ptr object = new juce::DynamicObject();
+    object->setProperty("summary", toVar(summary));
+    object->setProperty("files", files);
+    return object.get();
+}
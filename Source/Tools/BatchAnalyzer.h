@@ -0,0 +1,77 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_BATCHANALYZER_H
+#define CANDYJAR_BATCHANALYZER_H
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../MidiParser/MidiParser.h"
+
+// 批量分析：用一个共享的线程池加载一批MIDI文件，输出每个文件的统计信息或错误
+//  - 小文件每个工作线程加载一个，文件内部不再并行（在池内线程中串行解码）
+//  - 大文件逐个加载，每个文件按轨道在整个线程池上并行解码
+//  - 同时加载的文件数不固定，由内存预算决定：每个文件按大小估算加载时的内存，
+//    正在加载的文件估算合计超过预算时，后面的文件等待（单个文件超过预算时单独加载）
+class BatchAnalyzer
+{
+public:
+    struct Options
+    {
+        int numThreads = 0;                                    // <= 0 表示使用全部硬件线程
+        juce::int64 memoryBudgetBytes = (juce::int64) 2 << 30;
+        juce::int64 largeFileBytes = (juce::int64) 8 << 20;   // 不小于这个大小的文件按轨道并行加载
+        bool useCache = false;
+        bool recovery = true;
+        bool compressTracks = false;                           // 见 MidiParser::setCompressedTracks
+        MidiLoadOptions loadOptions;                           // 每个文件都按这个选项过滤
+    };
+
+    // 每个文件的加载结果
+    struct FileResult
+    {
+        juce::File file;
+        juce::int64 bytes = 0;
+        bool ok = false;
+        bool splitAcrossTracks = false;   // 按大文件方式加载
+        double loadSeconds = 0.0;
+        juce::String error;
+        MidiStatistics statistics;
+    };
+
+    // 整批的汇总
+    struct Summary
+    {
+        int files = 0;
+        int succeeded = 0;
+        int failed = 0;
+        int numThreads = 0;
+        int maxConcurrentLoads = 0;
+        juce::int64 totalBytes = 0;
+        juce::int64 totalEvents = 0;
+        double wallSeconds = 0.0;
+
+        double getFilesPerSecond() const { return wallSeconds > 0.0 ? files / wallSeconds : 0.0; }
+        double getMegabytesPerSecond() const { return wallSeconds > 0.0 ? totalBytes / (wallSeconds * 1048576.0) : 0.0; }
+        double getEventsPerSecond() const { return wallSeconds > 0.0 ? totalEvents / wallSeconds : 0.0; }
+    };
+
+    // 加载时的内存按文件大小的这个倍数估算（轨道、合并事件流、音符表和定位索引合计）
+    static constexpr int memoryPerFileByte = 12;
+
+    // 目录时递归查找 .mid / .midi / .smf 文件（按路径排序）；否则当作文件列表，每行一个路径，
+    // 相对路径相对于列表所在的目录，空行和 # 开头的行被忽略
+    static juce::Array<juce::File> collectFiles(const juce::File& directoryOrList);
+
+    // 加载所有文件，results 与 files 的顺序相同
+    static Summary run(const juce::Array<juce::File>& files, const Options& options, std::vector<FileResult>& results);
+
+    // 每个文件一行的CSV，失败时返回 false 并设置 error
+    static bool writeCsv(const std::vector<FileResult>& results, const juce::File& output, juce::String& error);
+
+    // { "summary": {...}, "files": [...] }
+    static juce::var toVar(const Summary& summary, const std::vector<FileResult>& results);
+    static juce::var toVar(const Summary& summary);
+};
+
+#endif //CANDYJAR_BATCHANALYZER_H
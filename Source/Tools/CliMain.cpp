@@ -0,0 +1,205 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+// CandyJarCli：不带界面的解析工具，加载MIDI文件并以JSON输出统计信息
+// 用法：CandyJarCli <file.mid> [--threads N] [--cache] [--strict] [--compress] [--report] [--trace trace.json]
+//   --cache     使用解析结果缓存（写在用户数据目录下，不会自动清理）
+//   --strict    关闭恢复模式，文件有任何格式错误都加载失败
+//   --compress  轨道事件压缩存储（报告中的 trackEventBytes 为压缩后的大小）
+//   --report    在输出中加上各阶段的耗时报告
+//   --trace     记录线程池中的每个任务，并把跟踪写成 Chrome 跟踪格式（chrome://tracing 或 Perfetto 打开）
+//
+// 过滤选项（两种模式都可以用，被过滤的事件在解码时跳过）：
+//   --events noteOn,noteOff,...  只保留这些事件类型（noteOff noteOn polyAftertouch controlChange programChange
+//                                channelPressure pitchBend metaSysex，notes 表示 noteOn + noteOff）
+//   --channels 1,10              只保留这些通道（1-16）的通道消息
+//   --tracks A-B                 只保留第 A 到第 B 个轨道（从0开始，"A-" 表示到最后）
+//   --min-velocity N             丢弃力度低于 N 的音符
+//
+// 批量模式：CandyJarCli --batch <目录|文件列表> [--threads N] [--memory-budget MB] [--cache] [--strict]
+//                       [--compress] [--csv out.csv] [--json out.json]
+//   在一个共享线程池上加载所有文件，同时加载的文件数由内存预算（默认 2048 MB）决定，
+//   标准输出是汇总（文件数/秒和吞吐量），每个文件的统计信息或错误写到 --csv / --json
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../MidiParser/MidiParser.h"
+#include "StatisticsJson.h"
+#include "BatchAnalyzer.h"
+#include <iostream>
+
+static MidiLoadOptions parseLoadOptions(const juce::StringArray& arguments)
+{
+    MidiLoadOptions options;
+
+    const int eventsIndex = arguments.indexOf("--events");
+    if (eventsIndex >= 0)
+    {
+        static const char* const eventTypeNames[8] = { "noteOff", "noteOn", "polyAftertouch", "controlChange",
+                                                       "programChange", "channelPressure", "pitchBend", "metaSysex" };
+        options.eventTypes = 0;
+
+        for (const auto& name : juce::StringArray::fromTokens(arguments[eventsIndex + 1], ",", ""))
+        {
+            if (name == "notes")
+                options.eventTypes |= MidiLoadOptions::notes;
+
+            for (int i = 0; i < 8; ++i)
+                if (name == eventTypeNames[i])
+                    options.eventTypes |= 1u << i;
+        }
+    }
+
+    const int channelsIndex = arguments.indexOf("--channels");
+    if (channelsIndex >= 0)
+    {
+        options.channelMask = 0;
+
+        for (const auto& channel : juce::StringArray::fromTokens(arguments[channelsIndex + 1], ",", ""))
+            if (channel.getIntValue() >= 1 && channel.getIntValue() <= 16)
+                options.channelMask |= (uint16_t) (1 << (channel.getIntValue() - 1));
+    }
+
+    const int tracksIndex = arguments.indexOf("--tracks");
+    if (tracksIndex >= 0)
+    {
+        const juce::String range = arguments[tracksIndex + 1].trim();
+        options.firstTrack = range.upToFirstOccurrenceOf("-", false, false).getIntValue();
+
+        if (!range.containsChar('-'))
+            options.lastTrack = options.firstTrack;
+        else if (!range.endsWithChar('-'))
+            options.lastTrack = range.fromFirstOccurrenceOf("-", false, false).getIntValue();
+    }
+
+    const int velocityIndex = arguments.indexOf("--min-velocity");
+    if (velocityIndex >= 0)
+        options.minVelocity = arguments[velocityIndex + 1].getIntValue();
+
+    return options;
+}
+
+static int runBatch(const juce::StringArray& arguments, int batchIndex)
+{
+    const juce::File input = juce::File::getCurrentWorkingDirectory().getChildFile(arguments[batchIndex + 1]);
+
+    if (!input.exists())
+    {
+        std::cerr << "Not found: " << input.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    BatchAnalyzer::Options options;
+    options.useCache = arguments.contains("--cache");
+    options.recovery = !arguments.contains("--strict");
+    options.compressTracks = arguments.contains("--compress");
+    options.loadOptions = parseLoadOptions(arguments);
+
+    const int threadsIndex = arguments.indexOf("--threads");
+    if (threadsIndex >= 0)
+        options.numThreads = arguments[threadsIndex + 1].getIntValue();
+
+    const int budgetIndex = arguments.indexOf("--memory-budget");
+    if (budgetIndex >= 0)
+        options.memoryBudgetBytes = arguments[budgetIndex + 1].getLargeIntValue() << 20;
+
+    std::vector<BatchAnalyzer::FileResult> results;
+    const BatchAnalyzer::Summary summary = BatchAnalyzer::run(BatchAnalyzer::collectFiles(input), options, results);
+
+    bool written = true;
+
+    const int csvIndex = arguments.indexOf("--csv");
+    if (csvIndex >= 0)
+    {
+        juce::String error;
+        if (!BatchAnalyzer::writeCsv(results, juce::File::getCurrentWorkingDirectory().getChildFile(arguments[csvIndex + 1]), error))
+        {
+            std::cerr << error << std::endl;
+            written = false;
+        }
+    }
+
+    const int jsonIndex = arguments.indexOf("--json");
+    if (jsonIndex >= 0)
+    {
+        const juce::File jsonFile = juce::File::getCurrentWorkingDirectory().getChildFile(arguments[jsonIndex + 1]);
+
+        if (!jsonFile.replaceWithText(juce::JSON::toString(BatchAnalyzer::toVar(summary, results))))
+        {
+            std::cerr << "Cannot write " << jsonFile.getFullPathName() << std::endl;
+            written = false;
+        }
+    }
+
+    std::cout << juce::JSON::toString(BatchAnalyzer::toVar(summary)) << std::endl;
+    return written && summary.failed == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    juce::StringArray arguments;
+    for (int i = 1; i < argc; ++i)
+        arguments.add(juce::String::fromUTF8(argv[i]));
+
+    const int batchIndex = arguments.indexOf("--batch");
+    if (batchIndex >= 0 && batchIndex + 1 < arguments.size())
+        return runBatch(arguments, batchIndex);
+
+    if (arguments.isEmpty() || arguments[0].startsWith("--"))
+    {
+        std::cerr << "Usage: CandyJarCli <file.mid> [--threads N] [--cache] [--strict] [--compress] [--report] [--trace trace.json]\n"
+                  << "       [--events a,b,...] [--channels 1,10,...] [--tracks A-B] [--min-velocity N]\n"
+                  << "       CandyJarCli --batch <directory|list.txt> [--threads N] [--memory-budget MB] [--cache] [--strict] "
+                  << "[--compress] [--csv out.csv] [--json out.json]" << std::endl;
+        return 1;
+    }
+
+    const juce::File file = juce::File::getCurrentWorkingDirectory().getChildFile(arguments[0]);
+
+    MidiParser parser;
+    const int threadsIndex = arguments.indexOf("--threads");
+    if (threadsIndex >= 0)
+        parser.setNumThreads(arguments[threadsIndex + 1].getIntValue());
+
+    parser.setCacheEnabled(arguments.contains("--cache"));
+    parser.setRecoveryEnabled(!arguments.contains("--strict"));
+    parser.setCompressedTracks(arguments.contains("--compress"));
+
+    const int traceIndex = arguments.indexOf("--trace");
+    parser.setTracingEnabled(traceIndex >= 0);
+
+    const double startTime = juce::Time::getMillisecondCounterHiRes();
+    const bool loaded = parser.loadMidiFile(file, parseLoadOptions(arguments));
+    const double loadSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+
+    juce::DynamicObject::Ptr result = new juce::DynamicObject();
+    result->setProperty("file", file.getFullPathName());
+    result->setProperty("bytes", file.getSize());
+    result->setProperty("ok", loaded);
+
+    if (loaded)
+    {
+        result->setProperty("loadSeconds", loadSeconds);
+        result->setProperty("fromCache", parser.isLoadedFromCache());
+        result->setProperty("peakRssBytes", StatisticsJson::getPeakResidentBytes());
+        result->setProperty("statistics", StatisticsJson::toVar(parser.getStatistics()));
+    }
+    else
+    {
+        result->setProperty("error", parser.getLastErrorMessage());
+    }
+
+    if (arguments.contains("--report"))
+        result->setProperty("report", StatisticsJson::toVar(parser.getLoadReport()));
+
+    if (traceIndex >= 0)
+    {
+        const juce::File traceFile = juce::File::getCurrentWorkingDirectory().getChildFile(arguments[traceIndex + 1]);
+
+        if (!parser.getLoadReport().writeChromeTrace(traceFile))
+            std::cerr << "Cannot write trace: " << traceFile.getFullPathName() << std::endl;
+    }
+
+    std::cout << juce::JSON::toString(result.get()) << std::endl;
+    return loaded ? 0 : 1;
+}
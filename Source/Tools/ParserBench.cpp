@@ -0,0 +1,621 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+// CandyJarBench：解析器基准测试
+// 生成确定性的合成SMF文件（或使用 --input 指定的文件），重复测量并以JSON输出结果
+//
+// 用法：CandyJarBench [--tracks N] [--events N | --size-mb N] [--density N] [--tempo-changes N]
+//                     [--seed N] [--no-running-status] [--iterations N] [--threads N]
+//                     [--input file.mid] [--output result.json] [--keep] [--voices N]
+//
+// 测量项目：
+//  - load：完整的 MidiParser::loadMidiFile（映射、解码、配对、统计、合并），不使用缓存
+//  - cachedLoad：从解析结果缓存重新打开同一个文件
+//  - decode：单线程 SmfDecoder::decodeTrack 解码全部轨道
+//  - referenceDecode：同样的解码用逐字节判断状态的参考实现（查表分派之前的解码循环），
+//    decodeSpeedup 是两者中位数之比，decodeMatchesReference 检查两者的解码结果逐项相同
+//  - statistics：单线程 StatisticsKernel 扫描全部轨道（加载时不再有这一遍，计数在解码时累加），
+//    statisticsMatchDecode 检查扫描结果与解码时累加的计数相同
+//  - compressedTracks：把解码结果按块压缩（MidiParser::setCompressedTracks 的存储方式），
+//    输出压缩前后的字节数、压缩用时，以及用 TrackEventReader 顺序扫描全部事件（累加tick）
+//    在未压缩和压缩两种存储上的吞吐量；compressedMatchesDecode 检查解压结果逐项相同
+//  - synth：--voices 个（默认20000）同时按住的音符，SynthEngine 按音频回调的块大小渲染，
+//    不用和用辅助渲染线程各测一次，输出每秒渲染的发声体采样数（voiceSamplesPerSecond）、
+//    最慢一块的用时和块时长（blockDeadlineSeconds），以及按吞吐量估算的实时播放时能同时发声的数量；
+//    renderThreadsMatch 检查两次渲染结果逐位相同
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../MidiParser/MidiParser.h"
+#include "../Audio/SynthEngine.h"
+#include "SyntheticMidi.h"
+#include "StatisticsJson.h"
+#include "StatisticsKernel.h"
+#include <algorithm>
+#include <iostream>
+
+// 多次测量的耗时汇总
+static juce::var summarise(std::vector<double> seconds, juce::int64 numEvents)
+{
+    std::sort(seconds.begin(), seconds.end());
+
+    double total = 0.0;
+    for (double value : seconds)
+        total += value;
+
+    const double median = seconds[seconds.size() / 2];
+
+    juce::DynamicObject::Ptr object = new juce::DynamicObject();
+    object->setProperty("minSeconds", seconds.front());
+    object->setProperty("medianSeconds", median);
+    object->setProperty("meanSeconds", total / (double) seconds.size());
+    object->setProperty("maxSeconds", seconds.back());
+    object->setProperty("eventsPerSecond", median > 0.0 ? (double) numEvents / median : 0.0);
+    return object.get();
+}
+
+static juce::int64 getIntArgument(const juce::StringArray& arguments, const juce::String& name, juce::int64 defaultValue)
+{
+    const int index = arguments.indexOf(name);
+    return index >= 0 && index + 1 < arguments.size() ? arguments[index + 1].getLargeIntValue() : defaultValue;
+}
+
+static juce::String getStringArgument(const juce::StringArray& arguments, const juce::String& name)
+{
+    const int index = arguments.indexOf(name);
+    return index >= 0 && index + 1 < arguments.size() ? arguments[index + 1] : juce::String();
+}
+
+// 参考解码器：查表分派之前的 SmfDecoder::decodeTrack（严格模式，不发布进度），只用于对比吞吐量和结果
+static bool referenceDecodeTrack(const uint8_t* fileBase, const uint8_t* data, size_t size, MidiTrackEvents& track, Arena& arena,
+                                 juce::String& error)
+{
+    track.metaBase = fileBase;
+
+    const uint8_t* pos = data;
+    const uint8_t* const end = data + size;
+
+    track.reserve(arena, track.size() + size / 3 + 1, track.metaEvents.size() + 16);
+
+    uint64_t tick = track.totalTicks;
+    uint8_t runningStatus = 0;
+
+    while (pos < end)
+    {
+        uint32_t delta = 0;
+        if (!SmfDecoder::readVariableLength(pos, end, delta) || pos >= end)
+        {
+            error = "Truncated event";
+            return false;
+        }
+
+        tick += delta;
+
+        uint8_t statusByte = *pos;
+
+        if (statusByte >= 0x80)
+            ++pos;
+        else if (runningStatus != 0)
+            statusByte = runningStatus;
+        else
+        {
+            error = "Data byte without running status";
+            return false;
+        }
+
+        if (statusByte < 0xF0)
+        {
+            runningStatus = statusByte;
+            const int numDataBytes = ((statusByte & 0xE0) == 0xC0) ? 1 : 2;
+
+            if (end - pos < numDataBytes)
+            {
+                error = "Truncated channel message";
+                return false;
+            }
+
+            const uint8_t d1 = pos[0] & 0x7F;
+            const uint8_t d2 = numDataBytes == 2 ? (pos[1] & 0x7F) : 0;
+            pos += numDataBytes;
+
+            track.deltaTicks.push_back(delta);
+            track.status.push_back(statusByte);
+            track.data1.push_back(d1);
+            track.data2.push_back(d2);
+
+            ++track.counts.eventTypes[(statusByte >> 4) & 7];
+            if (isNoteOnEvent(statusByte, d2))
+                ++track.counts.channelNotes[statusByte & 0x0F];
+
+            continue;
+        }
+
+        uint8_t metaType = 0;
+        if (statusByte == 0xFF)
+        {
+            if (pos >= end)
+            {
+                error = "Truncated meta event";
+                return false;
+            }
+
+            metaType = *pos++;
+        }
+        else if (statusByte != 0xF0 && statusByte != 0xF7)
+        {
+            error = "Unexpected status byte: " + juce::String((int) statusByte);
+            return false;
+        }
+
+        uint32_t length = 0;
+        if (!SmfDecoder::readVariableLength(pos, end, length) || (size_t) (end - pos) < length)
+        {
+            error = "Truncated meta/sysex event";
+            return false;
+        }
+
+        MetaEventRef meta;
+        meta.tick = tick;
+        meta.eventIndex = (uint32_t) track.size();
+        meta.length = length;
+        meta.dataOffset = (uint64_t) (pos - fileBase);
+        meta.type = metaType;
+        track.metaEvents.push_back(meta);
+        pos += length;
+
+        track.deltaTicks.push_back(delta);
+        track.status.push_back(statusByte);
+        track.data1.push_back(metaType);
+        track.data2.push_back(0);
+        ++track.counts.eventTypes[7];
+
+        if (statusByte == 0xFF && metaType == 0x2F)
+            break;
+    }
+
+    track.totalTicks = tick;
+    return true;
+}
+
+// 两次解码的结果是否逐项相同（a 必须是未压缩的）
+static bool tracksMatch(const std::vector<MidiTrackEvents>& a, const std::vector<MidiTrackEvents>& b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        const MidiTrackEvents& x = a[i];
+        const MidiTrackEvents& y = b[i];
+
+        if (x.size() != y.size() || x.metaEvents.size() != y.metaEvents.size() || x.totalTicks != y.totalTicks
+            || !std::equal(std::begin(x.counts.eventTypes), std::end(x.counts.eventTypes), std::begin(y.counts.eventTypes))
+            || !std::equal(std::begin(x.counts.channelNotes), std::end(x.counts.channelNotes), std::begin(y.counts.channelNotes)))
+            return false;
+
+        // y 可能是压缩存储的，逐段读出来比较
+        TrackEventReader reader(y);
+        TrackEventSpan span;
+
+        while (reader.next(span))
+        {
+            const size_t first = span.firstEvent;
+
+            if (!std::equal(span.deltaTicks, span.deltaTicks + span.numEvents, x.deltaTicks.begin() + first)
+                || !std::equal(span.status, span.status + span.numEvents, x.status.begin() + first)
+                || !std::equal(span.data1, span.data1 + span.numEvents, x.data1.begin() + first)
+                || !std::equal(span.data2, span.data2 + span.numEvents, x.data2.begin() + first))
+                return false;
+        }
+
+        for (size_t j = 0; j < x.metaEvents.size(); ++j)
+            if (x.metaEvents[j].tick != y.metaEvents[j].tick || x.metaEvents[j].dataOffset != y.metaEvents[j].dataOffset
+                || x.metaEvents[j].length != y.metaEvents[j].length || x.metaEvents[j].eventIndex != y.metaEvents[j].eventIndex)
+                return false;
+    }
+
+    return true;
+}
+
+// 顺序读出所有轨道的全部事件，返回 tick 和各字节的校验和，防止循环被优化掉
+static uint64_t scanTracks(const std::vector<MidiTrackEvents>& tracks)
+{
+    uint64_t checksum = 0;
+
+    for (const auto& track : tracks)
+    {
+        TrackEventReader reader(track);
+        TrackEventSpan span;
+        uint64_t tick = 0;
+        uint32_t bytes = 0;
+
+        while (reader.next(span))
+        {
+            for (size_t i = 0; i < span.numEvents; ++i)
+            {
+                tick += span.deltaTicks[i];
+                bytes += span.status[i] + span.data1[i] + span.data2[i];
+            }
+        }
+
+        checksum += tick + bytes;
+    }
+
+    return checksum;
+}
+
+// 单线程解码整个文件的所有MTrk块，返回事件总数，失败时返回 -1
+// 先重置 arena，和解析器一样每次都复用上一次的内存；useReference 时使用参考解码器
+static juce::int64 decodeAllTracks(const juce::MemoryBlock& fileData, std::vector<MidiTrackEvents>& tracks, Arena& arena,
+                                   bool useReference = false)
+{
+    const uint8_t* data = static_cast<const uint8_t*>(fileData.getData());
+    const size_t size = fileData.getSize();
+    SmfHeader header;
+    juce::String error;
+
+    if (size < (size_t) SmfDecoder::headerChunkSize || !SmfDecoder::readHeader(data, size, header, error))
+        return -1;
+
+    for (auto& track : tracks)
+        track.clear();
+
+    arena.reset();
+
+    juce::int64 numEvents = 0;
+    size_t position = SmfDecoder::chunkHeaderSize + header.headerLength;
+    size_t trackIndex = 0;
+
+    while (position + SmfDecoder::chunkHeaderSize <= size)
+    {
+        uint32_t chunkLength = 0;
+        const bool isTrackChunk = SmfDecoder::readChunkHeader(data + position, "MTrk", chunkLength);
+        position += SmfDecoder::chunkHeaderSize;
+        chunkLength = (uint32_t) std::min((size_t) chunkLength, size - position);
+
+        if (isTrackChunk)
+        {
+            if (trackIndex >= tracks.size())
+                tracks.emplace_back();
+
+            MidiTrackEvents& track = tracks[trackIndex++];
+
+            const bool decoded = useReference ? referenceDecodeTrack(data, data + position, chunkLength, track, arena, error)
+                                              : SmfDecoder::decodeTrack(data, data + position, chunkLength, track, arena, error);
+
+            if (!decoded)
+                return -1;
+
+            numEvents += (juce::int64) track.size();
+        }
+
+        position += chunkLength;
+    }
+
+    tracks.resize(trackIndex);
+    return numEvents;
+}
+
+int main(int argc, char* argv[])
+{
+    juce::StringArray arguments;
+    for (int i = 1; i < argc; ++i)
+        arguments.add(juce::String::fromUTF8(argv[i]));
+
+    const int iterations = (int) juce::jmax((juce::int64) 1, getIntArgument(arguments, "--iterations", 5));
+    const int numThreads = (int) getIntArgument(arguments, "--threads", 0);
+
+    // 准备输入文件
+    juce::DynamicObject::Ptr input = new juce::DynamicObject();
+    juce::File midiFile;
+    bool deleteAfterwards = false;
+
+    if (arguments.contains("--input"))
+    {
+        midiFile = juce::File::getCurrentWorkingDirectory().getChildFile(getStringArgument(arguments, "--input"));
+        input->setProperty("synthetic", false);
+    }
+    else
+    {
+        SyntheticMidiOptions options;
+        options.numTracks = (int) juce::jlimit((juce::int64) 1, (juce::int64) 65535, getIntArgument(arguments, "--tracks", options.numTracks));
+        options.eventsPerTrack = getIntArgument(arguments, "--events", options.eventsPerTrack);
+        options.eventsPerBeat = (int) getIntArgument(arguments, "--density", options.eventsPerBeat);
+        options.tempoChanges = (int) getIntArgument(arguments, "--tempo-changes", options.tempoChanges);
+        options.seed = getIntArgument(arguments, "--seed", options.seed);
+        options.runningStatus = !arguments.contains("--no-running-status");
+
+        if (arguments.contains("--size-mb"))
+            options.setTargetSize(getIntArgument(arguments, "--size-mb", 0) * 1024 * 1024);
+
+        midiFile = juce::File::createTempFile(".mid");
+        deleteAfterwards = !arguments.contains("--keep");
+
+        const double generateStart = juce::Time::getMillisecondCounterHiRes();
+
+        if (!SyntheticMidi::write(midiFile, options))
+        {
+            std::cerr << "Cannot write " << midiFile.getFullPathName() << std::endl;
+            return 1;
+        }
+
+        input->setProperty("synthetic", true);
+        input->setProperty("tracks", options.numTracks);
+        input->setProperty("eventsPerTrack", options.eventsPerTrack);
+        input->setProperty("eventsPerBeat", options.eventsPerBeat);
+        input->setProperty("tempoChanges", options.tempoChanges);
+        input->setProperty("runningStatus", options.runningStatus);
+        input->setProperty("seed", options.seed);
+        input->setProperty("generateSeconds", (juce::Time::getMillisecondCounterHiRes() - generateStart) / 1000.0);
+    }
+
+    input->setProperty("file", midiFile.getFullPathName());
+    input->setProperty("bytes", midiFile.getSize());
+
+    juce::DynamicObject::Ptr result = new juce::DynamicObject();
+    result->setProperty("input", input.get());
+    result->setProperty("iterations", iterations);
+    result->setProperty("threads", numThreads > 0 ? numThreads : juce::SystemStats::getNumCpus());
+    result->setProperty("baselineRssBytes", StatisticsJson::getPeakResidentBytes());
+
+    bool ok = true;
+
+    // load：每次使用新的解析器，包含线程池创建等全部开销
+    {
+        std::vector<double> seconds;
+        MidiStatistics statistics;
+
+        for (int i = 0; i < iterations && ok; ++i)
+        {
+            MidiParser parser;
+            parser.setNumThreads(numThreads);
+            parser.setCacheEnabled(false);
+
+            const double start = juce::Time::getMillisecondCounterHiRes();
+            ok = parser.loadMidiFile(midiFile);
+            seconds.push_back((juce::Time::getMillisecondCounterHiRes() - start) / 1000.0);
+
+            if (!ok)
+                result->setProperty("error", parser.getLastErrorMessage());
+
+            statistics = parser.getStatistics();
+        }
+
+        if (ok)
+        {
+            juce::var load = summarise(seconds, statistics.totalEvents);
+            load.getDynamicObject()->setProperty("bytesPerSecond", (double) midiFile.getSize() / (double) load["medianSeconds"]);
+            load.getDynamicObject()->setProperty("peakRssBytes", StatisticsJson::getPeakResidentBytes());
+            result->setProperty("load", load);
+            result->setProperty("statistics", StatisticsJson::toVar(statistics));
+        }
+    }
+
+    // cachedLoad：第一次加载写入临时目录中的缓存，之后每次都直接映射缓存
+    if (ok)
+    {
+        const juce::File cacheDirectory = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                                              .getChildFile("CandyJarBenchCache");
+        std::vector<double> seconds;
+        juce::int64 numEvents = 0;
+
+        for (int i = 0; i <= iterations && ok; ++i)
+        {
+            MidiParser parser;
+            parser.setNumThreads(numThreads);
+            parser.setCacheEnabled(true);
+            parser.setCacheDirectory(cacheDirectory);
+
+            const double start = juce::Time::getMillisecondCounterHiRes();
+            ok = parser.loadMidiFile(midiFile);
+            const double elapsed = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+            if (i == 0)
+                result->setProperty("cacheWriteLoadSeconds", elapsed);
+            else
+                seconds.push_back(elapsed);
+
+            if (i > 0 && !parser.isLoadedFromCache())
+                ok = false;
+
+            numEvents = parser.getStatistics().totalEvents;
+        }
+
+        IndexCache::getCacheFile(midiFile, cacheDirectory).deleteFile();
+
+        if (ok)
+            result->setProperty("cachedLoad", summarise(seconds, numEvents));
+        else
+            result->setProperty("error", "Cached load failed");
+    }
+
+    // decode 和 statistics：单线程，反映内层循环本身的吞吐量
+    if (ok)
+    {
+        juce::MemoryBlock fileData;
+        midiFile.loadFileAsData(fileData);
+
+        Arena arena, referenceArena, compressedArena;
+        std::vector<MidiTrackEvents> tracks, referenceTracks, compressedTracks;
+        std::vector<double> decodeSeconds, referenceSeconds, statisticsSeconds;
+        std::vector<double> compressSeconds, scanSeconds, compressedScanSeconds;
+        bool scansMatch = true;
+        bool countsMatch = true;
+        juce::int64 numEvents = 0;
+
+        for (int i = 0; i < iterations && ok; ++i)
+        {
+            // 两个解码器交替运行，受机器状态的影响相同
+            const double referenceStart = juce::Time::getMillisecondCounterHiRes();
+            const juce::int64 numReferenceEvents = decodeAllTracks(fileData, referenceTracks, referenceArena, true);
+            referenceSeconds.push_back((juce::Time::getMillisecondCounterHiRes() - referenceStart) / 1000.0);
+
+            const double decodeStart = juce::Time::getMillisecondCounterHiRes();
+            numEvents = decodeAllTracks(fileData, tracks, arena);
+            decodeSeconds.push_back((juce::Time::getMillisecondCounterHiRes() - decodeStart) / 1000.0);
+            ok = numEvents >= 0 && numReferenceEvents == numEvents;
+
+            EventCounts counts;
+            const double statisticsStart = juce::Time::getMillisecondCounterHiRes();
+
+            for (const auto& track : tracks)
+                StatisticsKernel::countEvents(track.status.data(), track.data2.data(), track.size(), counts);
+
+            statisticsSeconds.push_back((juce::Time::getMillisecondCounterHiRes() - statisticsStart) / 1000.0);
+
+            EventCounts decodedCounts;
+            for (const auto& track : tracks)
+                decodedCounts += track.counts;
+
+            countsMatch = countsMatch
+                && std::equal(std::begin(counts.eventTypes), std::end(counts.eventTypes), std::begin(decodedCounts.eventTypes))
+                && std::equal(std::begin(counts.channelNotes), std::end(counts.channelNotes), std::begin(decodedCounts.channelNotes));
+
+            // 轨道结构是浅复制，compress() 只清空副本的四列
+            compressedArena.reset();
+            compressedTracks = tracks;
+            const double compressStart = juce::Time::getMillisecondCounterHiRes();
+
+            for (auto& track : compressedTracks)
+                track.compress(compressedArena);
+
+            compressSeconds.push_back((juce::Time::getMillisecondCounterHiRes() - compressStart) / 1000.0);
+
+            const double scanStart = juce::Time::getMillisecondCounterHiRes();
+            const uint64_t checksum = scanTracks(tracks);
+            scanSeconds.push_back((juce::Time::getMillisecondCounterHiRes() - scanStart) / 1000.0);
+
+            const double compressedScanStart = juce::Time::getMillisecondCounterHiRes();
+            scansMatch = scansMatch && scanTracks(compressedTracks) == checksum;
+            compressedScanSeconds.push_back((juce::Time::getMillisecondCounterHiRes() - compressedScanStart) / 1000.0);
+        }
+
+        if (ok)
+        {
+            const juce::var decode = summarise(decodeSeconds, numEvents);
+            const juce::var referenceDecode = summarise(referenceSeconds, numEvents);
+
+            result->setProperty("decode", decode);
+            result->setProperty("referenceDecode", referenceDecode);
+            result->setProperty("decodeSpeedup", (double) referenceDecode["medianSeconds"] / (double) decode["medianSeconds"]);
+            result->setProperty("decodeMatchesReference", tracksMatch(tracks, referenceTracks));
+            result->setProperty("statisticsPass", summarise(statisticsSeconds, numEvents));
+            result->setProperty("statisticsMatchDecode", countsMatch);
+
+            juce::int64 rawBytes = 0, compressedBytes = 0;
+            for (size_t i = 0; i < tracks.size(); ++i)
+            {
+                rawBytes += (juce::int64) tracks[i].getEventBytes();
+                compressedBytes += (juce::int64) compressedTracks[i].getEventBytes();
+            }
+
+            juce::DynamicObject::Ptr compressed = new juce::DynamicObject();
+            compressed->setProperty("rawBytes", rawBytes);
+            compressed->setProperty("compressedBytes", compressedBytes);
+            compressed->setProperty("ratio", compressedBytes > 0 ? (double) rawBytes / (double) compressedBytes : 0.0);
+            compressed->setProperty("compress", summarise(compressSeconds, numEvents));
+            compressed->setProperty("rawScan", summarise(scanSeconds, numEvents));
+            compressed->setProperty("compressedScan", summarise(compressedScanSeconds, numEvents));
+            result->setProperty("compressedTracks", compressed.get());
+            result->setProperty("compressedMatchesDecode", scansMatch && tracksMatch(tracks, compressedTracks));
+        }
+        else
+        {
+            result->setProperty("error", "Decode failed");
+        }
+    }
+
+    // synth：单线程和辅助线程的渲染吞吐量
+    if (ok)
+    {
+        const int numVoices = (int) juce::jlimit((juce::int64) 1, (juce::int64) 1000000, getIntArgument(arguments, "--voices", 20000));
+        const double sampleRate = 48000.0;
+        const int blockSize = 512;
+        const int numBlocks = (int) (2.0 * sampleRate) / blockSize;
+
+        const juce::File chordFile = juce::File::createTempFile(".mid");
+        MidiParser parser;
+        parser.setNumThreads(1);
+        ok = SyntheticMidi::writeChord(chordFile, numVoices, 16) && parser.loadMidiFile(chordFile);
+        chordFile.deleteFile();
+
+        if (ok)
+        {
+            juce::DynamicObject::Ptr synth = new juce::DynamicObject();
+            synth->setProperty("voices", numVoices);
+            synth->setProperty("sampleRate", sampleRate);
+            synth->setProperty("blockSize", blockSize);
+            synth->setProperty("blockDeadlineSeconds", blockSize / sampleRate);
+
+            std::vector<float> outputs[2];
+            bool threadsUsed = false;
+
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                SynthEngine engine(juce::jmax(SynthEngine::defaultMaxVoices, numVoices));
+                engine.prepare(sampleRate);
+                engine.setSong(&parser.getMergedEvents(), &parser.getTempoMap());
+
+                if (pass == 1)
+                    engine.startRenderThreads(numThreads > 0 ? numThreads - 1 : -1);
+
+                // 第一块处理所有 Note On 并度过起音，不计时
+                outputs[pass].resize((size_t) (numBlocks + 1) * blockSize);
+                float* channels[1] = { outputs[pass].data() };
+                engine.render(channels, 1, blockSize);
+
+                const int numActive = engine.getNumActiveVoices();
+                std::vector<double> blockSeconds;
+
+                for (int block = 1; block <= numBlocks; ++block)
+                {
+                    channels[0] = outputs[pass].data() + (size_t) block * blockSize;
+                    const double start = juce::Time::getMillisecondCounterHiRes();
+                    engine.render(channels, 1, blockSize);
+                    blockSeconds.push_back((juce::Time::getMillisecondCounterHiRes() - start) / 1000.0);
+                }
+
+                double totalSeconds = 0.0;
+                for (double seconds : blockSeconds)
+                    totalSeconds += seconds;
+
+                const double voiceSamplesPerSecond = (double) numActive * numBlocks * blockSize / totalSeconds;
+
+                juce::DynamicObject::Ptr run = new juce::DynamicObject();
+                run->setProperty("renderThreads", engine.getNumRenderThreads());
+                run->setProperty("activeVoices", numActive);
+                run->setProperty("voiceSamplesPerSecond", voiceSamplesPerSecond);
+                run->setProperty("realtimeFactor", numBlocks * blockSize / sampleRate / totalSeconds);
+                run->setProperty("medianBlockSeconds", (double) summarise(blockSeconds, 0)["medianSeconds"]);
+                run->setProperty("maxBlockSeconds", *std::max_element(blockSeconds.begin(), blockSeconds.end()));
+                run->setProperty("maxVoicesAtRealtime", voiceSamplesPerSecond / sampleRate);
+                synth->setProperty(pass == 0 ? "singleThread" : "renderThreads", run.get());
+
+                threadsUsed = threadsUsed || engine.getNumRenderThreads() > 0;
+            }
+
+            synth->setProperty("renderThreadsMatch", outputs[0] == outputs[1]);
+            synth->setProperty("renderThreadsUsed", threadsUsed);
+            result->setProperty("synth", synth.get());
+        }
+        else
+        {
+            result->setProperty("error", "Synth setup failed");
+        }
+    }
+
+    result->setProperty("ok", ok);
+    result->setProperty("peakRssBytes", StatisticsJson::getPeakResidentBytes());
+
+    if (deleteAfterwards)
+        midiFile.deleteFile();
+
+    const juce::String json = juce::JSON::toString(result.get());
+    const juce::String outputPath = getStringArgument(arguments, "--output");
+
+    if (outputPath.isNotEmpty())
+        juce::File::getCurrentWorkingDirectory().getChildFile(outputPath).replaceWithText(json);
+
+    std::cout << json << std::endl;
+    return ok ? 0 : 1;
+}
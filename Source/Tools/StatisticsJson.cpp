@@ -0,0 +1,116 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "StatisticsJson.h"
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+ #include <psapi.h>
+#else
+ #include <sys/resource.h>
+#endif
+
+juce::var StatisticsJson::toVar(const MidiStatistics& statistics)
+{
+    static const char* const eventTypeNames[8] = { "noteOff", "noteOn", "polyAftertouch", "controlChange",
+                                                   "programChange", "channelPressure", "pitchBend", "metaSysex" };
+
+    juce::DynamicObject::Ptr object = new juce::DynamicObject();
+    object->setProperty("tracks", statistics.totalTracks);
+    object->setProperty("events", statistics.totalEvents);
+    object->setProperty("notes", statistics.totalNotes);
+    object->setProperty("durationSeconds", statistics.totalDuration);
+    object->setProperty("ticks", statistics.totalTicks);
+    object->setProperty("tempoChanges", statistics.tempoChanges);
+    object->setProperty("fileType", statistics.fileType);
+    object->setProperty("timeFormat", statistics.timeFormat);
+    object->setProperty("maxPolyphony", statistics.maxPolyphony);
+    object->setProperty("repairedAnomalies", statistics.repairedAnomalies);
+
+    juce::DynamicObject::Ptr eventTypes = new juce::DynamicObject();
+    for (int i = 0; i < 8; ++i)
+        eventTypes->setProperty(eventTypeNames[i], statistics.eventTypeCounts[i]);
+    object->setProperty("eventTypes", eventTypes.get());
+
+    juce::Array<juce::var> channelNotes;
+    for (int i = 0; i < 16; ++i)
+        channelNotes.add(statistics.channelNoteCounts[i]);
+    object->setProperty("channelNotes", channelNotes);
+
+    return object.get();
+}
+
+juce::var StatisticsJson::toVar(const LoadReport& report)
+{
+    juce::DynamicObject::Ptr object = new juce::DynamicObject();
+    object->setProperty("totalSeconds", report.getTotalSeconds());
+    object->setProperty("result", LoadProgress::getPhaseName(report.result));
+    object->setProperty("fromCache", report.fromCache);
+
+    juce::DynamicObject::Ptr phases = new juce::DynamicObject();
+    for (int phase = 0; phase < LoadReport::numPhases; ++phase)
+        if (report.phaseNanoseconds[phase] > 0)
+            phases->setProperty(LoadProgress::getPhaseName((LoadPhase) phase), report.getPhaseSeconds((LoadPhase) phase));
+    object->setProperty("phaseSeconds", phases.get());
+
+    juce::DynamicObject::Ptr steps = new juce::DynamicObject();
+    for (const auto& span : report.spans)
+        if (juce::String(span.category) == "step")
+            steps->setProperty(span.name, (double) span.durationNanoseconds * 1.0e-9);
+    object->setProperty("stepSeconds", steps.get());
+
+    object->setProperty("fileBytes", (juce::int64) report.fileBytes);
+    object->setProperty("trackBytes", (juce::int64) report.trackBytes);
+    object->setProperty("eventsDecoded", (juce::int64) report.eventsDecoded);
+    object->setProperty("eventsMerged", (juce::int64) report.eventsMerged);
+    object->setProperty("trackEventBytes", (juce::int64) report.trackEventBytes);
+    object->setProperty("compressedTracks", report.compressedTracks);
+    object->setProperty("arenaAllocations", (juce::int64) report.arenaAllocations);
+    object->setProperty("arenaBytesAllocated", (juce::int64) report.arenaBytesAllocated);
+    object->setProperty("arenaMappings", (juce::int64) report.arenaMappings);
+    object->setProperty("arenaBytesMapped", (juce::int64) report.arenaBytesMapped);
+
+    juce::Array<juce::var> workers;
+    for (const auto& activity : report.workers)
+    {
+        juce::DynamicObject::Ptr worker = new juce::DynamicObject();
+        worker->setProperty("busySeconds", (double) activity.busyNanoseconds * 1.0e-9);
+        worker->setProperty("tasks", (juce::int64) activity.tasks);
+        workers.add(worker.get());
+    }
+    object->setProperty("workers", workers);
+
+    juce::Array<juce::var> anomalies;
+    for (const auto& anomaly : report.anomalies)
+    {
+        juce::DynamicObject::Ptr item = new juce::DynamicObject();
+        item->setProperty("type", SmfAnomaly::getTypeName(anomaly.type));
+        item->setProperty("track", anomaly.track);
+        item->setProperty("offset", anomaly.offset);
+        item->setProperty("detail", anomaly.detail);
+        anomalies.add(item.get());
+    }
+    object->setProperty("anomalies", anomalies);
+
+    return object.get();
+}
+
+juce::int64 StatisticsJson::getPeakResidentBytes()
+{
+   #if JUCE_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (juce::int64) counters.PeakWorkingSetSize;
+    return 0;
+   #else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    #if JUCE_MAC || JUCE_IOS
+     return (juce::int64) usage.ru_maxrss;          // macOS 以字节为单位
+    #else
+     return (juce::int64) usage.ru_maxrss * 1024;   // Linux 以KB为单位
+    #endif
+   #endif
+}
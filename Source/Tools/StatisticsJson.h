@@ -0,0 +1,25 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_STATISTICSJSON_H
+#define CANDYJAR_STATISTICSJSON_H
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../MidiParser/MidiParser.h"
+
+// 命令行工具共用的JSON输出
+class StatisticsJson
+{
+public:
+    // MidiStatistics 转换为 JSON 对象
+    static juce::var toVar(const MidiStatistics& statistics);
+
+    // LoadReport 转换为 JSON 对象（各阶段和步骤的秒数、计数、每个工作线程的忙碌时间，不含任务跟踪）
+    static juce::var toVar(const LoadReport& report);
+
+    // 当前进程的内存峰值（字节），不支持的平台返回0
+    static juce::int64 getPeakResidentBytes();
+};
+
+#endif //CANDYJAR_STATISTICSJSON_H
@@ -0,0 +1,160 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "StatisticsKernel.h"
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <algorithm>
+
+#if defined (__x86_64__) || defined (_M_X64)
+ #define CANDYJAR_STATISTICS_X86 1
+ #include <immintrin.h>
+#else
+ #define CANDYJAR_STATISTICS_X86 0
+#endif
+
+#if CANDYJAR_STATISTICS_X86 && (defined (__GNUC__) || defined (__clang__))
+ #define CANDYJAR_TARGET_AVX2 __attribute__((target ("avx2")))
+#else
+ #define CANDYJAR_TARGET_AVX2
+#endif
+
+void StatisticsKernel::countEventsScalar(const uint8_t* status, const uint8_t* data2, size_t numEvents, EventCounts& counts)
+{
+    for (size_t i = 0; i < numEvents; ++i)
+    {
+        const uint8_t s = status[i];
+        ++counts.eventTypes[(s >> 4) & 7];
+
+        if ((s & 0xF0) == 0x90 && data2[i] != 0)
+            ++counts.channelNotes[s & 0x0F];
+    }
+}
+
+#if CANDYJAR_STATISTICS_X86
+
+namespace
+{
+    // 8位计数器最多累加255次，之后必须归并到64位结果中
+    constexpr size_t maxBlocksPerFlush = 255;
+
+    inline uint64_t sumBytes(__m128i counters)
+    {
+        const __m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+        return (uint64_t) _mm_cvtsi128_si64(sums) + (uint64_t) _mm_cvtsi128_si64(_mm_unpackhi_epi64(sums, sums));
+    }
+
+    size_t countEventsSse2(const uint8_t* status, const uint8_t* data2, size_t numEvents, EventCounts& counts)
+    {
+        const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+        const __m128i zero = _mm_setzero_si128();
+        const size_t numBlocks = numEvents / 16;
+
+        for (size_t block = 0; block < numBlocks;)
+        {
+            __m128i typeCounters[8];
+            __m128i channelCounters[16];
+
+            for (auto& c : typeCounters) c = zero;
+            for (auto& c : channelCounters) c = zero;
+
+            const size_t end = std::min(numBlocks, block + maxBlocksPerFlush);
+
+            for (; block < end; ++block)
+            {
+                const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(status + block * 16));
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data2 + block * 16));
+                const __m128i type = _mm_and_si128(_mm_srli_epi16(s, 4), nibbleMask);
+
+                // cmpeq 的结果是 0xFF（-1），减去它就是计数加一
+                for (int t = 0; t < 8; ++t)
+                    typeCounters[t] = _mm_sub_epi8(typeCounters[t], _mm_cmpeq_epi8(type, _mm_set1_epi8((char) (8 + t))));
+
+                const __m128i noteOn = _mm_andnot_si128(_mm_cmpeq_epi8(v, zero), _mm_cmpeq_epi8(type, _mm_set1_epi8(9)));
+
+                if (_mm_movemask_epi8(noteOn) == 0)
+                    continue;
+
+                const __m128i channel = _mm_and_si128(s, nibbleMask);
+
+                for (int c = 0; c < 16; ++c)
+                    channelCounters[c] = _mm_sub_epi8(channelCounters[c], _mm_and_si128(noteOn, _mm_cmpeq_epi8(channel, _mm_set1_epi8((char) c))));
+            }
+
+            for (int t = 0; t < 8; ++t)
+                counts.eventTypes[t] += sumBytes(typeCounters[t]);
+            for (int c = 0; c < 16; ++c)
+                counts.channelNotes[c] += sumBytes(channelCounters[c]);
+        }
+
+        return numBlocks * 16;
+    }
+
+    CANDYJAR_TARGET_AVX2 inline uint64_t sumBytes256(__m256i counters)
+    {
+        const __m256i sums = _mm256_sad_epu8(counters, _mm256_setzero_si256());
+        return (uint64_t) _mm256_extract_epi64(sums, 0) + (uint64_t) _mm256_extract_epi64(sums, 1)
+             + (uint64_t) _mm256_extract_epi64(sums, 2) + (uint64_t) _mm256_extract_epi64(sums, 3);
+    }
+
+    CANDYJAR_TARGET_AVX2 size_t countEventsAvx2(const uint8_t* status, const uint8_t* data2, size_t numEvents, EventCounts& counts)
+    {
+        const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+        const __m256i zero = _mm256_setzero_si256();
+        const size_t numBlocks = numEvents / 32;
+
+        for (size_t block = 0; block < numBlocks;)
+        {
+            __m256i typeCounters[8];
+            __m256i channelCounters[16];
+
+            for (auto& c : typeCounters) c = zero;
+            for (auto& c : channelCounters) c = zero;
+
+            const size_t end = std::min(numBlocks, block + maxBlocksPerFlush);
+
+            for (; block < end; ++block)
+            {
+                const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(status + block * 32));
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data2 + block * 32));
+                const __m256i type = _mm256_and_si256(_mm256_srli_epi16(s, 4), nibbleMask);
+
+                for (int t = 0; t < 8; ++t)
+                    typeCounters[t] = _mm256_sub_epi8(typeCounters[t], _mm256_cmpeq_epi8(type, _mm256_set1_epi8((char) (8 + t))));
+
+                const __m256i noteOn = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, zero), _mm256_cmpeq_epi8(type, _mm256_set1_epi8(9)));
+
+                if (_mm256_movemask_epi8(noteOn) == 0)
+                    continue;
+
+                const __m256i channel = _mm256_and_si256(s, nibbleMask);
+
+                for (int c = 0; c < 16; ++c)
+                    channelCounters[c] = _mm256_sub_epi8(channelCounters[c], _mm256_and_si256(noteOn, _mm256_cmpeq_epi8(channel, _mm256_set1_epi8((char) c))));
+            }
+
+            for (int t = 0; t < 8; ++t)
+                counts.eventTypes[t] += sumBytes256(typeCounters[t]);
+            for (int c = 0; c < 16; ++c)
+                counts.channelNotes[c] += sumBytes256(channelCounters[c]);
+        }
+
+        return numBlocks * 32;
+    }
+}
+
+#endif
+
+void StatisticsKernel::countEvents(const uint8_t* status, const uint8_t* data2, size_t numEvents, EventCounts& counts)
+{
+    size_t done = 0;
+
+   #if CANDYJAR_STATISTICS_X86
+    static const bool useAvx2 = juce::SystemStats::hasAVX2();
+
+    done = useAvx2 ? countEventsAvx2(status, data2, numEvents, counts)
+                   : countEventsSse2(status, data2, numEvents, counts);
+   #endif
+
+    countEventsScalar(status + done, data2 + done, numEvents - done, counts);
+}
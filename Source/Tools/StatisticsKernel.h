@@ -0,0 +1,24 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_STATISTICSKERNEL_H
+#define CANDYJAR_STATISTICSKERNEL_H
+
+#include "../MidiParser/MidiTrackEvents.h"
+
+// 统计内核：直接扫描连续的 status / data2（力度）字节数组，一遍得到所有计数
+// x86-64上按 AVX2 / SSE2 向量化（运行时选择），其他平台使用标量实现
+// 加载时计数已经在解码中逐个事件累加（MidiTrackEvents::counts），这个内核只留在基准测试中，
+// 作为"解码后再单独扫描一遍"的对照，并检查两者的结果相同
+class StatisticsKernel
+{
+public:
+    // 统计 numEvents 个事件并累加到 counts
+    static void countEvents(const uint8_t* status, const uint8_t* data2, size_t numEvents, EventCounts& counts);
+
+    // 标量实现，向量版本处理剩余的尾部事件时也会用到
+    static void countEventsScalar(const uint8_t* status, const uint8_t* data2, size_t numEvents, EventCounts& counts);
+};
+
+#endif //CANDYJAR_STATISTICSKERNEL_H
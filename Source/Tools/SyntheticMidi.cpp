@@ -0,0 +1,199 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "SyntheticMidi.h"
+#include <vector>
+
+void SyntheticMidiOptions::setTargetSize(juce::int64 bytes)
+{
+    // 平均每个事件约4字节：1~2字节delta + 2~3字节消息
+    const int bytesPerEvent = runningStatus ? 4 : 5;
+    eventsPerTrack = juce::jmax((juce::int64) 1, bytes / bytesPerEvent / juce::jmax(1, numTracks));
+}
+
+bool SyntheticMidi::write(const juce::File& file, const SyntheticMidiOptions& options)
+{
+    file.deleteFile();
+    std::unique_ptr<juce::FileOutputStream> stream = file.createOutputStream();
+
+    if (stream == nullptr || stream->failedToOpen())
+        return false;
+
+    return write(*stream, options);
+}
+
+bool SyntheticMidi::write(juce::FileOutputStream& stream, const SyntheticMidiOptions& options)
+{
+    // MThd
+    stream.write("MThd", 4);
+    stream.writeIntBigEndian(6);
+    stream.writeShortBigEndian(1);
+    stream.writeShortBigEndian((short) options.numTracks);
+    stream.writeShortBigEndian((short) options.ticksPerQuarterNote);
+
+    for (int track = 0; track < options.numTracks; ++track)
+        writeTrack(stream, options, track);
+
+    stream.flush();
+    return stream.getStatus().wasOk();
+}
+
+bool SyntheticMidi::writeChord(const juce::File& file, int numNotes, int holdBeats)
+{
+    file.deleteFile();
+    std::unique_ptr<juce::FileOutputStream> stream = file.createOutputStream();
+
+    if (stream == nullptr || stream->failedToOpen())
+        return false;
+
+    constexpr int ticksPerQuarterNote = 480;
+
+    stream->write("MThd", 4);
+    stream->writeIntBigEndian(6);
+    stream->writeShortBigEndian(0);
+    stream->writeShortBigEndian(1);
+    stream->writeShortBigEndian((short) ticksPerQuarterNote);
+
+    stream->write("MTrk", 4);
+    const juce::int64 lengthPosition = stream->getPosition();
+    stream->writeIntBigEndian(0);
+    const juce::int64 dataStart = stream->getPosition();
+
+    // 同一个 (通道, 音高) 上的多个音符在发声体池中叠加，Note Off 按后进先出逐个释放
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (int i = 0; i < numNotes; ++i)
+        {
+            const uint32_t delta = (pass == 1 && i == 0) ? (uint32_t) (juce::jmax(1, holdBeats) * ticksPerQuarterNote) : 0;
+            writeVariableLength(*stream, delta);
+            stream->writeByte((char) ((pass == 0 ? 0x90 : 0x80) | (i % 16)));
+            stream->writeByte((char) (24 + (i / 16) % 96));
+            stream->writeByte((char) (pass == 0 ? 100 : 64));
+        }
+    }
+
+    const uint8_t endOfTrack[] = { 0x00, 0xFF, 0x2F, 0x00 };
+    stream->write(endOfTrack, sizeof(endOfTrack));
+
+    const juce::int64 dataEnd = stream->getPosition();
+    stream->setPosition(lengthPosition);
+    stream->writeIntBigEndian((int) (dataEnd - dataStart));
+    stream->setPosition(dataEnd);
+
+    stream->flush();
+    return stream->getStatus().wasOk();
+}
+
+void SyntheticMidi::writeVariableLength(juce::OutputStream& stream, uint32_t value)
+{
+    uint8_t bytes[5];
+    int count = 0;
+
+    bytes[count++] = (uint8_t) (value & 0x7F);
+
+    while ((value >>= 7) != 0)
+        bytes[count++] = (uint8_t) ((value & 0x7F) | 0x80);
+
+    while (count > 0)
+        stream.writeByte((char) bytes[--count]);
+}
+
+void SyntheticMidi::writeTrack(juce::FileOutputStream& stream, const SyntheticMidiOptions& options, int trackIndex)
+{
+    // 先写长度占位，写完事件后回填
+    stream.write("MTrk", 4);
+    const juce::int64 lengthPosition = stream.getPosition();
+    stream.writeIntBigEndian(0);
+    const juce::int64 dataStart = stream.getPosition();
+
+    juce::Random random(options.seed * 7919 + trackIndex);
+    const int channel = trackIndex % 16;
+    const int maxDelta = juce::jmax(1, 2 * options.ticksPerQuarterNote / juce::jmax(1, options.eventsPerBeat));
+    const int maxPolyphony = juce::jmax(1, options.maxPolyphony);
+    uint8_t lastStatus = 0;
+
+    auto writeMessage = [&](uint32_t delta, uint8_t status, uint8_t data1, uint8_t data2)
+    {
+        writeVariableLength(stream, delta);
+
+        if (!options.runningStatus || status != lastStatus)
+            stream.writeByte((char) status);
+
+        stream.writeByte((char) data1);
+        stream.writeByte((char) data2);
+        lastStatus = status;
+    };
+
+    // 第0轨的速度变化均匀分布在整首曲子中
+    const int tempoChanges = trackIndex == 0 ? juce::jmax(0, options.tempoChanges) : 0;
+    const juce::int64 tempoInterval = tempoChanges > 0 ? options.eventsPerTrack / (tempoChanges + 1) + 1 : 0;
+
+    // 按住的音符用环形队列保存，Note Off 总是释放最早按下的音符
+    std::vector<uint8_t> heldKeys((size_t) maxPolyphony);
+    int heldBegin = 0;
+    int numHeld = 0;
+
+    for (juce::int64 i = 0; i < options.eventsPerTrack; ++i)
+    {
+        uint32_t delta = (uint32_t) random.nextInt(maxDelta + 1);
+
+        if (tempoInterval > 0 && i > 0 && i % tempoInterval == 0)
+        {
+            // FF 51 03 tt tt tt，Meta事件会打断running status
+            const int tempo = 300000 + random.nextInt(700000);
+            writeVariableLength(stream, delta);
+            const uint8_t tempoEvent[] = { 0xFF, 0x51, 0x03, (uint8_t) (tempo >> 16), (uint8_t) (tempo >> 8), (uint8_t) tempo };
+            stream.write(tempoEvent, sizeof(tempoEvent));
+            lastStatus = 0;
+            delta = 0;
+        }
+
+        const int choice = random.nextInt(100);
+
+        if (choice < 4)
+        {
+            // 控制器
+            writeMessage(delta, (uint8_t) (0xB0 | channel), (uint8_t) random.nextInt(120), (uint8_t) random.nextInt(128));
+        }
+        else if (choice < 6)
+        {
+            // 弯音
+            writeMessage(delta, (uint8_t) (0xE0 | channel), (uint8_t) random.nextInt(128), (uint8_t) random.nextInt(128));
+        }
+        else if (numHeld < maxPolyphony && (numHeld == 0 || choice < 53))
+        {
+            const uint8_t key = (uint8_t) (24 + random.nextInt(84));
+            heldKeys[(size_t) ((heldBegin + numHeld++) % maxPolyphony)] = key;
+            writeMessage(delta, (uint8_t) (0x90 | channel), key, (uint8_t) (1 + random.nextInt(127)));
+        }
+        else
+        {
+            // 一半用 0x80，一半用力度为0的 Note On（running status 下更常见）
+            const uint8_t key = heldKeys[(size_t) heldBegin];
+            heldBegin = (heldBegin + 1) % maxPolyphony;
+            --numHeld;
+
+            if (choice & 1)
+                writeMessage(delta, (uint8_t) (0x80 | channel), key, 64);
+            else
+                writeMessage(delta, (uint8_t) (0x90 | channel), key, 0);
+        }
+    }
+
+    // 末尾补齐未释放的音符（不计入 eventsPerTrack）
+    for (; numHeld > 0; --numHeld)
+    {
+        writeMessage(0, (uint8_t) (0x80 | channel), heldKeys[(size_t) heldBegin], 64);
+        heldBegin = (heldBegin + 1) % maxPolyphony;
+    }
+
+    // End of Track
+    const uint8_t endOfTrack[] = { 0x00, 0xFF, 0x2F, 0x00 };
+    stream.write(endOfTrack, sizeof(endOfTrack));
+
+    const juce::int64 dataEnd = stream.getPosition();
+    stream.setPosition(lengthPosition);
+    stream.writeIntBigEndian((int) (dataEnd - dataStart));
+    stream.setPosition(dataEnd);
+}
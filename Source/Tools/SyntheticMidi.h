@@ -0,0 +1,44 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_SYNTHETICMIDI_H
+#define CANDYJAR_SYNTHETICMIDI_H
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// 合成MIDI文件的参数
+struct SyntheticMidiOptions
+{
+    int numTracks = 16;
+    juce::int64 eventsPerTrack = 100000;  // 每个轨道的通道事件数（不含Meta事件）
+    int eventsPerBeat = 16;               // 事件密度：每个四分音符内平均的事件数
+    int ticksPerQuarterNote = 480;
+    int maxPolyphony = 16;                // 每个轨道同时按住的音符数上限
+    int tempoChanges = 64;                // 第0轨中的速度变化次数
+    bool runningStatus = true;            // 是否使用running status压缩
+    juce::int64 seed = 1;
+
+    // 根据目标文件大小估算每轨事件数
+    void setTargetSize(juce::int64 bytes);
+};
+
+// 生成确定性的合成SMF（格式1）文件，用于基准测试
+//  - 相同参数和种子生成的文件逐字节相同
+//  - 边生成边写入，内存占用与文件大小无关
+class SyntheticMidi
+{
+public:
+    static bool write(const juce::File& file, const SyntheticMidiOptions& options);
+    static bool write(juce::FileOutputStream& stream, const SyntheticMidiOptions& options);
+
+    // 合成器的复音压力测试：第0拍同时按下 numNotes 个音符（16个通道、96个音高轮流使用），
+    // 按住 holdBeats 拍后全部释放（格式0，每四分音符480 tick，默认速度）
+    static bool writeChord(const juce::File& file, int numNotes, int holdBeats);
+
+private:
+    static void writeVariableLength(juce::OutputStream& stream, uint32_t value);
+    static void writeTrack(juce::FileOutputStream& stream, const SyntheticMidiOptions& options, int trackIndex);
+};
+
+#endif //CANDYJAR_SYNTHETICMIDI_H
@@ -0,0 +1,281 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "Arena.h"
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <new>
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+#else
+ #include <sys/mman.h>
+#endif
+
+namespace
+{
+    inline size_t roundUp(size_t value, size_t multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    constexpr size_t hugePageSize = (size_t) 2 << 20;
+}
+
+Arena::~Arena()
+{
+    release();
+}
+
+void Arena::setOptions(const Options& newOptions)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    options = newOptions;
+}
+
+uint8_t* Arena::alignPointer(uint8_t* pointer, size_t alignment)
+{
+    return reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(pointer) + alignment - 1) & ~(uintptr_t) (alignment - 1));
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment)
+{
+    jassert(alignment > 0 && (alignment & (alignment - 1)) == 0 && alignment <= 4096);
+    std::lock_guard<std::mutex> guard(lock);
+    ++numAllocations;
+
+    // 大的分配单独映射（映射按页对齐），优先复用上次加载留下的、放得下的最小的一块
+    if (bytes > options.chunkSize / 4)
+    {
+        size_t best = freeLargeBlocks.size();
+
+        for (size_t i = 0; i < freeLargeBlocks.size(); ++i)
+            if (freeLargeBlocks[i].size >= bytes && (best == freeLargeBlocks.size() || freeLargeBlocks[i].size < freeLargeBlocks[best].size))
+                best = i;
+
+        Block block;
+
+        if (best < freeLargeBlocks.size())
+        {
+            block = freeLargeBlocks[best];
+            freeLargeBlocks[best] = freeLargeBlocks.back();
+            freeLargeBlocks.pop_back();
+        }
+        else
+        {
+            block = mapBlock(bytes);
+            ++numMappings;
+        }
+
+        block.used = bytes;
+        largeBlocks.push_back(block);
+        return block.base;
+    }
+
+    // 其余的从当前块顺序切出，放不下时换到下一个保留的空块或新映射一块
+    for (;;)
+    {
+        if (currentChunk < chunks.size())
+        {
+            Block& chunk = chunks[currentChunk];
+            uint8_t* pointer = alignPointer(chunk.base + chunk.used, alignment);
+
+            if ((size_t) (pointer - chunk.base) + bytes <= chunk.size)
+            {
+                chunk.used = (size_t) (pointer - chunk.base) + bytes;
+                return pointer;
+            }
+
+            if (currentChunk + 1 < chunks.size())
+            {
+                ++currentChunk;
+                continue;
+            }
+        }
+
+        chunks.push_back(mapBlock(options.chunkSize));
+        ++numMappings;
+        currentChunk = chunks.size() - 1;
+    }
+}
+
+void Arena::reset()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (auto& chunk : chunks)
+        chunk.used = 0;
+
+    currentChunk = 0;
+    numAllocations = 0;
+    numMappings = 0;
+
+    for (auto& block : largeBlocks)
+    {
+        block.used = 0;
+        freeLargeBlocks.push_back(block);
+    }
+
+    largeBlocks.clear();
+
+    // 保留不超过上限的内存：先保留前面的普通块，再保留大块
+    size_t retained = 0;
+    size_t numChunksKept = 0;
+
+    for (; numChunksKept < chunks.size() && retained + chunks[numChunksKept].size <= options.maxRetainedBytes; ++numChunksKept)
+        retained += chunks[numChunksKept].size;
+
+    for (size_t i = numChunksKept; i < chunks.size(); ++i)
+        unmapBlock(chunks[i]);
+
+    chunks.resize(numChunksKept);
+
+    size_t numLargeKept = 0;
+
+    for (size_t i = 0; i < freeLargeBlocks.size(); ++i)
+    {
+        if (retained + freeLargeBlocks[i].size <= options.maxRetainedBytes)
+        {
+            retained += freeLargeBlocks[i].size;
+            freeLargeBlocks[numLargeKept++] = freeLargeBlocks[i];
+        }
+        else
+        {
+            unmapBlock(freeLargeBlocks[i]);
+        }
+    }
+
+    freeLargeBlocks.resize(numLargeKept);
+}
+
+void Arena::release()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (const auto& block : chunks)
+        unmapBlock(block);
+
+    for (const auto& block : largeBlocks)
+        unmapBlock(block);
+
+    for (const auto& block : freeLargeBlocks)
+        unmapBlock(block);
+
+    chunks.clear();
+    largeBlocks.clear();
+    freeLargeBlocks.clear();
+    currentChunk = 0;
+    numAllocations = 0;
+    numMappings = 0;
+}
+
+size_t Arena::getBytesAllocated() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    size_t total = 0;
+
+    for (const auto& block : chunks)
+        total += block.used;
+
+    for (const auto& block : largeBlocks)
+        total += block.used;
+
+    return total;
+}
+
+size_t Arena::getBytesMapped() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    size_t total = 0;
+
+    for (const auto& block : chunks)
+        total += block.size;
+
+    for (const auto& block : largeBlocks)
+        total += block.size;
+
+    for (const auto& block : freeLargeBlocks)
+        total += block.size;
+
+    return total;
+}
+
+size_t Arena::getNumAllocations() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return numAllocations;
+}
+
+size_t Arena::getNumMappings() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return numMappings;
+}
+
+//==============================================================================
+Arena::Block Arena::mapBlock(size_t bytes) const
+{
+    Block block;
+
+   #if JUCE_WINDOWS
+    // 大页需要 SeLockMemoryPrivilege 权限，没有时失败，退回普通页
+    if (options.useHugePages)
+    {
+        const size_t largePageSize = GetLargePageMinimum();
+
+        if (largePageSize > 0)
+        {
+            block.size = roundUp(bytes, largePageSize);
+            block.base = static_cast<uint8_t*>(VirtualAlloc(nullptr, block.size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+
+            if (block.base != nullptr)
+                return block;
+        }
+    }
+
+    block.size = roundUp(bytes, 65536);
+    block.base = static_cast<uint8_t*>(VirtualAlloc(nullptr, block.size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+
+    if (block.base == nullptr)
+        throw std::bad_alloc();
+   #else
+   #if JUCE_LINUX && defined (MAP_HUGETLB)
+    // 预留的大页（hugetlbfs）通常没有配置，失败时退回普通页加透明大页
+    if (options.useHugePages)
+    {
+        block.size = roundUp(bytes, hugePageSize);
+        void* pointer = mmap(nullptr, block.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (pointer != MAP_FAILED)
+        {
+            block.base = static_cast<uint8_t*>(pointer);
+            return block;
+        }
+    }
+   #endif
+
+    block.size = roundUp(bytes, options.useHugePages ? hugePageSize : (size_t) 4096);
+    void* pointer = mmap(nullptr, block.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (pointer == MAP_FAILED)
+        throw std::bad_alloc();
+
+    block.base = static_cast<uint8_t*>(pointer);
+
+   #if JUCE_LINUX && defined (MADV_HUGEPAGE)
+    if (options.useHugePages)
+        madvise(pointer, block.size, MADV_HUGEPAGE);
+   #endif
+   #endif
+
+    return block;
+}
+
+void Arena::unmapBlock(const Block& block)
+{
+   #if JUCE_WINDOWS
+    VirtualFree(block.base, 0, MEM_RELEASE);
+   #else
+    munmap(block.base, block.size);
+   #endif
+}
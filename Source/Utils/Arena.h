@@ -0,0 +1,155 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_ARENA_H
+#define CANDYJAR_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+// 线性（bump）内存池，存放一次加载的所有数据
+//  - 小的分配从当前大块（默认64MB）中顺序切出，超过块大小四分之一的分配单独映射
+//  - 不能单独释放。reset() 只把游标归零，内存留给下一次加载复用，
+//    超过保留上限的部分直接归还系统（每块一次 munmap / VirtualFree）
+//  - 内存直接向系统映射，可以选择使用大页（失败时退回普通页）
+//  - allocate() 可以在多个线程同时调用；reset() 时不能有其他线程在分配
+class Arena
+{
+public:
+    struct Options
+    {
+        size_t chunkSize = (size_t) 64 << 20;
+        bool useHugePages = false;
+        size_t maxRetainedBytes = (size_t) 1 << 30;   // reset() 后最多保留这么多已映射的内存
+    };
+
+    Arena() = default;
+    explicit Arena(const Options& newOptions) : options(newOptions) {}
+    ~Arena();
+
+    // 之后新映射的块使用新选项，已有的块不变
+    void setOptions(const Options& newOptions);
+    const Options& getOptions() const { return options; }
+
+    // 返回至少 bytes 字节、按 alignment（2的幂，不超过4096）对齐的未初始化内存，失败时抛出 std::bad_alloc
+    void* allocate(size_t bytes, size_t alignment = 64);
+
+    template <typename T>
+    T* allocateArray(size_t numItems)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Arena memory is never destructed");
+        return static_cast<T*>(allocate(std::max(numItems, (size_t) 1) * sizeof(T), std::max(alignof(T), (size_t) 64)));
+    }
+
+    // 丢弃所有分配，之前返回的指针全部失效
+    void reset();
+
+    // 丢弃所有分配并把全部内存归还系统
+    void release();
+
+    // 当前分配出去的字节数，以及向系统映射的总字节数
+    size_t getBytesAllocated() const;
+    size_t getBytesMapped() const;
+
+    // 上次 reset() 以来的分配次数，以及其中向系统新映射内存的次数
+    size_t getNumAllocations() const;
+    size_t getNumMappings() const;
+
+private:
+    struct Block
+    {
+        uint8_t* base = nullptr;
+        size_t size = 0;
+        size_t used = 0;
+    };
+
+    Options options;
+    mutable std::mutex lock;
+    std::vector<Block> chunks;        // 按块大小映射，[0, currentChunk] 正在使用，之后的是保留的空块
+    size_t currentChunk = 0;
+    std::vector<Block> largeBlocks;   // 正在使用的单独映射
+    std::vector<Block> freeLargeBlocks;
+    size_t numAllocations = 0;
+    size_t numMappings = 0;
+
+    Block mapBlock(size_t bytes) const;
+    static void unmapBlock(const Block& block);
+    static uint8_t* alignPointer(uint8_t* pointer, size_t alignment);
+
+    Arena(const Arena&) = delete;
+    Arena& operator= (const Arena&) = delete;
+};
+
+// 在 Arena 中分配的可增长数组，只能存放平凡类型
+// 容量不够时在 Arena 中分配一块两倍大的新内存并复制，旧内存等到 Arena::reset() 时一起回收，
+// 所以能预先知道上限时应先 reserve()。clear() 不释放内存
+template <typename T>
+class ArenaArray
+{
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "ArenaArray can only hold trivially copyable types");
+
+    // 确保至少能放 capacity 个元素，之后增长也从同一个 arena 分配
+    void reserve(Arena& sourceArena, size_t capacity)
+    {
+        arena = &sourceArena;
+
+        if (capacity > itemCapacity)
+            reallocate(capacity);
+    }
+
+    inline void push_back(const T& item)
+    {
+        if (count == itemCapacity)
+            reallocate(std::max(itemCapacity * 2, (size_t) 16));
+
+        items[count++] = item;
+    }
+
+    // 只忘记内容，内存随 arena 一起回收
+    void clear()
+    {
+        arena = nullptr;
+        items = nullptr;
+        count = 0;
+        itemCapacity = 0;
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return itemCapacity; }
+    bool empty() const { return count == 0; }
+
+    T* data() { return items; }
+    const T* data() const { return items; }
+    T& operator[] (size_t index) { return items[index]; }
+    const T& operator[] (size_t index) const { return items[index]; }
+
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+
+private:
+    Arena* arena = nullptr;
+    T* items = nullptr;
+    size_t count = 0;
+    size_t itemCapacity = 0;
+
+    void reallocate(size_t newCapacity)
+    {
+        // 没有先 reserve() 就增长是调用错误
+        T* newItems = arena->allocateArray<T>(newCapacity);
+
+        if (count > 0)
+            std::memcpy(newItems, items, count * sizeof(T));
+
+        items = newItems;
+        itemCapacity = newCapacity;
+    }
+};
+
+#endif //CANDYJAR_ARENA_H
@@ -0,0 +1,60 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_PODARRAY_H
+#define CANDYJAR_PODARRAY_H
+
+#include <cstddef>
+#include <type_traits>
+#include "Arena.h"
+
+// 平凡类型的数组：要么在 Arena 中分配，要么只是外部只读内存（例如映射的缓存文件）的视图
+// 数组本身从不释放内存，读取接口对两种情况相同；写入只能用于 Arena 中分配的数组
+template <typename T>
+class PodArray
+{
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "PodArray can only hold trivially copyable types");
+
+    // 改为在 arena 中分配 numItems 个元素（不初始化），内存在 arena 重置前有效
+    void allocate(Arena& arena, size_t numItems)
+    {
+        writableItems = arena.allocateArray<T>(numItems);
+        items = writableItems;
+        count = numItems;
+    }
+
+    // 改为引用外部内存，外部内存在数组清空前必须保持有效
+    void setView(const T* externalItems, size_t numItems)
+    {
+        writableItems = nullptr;
+        items = externalItems;
+        count = numItems;
+    }
+
+    // 只忘记内容，内存随 arena 一起回收
+    void clear()
+    {
+        writableItems = nullptr;
+        items = nullptr;
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool isView() const { return items != nullptr && writableItems == nullptr; }
+
+    const T* data() const { return items; }
+    const T& operator[] (size_t index) const { return items[index]; }
+
+    // 不能用于视图
+    T& operator[] (size_t index) { return writableItems[index]; }
+
+private:
+    T* writableItems = nullptr;
+    const T* items = nullptr;
+    size_t count = 0;
+};
+
+#endif //CANDYJAR_PODARRAY_H
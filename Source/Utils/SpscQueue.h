@@ -0,0 +1,100 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_SPSCQUEUE_H
+#define CANDYJAR_SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// 单生产者单消费者的无锁环形队列，push/front/pop 都不分配内存、不加锁，可以在实时音频线程上使用
+//  - 读写下标分别在自己的缓存行上，各端再缓存一份对方的下标，只有看起来满/空时才重新读取
+//  - 容量向上取整到2的幂
+template <typename T>
+class SpscQueue
+{
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "SpscQueue can only hold trivially copyable types");
+
+    explicit SpscQueue(size_t minCapacity)
+    {
+        size_t capacity = 1;
+
+        while (capacity < minCapacity)
+            capacity <<= 1;
+
+        items.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    size_t getCapacity() const { return items.size(); }
+
+    // 生产者：队列满时返回 false
+    bool push(const T& item)
+    {
+        const size_t writeIndex = tail.load(std::memory_order_relaxed);
+
+        if (writeIndex - cachedHead == items.size())
+        {
+            cachedHead = head.load(std::memory_order_acquire);
+
+            if (writeIndex - cachedHead == items.size())
+                return false;
+        }
+
+        items[writeIndex & mask] = item;
+        tail.store(writeIndex + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者：队首元素，队列空时返回 nullptr
+    const T* front()
+    {
+        const size_t readIndex = head.load(std::memory_order_relaxed);
+
+        if (readIndex == cachedTail)
+        {
+            cachedTail = tail.load(std::memory_order_acquire);
+
+            if (readIndex == cachedTail)
+                return nullptr;
+        }
+
+        return &items[readIndex & mask];
+    }
+
+    // 消费者：移除队首元素，只能在 front() 不为空之后调用
+    void pop()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // 当前的元素数，任意线程都可以读取（只是一个近似值）
+    size_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    // 清空队列，调用时生产者和消费者都不能在使用队列
+    void clear()
+    {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        cachedHead = 0;
+        cachedTail = 0;
+    }
+
+private:
+    std::vector<T> items;
+    size_t mask = 0;
+
+    alignas(64) std::atomic<size_t> head {0};   // 消费者写
+    size_t cachedTail = 0;                      // 消费者缓存的 tail
+    alignas(64) std::atomic<size_t> tail {0};   // 生产者写
+    size_t cachedHead = 0;                      // 生产者缓存的 head
+};
+
+#endif //CANDYJAR_SPSCQUEUE_H
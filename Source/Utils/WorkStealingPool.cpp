@@ -0,0 +1,251 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    // 当前线程所属的线程池，用来识别嵌套调用
+    thread_local const WorkStealingPool* currentPool = nullptr;
+}
+
+WorkStealingPool::WorkStealingPool(int numThreads)
+{
+    if (numThreads <= 0)
+        numThreads = (int) std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 0; i < numThreads; ++i)
+        queues.push_back(std::make_unique<WorkQueue>());
+
+    // 0号工作线程是调用 parallelFor 的线程
+    for (int i = 1; i < numThreads; ++i)
+        threads.emplace_back([this, i]() { workerLoop(i); });
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(stateLock);
+        shuttingDown = true;
+    }
+
+    jobAvailable.notify_all();
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+void WorkStealingPool::parallelFor(int count, const std::function<void(int index, int workerIndex)>& task)
+{
+    run(count, task, true);
+}
+
+void WorkStealingPool::parallelForWithoutWaiting(int count, const std::function<void(int index, int workerIndex)>& task)
+{
+    run(count, task, false);
+}
+
+void WorkStealingPool::run(int count, const std::function<void(int, int)>& task, bool waitForPool)
+{
+    if (count <= 0)
+        return;
+
+    // 嵌套调用时外层任务已经计时，直接串行执行
+    if (currentPool == this)
+    {
+        for (int i = 0; i < count; ++i)
+            task(i, 0);
+        return;
+    }
+
+    std::unique_lock<std::mutex> jobGuard(jobLock, std::defer_lock);
+
+    // 线程池正被其他线程使用：不记录活动（0号队列的计数属于那个调用者），在当前线程串行执行
+    if (waitForPool)
+        jobGuard.lock();
+    else if (!jobGuard.try_lock())
+    {
+        for (int i = 0; i < count; ++i)
+            task(i, 0);
+        return;
+    }
+
+    // 只有一个线程或一个任务时在调用线程上串行执行
+    if (queues.size() == 1 || count == 1)
+    {
+        for (int i = 0; i < count; ++i)
+            runTask(i, 0, task);
+        return;
+    }
+
+    // 把连续的下标块分给每个队列，保持局部性
+    const int numQueues = getNumThreads();
+    for (int q = 0; q < numQueues; ++q)
+    {
+        const int begin = (int) ((int64_t) count * q / numQueues);
+        const int end = (int) ((int64_t) count * (q + 1) / numQueues);
+
+        std::lock_guard<std::mutex> guard(queues[(size_t) q]->lock);
+        for (int i = begin; i < end; ++i)
+            queues[(size_t) q]->indices.push_back(i);
+    }
+
+    remainingTasks = count;
+
+    {
+        std::lock_guard<std::mutex> guard(stateLock);
+        currentTask = &task;
+        ++jobGeneration;
+    }
+
+    jobAvailable.notify_all();
+
+    currentPool = this;
+    runTasks(0, task);
+    currentPool = nullptr;
+
+    // 等待所有工作线程离开当前任务，之后才能销毁 task
+    std::unique_lock<std::mutex> lock(stateLock);
+    jobFinished.wait(lock, [this]() { return remainingTasks.load() == 0 && busyWorkers == 0; });
+    currentTask = nullptr;
+}
+
+void WorkStealingPool::workerLoop(int workerIndex)
+{
+    currentPool = this;
+    uint64_t lastGeneration = 0;
+
+    for (;;)
+    {
+        const std::function<void(int, int)>* task = nullptr;
+
+        {
+            std::unique_lock<std::mutex> lock(stateLock);
+            jobAvailable.wait(lock, [this, lastGeneration]() { return shuttingDown || (currentTask != nullptr && jobGeneration != lastGeneration); });
+
+            if (shuttingDown)
+                return;
+
+            lastGeneration = jobGeneration;
+            task = currentTask;
+            ++busyWorkers;
+        }
+
+        runTasks(workerIndex, *task);
+
+        {
+            std::lock_guard<std::mutex> guard(stateLock);
+            --busyWorkers;
+        }
+
+        jobFinished.notify_all();
+    }
+}
+
+void WorkStealingPool::runTasks(int workerIndex, const std::function<void(int, int)>& task)
+{
+    int index = 0;
+
+    while (popLocal(workerIndex, index) || steal(workerIndex, index))
+    {
+        runTask(index, workerIndex, task);
+
+        if (remainingTasks.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> guard(stateLock);
+            jobFinished.notify_all();
+        }
+    }
+}
+
+bool WorkStealingPool::popLocal(int workerIndex, int& index)
+{
+    auto& queue = *queues[(size_t) workerIndex];
+    std::lock_guard<std::mutex> guard(queue.lock);
+
+    if (queue.indices.empty())
+        return false;
+
+    index = queue.indices.front();
+    queue.indices.pop_front();
+    return true;
+}
+
+bool WorkStealingPool::steal(int workerIndex, int& index)
+{
+    const int numQueues = getNumThreads();
+
+    for (int offset = 1; offset < numQueues; ++offset)
+    {
+        auto& victim = *queues[(size_t) ((workerIndex + offset) % numQueues)];
+        std::lock_guard<std::mutex> guard(victim.lock);
+
+        // 从另一端窃取，避免和队列所有者争抢相邻的任务
+        if (!victim.indices.empty())
+        {
+            index = victim.indices.back();
+            victim.indices.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingPool::runTask(int index, int workerIndex, const std::function<void(int, int)>& task)
+{
+    const int64_t start = getTimestampNanoseconds();
+    task(index, workerIndex);
+    const int64_t duration = getTimestampNanoseconds() - start;
+
+    WorkQueue& queue = *queues[(size_t) workerIndex];
+    queue.activity.busyNanoseconds += duration;
+    ++queue.activity.tasks;
+
+    if (tracing)
+        queue.spans.push_back({ traceName, index, workerIndex, start, duration });
+}
+
+//==============================================================================
+int64_t WorkStealingPool::getTimestampNanoseconds()
+{
+    return (int64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::vector<WorkStealingPool::WorkerActivity> WorkStealingPool::getWorkerActivity() const
+{
+    std::vector<WorkerActivity> activity;
+
+    for (const auto& queue : queues)
+        activity.push_back(queue->activity);
+
+    return activity;
+}
+
+void WorkStealingPool::resetWorkerActivity()
+{
+    for (auto& queue : queues)
+        queue->activity = WorkerActivity();
+}
+
+void WorkStealingPool::setTracing(bool shouldTrace, const char* name)
+{
+    tracing = shouldTrace;
+    traceName = name;
+}
+
+std::vector<WorkStealingPool::TaskSpan> WorkStealingPool::takeTaskSpans()
+{
+    std::vector<TaskSpan> spans;
+
+    for (auto& queue : queues)
+    {
+        spans.insert(spans.end(), queue->spans.begin(), queue->spans.end());
+        queue->spans.clear();
+    }
+
+    return spans;
+}
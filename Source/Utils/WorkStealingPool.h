@@ -0,0 +1,104 @@
+//
+// Created by 33478 on 2025/11/3.
+//
+
+#ifndef CANDYJAR_WORKSTEALINGPOOL_H
+#define CANDYJAR_WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 简单的工作窃取线程池
+// parallelFor 把下标平均分配到每个工作线程的队列中，线程做完自己的任务后从其他队列的另一端窃取，
+// 适合每个任务耗时差别很大的场景（例如大小悬殊的MIDI轨道）
+class WorkStealingPool
+{
+public:
+    // numThreads <= 0 时使用硬件线程数；调用 parallelFor 的线程本身也算一个工作线程
+    explicit WorkStealingPool(int numThreads = 0);
+    ~WorkStealingPool();
+
+    // 包括调用线程在内的工作线程数
+    int getNumThreads() const { return (int) queues.size(); }
+
+    // 并行执行 task(index, workerIndex)，index ∈ [0, count)，workerIndex ∈ [0, getNumThreads())
+    // 所有任务完成后返回。在池内线程中嵌套调用时会直接在当前线程串行执行
+    void parallelFor(int count, const std::function<void(int index, int workerIndex)>& task);
+
+    // 和 parallelFor 相同，但线程池正在执行其他线程的 parallelFor 时不排队等待，直接在当前线程串行执行
+    // 给不能阻塞的线程用（例如界面线程上的绘制，线程池可能正被一次加载占用好几秒）
+    void parallelForWithoutWaiting(int count, const std::function<void(int index, int workerIndex)>& task);
+
+    //==============================================================================
+    // 每个工作线程执行任务的累计用时（纳秒）和任务数，总是统计（每个任务读两次时钟）
+    struct WorkerActivity
+    {
+        int64_t busyNanoseconds = 0;
+        int64_t tasks = 0;
+    };
+
+    // 打开跟踪时记录的一个任务，时间是 steady_clock 的纳秒数
+    struct TaskSpan
+    {
+        const char* name;
+        int index;
+        int workerIndex;
+        int64_t startNanoseconds;
+        int64_t durationNanoseconds;
+    };
+
+    // 以下都不能和 parallelFor 同时调用
+    std::vector<WorkerActivity> getWorkerActivity() const;
+    void resetWorkerActivity();
+
+    // 打开后记录每个任务的起止时间；name 是之后的任务在跟踪中的名字，必须是静态字符串
+    void setTracing(bool shouldTrace, const char* name = "Task");
+
+    // 取出已经记录的任务（按工作线程分组）
+    std::vector<TaskSpan> takeTaskSpans();
+
+    static int64_t getTimestampNanoseconds();
+
+private:
+    struct WorkQueue
+    {
+        std::mutex lock;
+        std::deque<int> indices;
+
+        // 只由对应的工作线程写入
+        WorkerActivity activity;
+        std::vector<TaskSpan> spans;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex jobLock;      // 同一时间只运行一个 parallelFor，多个外部线程同时调用时排队
+    std::mutex stateLock;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobFinished;
+
+    const std::function<void(int, int)>* currentTask = nullptr;
+    uint64_t jobGeneration = 0;
+    int busyWorkers = 0;
+    bool shuttingDown = false;
+    std::atomic<int> remainingTasks {0};
+
+    bool tracing = false;
+    const char* traceName = "Task";
+
+    void workerLoop(int workerIndex);
+    void run(int count, const std::function<void(int, int)>& task, bool waitForPool);
+    void runTasks(int workerIndex, const std::function<void(int, int)>& task);
+    void runTask(int index, int workerIndex, const std::function<void(int, int)>& task);
+    bool popLocal(int workerIndex, int& index);
+    bool steal(int workerIndex, int& index);
+};
+
+#endif //CANDYJAR_WORKSTEALINGPOOL_H